@@ -3,43 +3,254 @@
     Created: Feb 2020
 */
 
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Database.h"
 #include "config.h"
+#include "HashIndex.h"
+#include "RecordArray.h"
+#include "BucketQueue.h"
+#include "Journal.h"
 
 // Macros
-#define MAX_BLOG_POSTS  ( 200 )
-#define DATABASE_FILE   ( "database.xml" )
+// Files of a database are named after it, e.g. "database.bin"
+#define DATABASE_FILE_EXTENSION ( ".bin" )
+// Database file of older versions, imported when there is no .bin file yet
+#define DATABASE_XML_EXTENSION ( ".xml" )
 #define DEBUG_DATABASE  ( 0 )
+#define DATABASE_READ_CHUNK ( 4096 )
+// Changes made since the database file was last written
+#define DATABASE_JOURNAL_EXTENSION ( ".journal" )
+// Changes being folded into the database file by a compaction
+#define DATABASE_OLD_JOURNAL_EXTENSION ( ".journal.old" )
+// Longest file name of a database, the longest extension included
+#define DATABASE_MAX_FILE_LEN ( DATABASE_MAX_NAME_LEN + sizeof( DATABASE_OLD_JOURNAL_EXTENSION ) - 1 )
+// Size in bytes after which the journal is folded back into the database file
+#define DATABASE_JOURNAL_LIMIT ( 64 * 1024 )
+// Posts shared more often than this all share the last bucket
+#define DATABASE_SHARE_BUCKETS ( 100 )
+// Newest dated posts the publishing rate of the blog is worked out from
+#define DATABASE_SCHEDULE_POSTS ( 16 )
+// "TWDB", first bytes of the database file
+#define DATABASE_SNAPSHOT_MAGIC ( 0x42445754 )
+// Changed whenever the layout or the way links are hashed changes
+#define DATABASE_SNAPSHOT_VERSION ( 1 )
 
 // typedefs 
 typedef struct DATABASE
 {
-   char szPostCount[3+1];
-   BLOG_POST asList[MAX_BLOG_POSTS];
+   // Only used to read & write the file, sPosts.ulCount is the number of posts
+   uint32_t ulPostCount;
+   // Sequence number of the last journal record already in the file
+   uint32_t ulJournalSequence;
+   // BLOG_POSTs, grown as posts are added
+   RECORD_ARRAY sPosts;
 }DATABASE;
 
-// Static variables
-static DATABASE s_sList = { 0, };
+/* 
+   Journal records, both hold a BLOG_POST
+ */
+typedef enum
+{
+   // Post added at index 0
+   DATABASE_JOURNAL_ADD = 1,
+   // Post shared once more
+   DATABASE_JOURNAL_SHARE
+} DATABASE_JOURNAL_TYPE;
+
+/* 
+   Feed being refreshed, the posts & the channel's hints on how often to fetch it
+   sy:updatePeriod & sy:updateFrequency are matched with the usual "sy" prefix of the syndication module
+ */
+typedef struct
+{
+   // BLOG_POSTs, emptied when a parse starts
+   RECORD_ARRAY sPosts;
+   // Minutes
+   uint32_t ulTtl;
+   // "hourly", "daily", "weekly", "monthly" or "yearly"
+   char szUpdatePeriod[16];
+   // Updates per period, 0 is taken as 1
+   uint32_t ulUpdateFrequency;
+} RSS_FEED;
+
+/* 
+   Change made during a batch, journaled once the batch ends
+ */
+typedef struct
+{
+   DATABASE_JOURNAL_TYPE eType;
+   BLOG_POST sPost;
+} DATABASE_CHANGE;
+
+/* 
+   Database file, mapped & used as it is instead of being parsed:
+   DATABASE_SNAPSHOT_HEADER
+   DATABASE_SNAPSHOT_RECORD per post, index 0 being the newest
+   Hashes & then values of every slot of the link index, see HashIndex_Load
+   String pool of NULL terminated titles & links
+   Offsets are from the start of the file, sections are 8 byte aligned
+ */
+typedef struct
+{
+   uint32_t ulMagic;
+   uint32_t ulVersion;
+   uint32_t ulPostCount;
+   // Same as DATABASE's
+   uint32_t ulJournalSequence;
+   uint32_t ulIndexCapacity;
+   uint32_t ulReserved;
+   uint64_t ullRecordsOffset;
+   uint64_t ullIndexOffset;
+   uint64_t ullStringsOffset;
+   uint64_t ullStringsSize;
+} DATABASE_SNAPSHOT_HEADER;
+
+typedef struct
+{
+   // Offsets into the string pool
+   uint32_t ulTitle;
+   uint32_t ulLink;
+   uint32_t ulTimesShared;
+   uint32_t ulReserved;
+   int64_t llPubDate;
+} DATABASE_SNAPSHOT_RECORD;
+
+/* 
+   Database file being written on a background thread
+ */
+typedef struct
+{
+   // Copy of the posts when the compaction started
+   DATABASE sSnapshot;
+   // Files of the database being compacted, the thread doesn't touch its DATABASE_STATE
+   const char *pszFile;
+   const char *pszOldJournalFile;
+   pthread_t sThread;
+   bool bStarted;
+   ERROR_CODE eResult;
+} DATABASE_COMPACTION;
+
+/* 
+   Everything a DATABASE_HANDLE refers to, databases share nothing but the compiled schemas
+ */
+struct DATABASE_STATE
+{
+   char szFile[DATABASE_MAX_FILE_LEN + 1];
+   char szXmlFile[DATABASE_MAX_FILE_LEN + 1];
+   char szJournalFile[DATABASE_MAX_FILE_LEN + 1];
+   char szOldJournalFile[DATABASE_MAX_FILE_LEN + 1];
+   DATABASE sList;
+   // Normalized link -> order in which the post was added. Posts are only ever added at index 0,
+   // so a post's index in sList is ( post count - 1 - order )
+   HASH_INDEX sIndex;
+   // Same orders, bucketed by times shared & oldest first within a bucket
+   BUCKET_QUEUE sShareQueue;
+   // Feed being parsed by Database_BeginRefresh/Database_EndRefresh
+   XML_PUSH_PARSER *psRefreshParser;
+   RSS_FEED sRefreshFeed;
+   // Hints of the last feed refreshed
+   FEED_HINTS sFeedHints;
+   // Set once the rest of the feed is no longer needed
+   bool bRefreshStopped;
+   // 0 if every post of the feed is looked at
+   uint32_t ulRefreshMaxPosts;
+   // Set once the database is in memory, it is only read from the disk once
+   bool bResident;
+   // Number of Database_BeginBatch calls which haven't ended yet
+   uint32_t ulBatchDepth;
+   // Set when the database file has to be written at the end of the batch
+   bool bBatchDirty;
+   // DATABASE_CHANGEs of the batch, appended to the journal in one go when it ends
+   RECORD_ARRAY sBatchChanges;
+   // Every change is appended to the journal instead of rewriting the database file
+   JOURNAL sJournal;
+   // Sequence number of the last change
+   uint32_t ulSequence;
+   DATABASE_COMPACTION sCompaction;
+};
 
+// Static variables
 static const XML_ITEM s_asPost[] = 
 {
    XML_STR( "title", BLOG_POST, szTitle ),
    XML_STR( "link", BLOG_POST, szLink ),
-   XML_STR( "times_shared", BLOG_POST, szTimesShared )
+   XML_U32( "times_shared", BLOG_POST, ulTimesShared ),
+   XML_TIME( "pubDate", BLOG_POST, tPubDate )
 };
 
 static const XML_ITEM s_asPosts[] =
 {
-   XML_STR( "count", DATABASE, szPostCount ),
-   XML_ARRAY( "post", DATABASE, asList, s_asPost, ARRAY_COUNT( s_asPost ), ARRAY_COUNT( s_sList.asList ) )
+   XML_U32( "count", DATABASE, ulPostCount ),
+   XML_U32( "journal", DATABASE, ulJournalSequence ),
+   XML_DYNAMIC_ARRAY( "post", DATABASE, sPosts, BLOG_POST, s_asPost, ARRAY_COUNT( s_asPost ) )
+};
+
+static const XML_ITEM s_asRssPosts[] =
+{
+   XML_DYNAMIC_ARRAY( "item", DATABASE, sPosts, BLOG_POST, s_asPost, ARRAY_COUNT( s_asPost ) )
+};
+
+static const XML_ITEM s_asRssFeed[] =
+{
+   XML_U32( "ttl", RSS_FEED, ulTtl ),
+   XML_STR( "sy:updatePeriod", RSS_FEED, szUpdatePeriod ),
+   XML_U32( "sy:updateFrequency", RSS_FEED, ulUpdateFrequency ),
+   XML_DYNAMIC_ARRAY( "item", RSS_FEED, sPosts, BLOG_POST, s_asPost, ARRAY_COUNT( s_asPost ) )
 };
 
+// Compiled once on first use & kept for the lifetime of the process
+static XML_SCHEMA *s_psPostsSchema = _null_;
+static XML_SCHEMA *s_psRssPostsSchema = _null_;
+static XML_SCHEMA *s_psRssFeedSchema = _null_;
+
+// Schemas are compiled by whichever thread needs them first, whatever the database
+static pthread_mutex_t s_sSchemaLock = PTHREAD_MUTEX_INITIALIZER;
+
 // Static functions
-static ERROR_CODE CreateDatabaseFile( void );
-static ERROR_CODE ReadDatabaseFile( void );
-static ERROR_CODE ReadFeedXmlFile( const char *pszFileName );
-static ERROR_CODE DebugDatabaseFile( void );
-static ERROR_CODE Database_FindIndex( const BLOG_POST *psPost, int32_t *plIndex );
+static ERROR_CODE CreateDatabaseFile( DATABASE_HANDLE hDatabase );
+static ERROR_CODE ReadDatabaseFile( DATABASE_HANDLE hDatabase );
+static ERROR_CODE LoadDatabase( DATABASE_HANDLE hDatabase );
+static ERROR_CODE ReadDatabaseXml( DATABASE_HANDLE hDatabase, const char *pszFileName );
+static ERROR_CODE Database_WriteSnapshot( const char *pszFileName, const DATABASE *psDatabase );
+static ERROR_CODE Database_ReadSnapshot( DATABASE_HANDLE hDatabase, const char *pszFileName );
+static ERROR_CODE Database_CheckSnapshot( const DATABASE_SNAPSHOT_HEADER *psHeader, uint64_t ullFileSize );
+static ERROR_CODE Database_LoadSnapshot( DATABASE_HANDLE hDatabase, const void *pvFile );
+static ERROR_CODE Database_SnapshotString( const char *pcStrings, uint64_t ullStringsSize, uint32_t ulOffset, char *pszString, uint32_t ulBufferSize );
+static ERROR_CODE ReadFeedXmlFile( DATABASE_HANDLE hDatabase, const char *pszFileName );
+static ERROR_CODE GetSchema( const XML_ITEM *pasItems, uint32_t ulCount, XML_SCHEMA **ppsCompiled, const XML_SCHEMA **ppsSchema );
+static ERROR_CODE GetFeedSchema( const XML_SCHEMA **ppsSchema );
+static ERROR_CODE GetRefreshSchema( const XML_SCHEMA **ppsSchema );
+static void Database_ReplacePosts( DATABASE_HANDLE hDatabase, DATABASE *psList );
+static void Database_ReadFeedHints( const RSS_FEED *psFeed, FEED_HINTS *psHints );
+static ERROR_CODE Database_ScheduleRefresh( const time_t *patPubDates, uint32_t ulCount, const FEED_HINTS *psHints, time_t tNow, uint32_t *pulSeconds );
+static int Database_CompareTime( const void *pvFirst, const void *pvSecond );
+static ERROR_CODE OnRefreshPost( void *pvRecord, uint32_t ulIndex, void *pvDatabase );
+static ERROR_CODE OnParsedPost( void *pvRecord, uint32_t ulIndex, void *pvMaxPosts );
+static uint32_t GetMaxFeedPosts( void );
+static ERROR_CODE DebugDatabaseFile( DATABASE_HANDLE hDatabase );
+static BLOG_POST *Database_Post( DATABASE_HANDLE hDatabase, uint32_t ulIndex );
+static void Database_TrimPosts( RECORD_ARRAY *psPosts );
+static ERROR_CODE Database_FindIndex( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost, int32_t *plIndex );
+static ERROR_CODE Database_RebuildIndex( DATABASE_HANDLE hDatabase );
+static ERROR_CODE Database_RebuildShareQueue( DATABASE_HANDLE hDatabase );
+static uint64_t Database_HashLink( const char *pszLink );
+static void Database_NormalizeLink( const char *pszLink, char *pszNormalized, uint32_t ulBufferSize );
+static bool Database_IndexMatch( uint32_t ulOrder, const void *pvKey );
+static ERROR_CODE Database_QueuePost( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost, uint32_t ulOrder );
+static ERROR_CODE Database_InsertPost( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost );
+static ERROR_CODE Database_SharePost( DATABASE_HANDLE hDatabase, int32_t lIndex );
+static ERROR_CODE Database_Journal( DATABASE_HANDLE hDatabase, DATABASE_JOURNAL_TYPE eType, uint32_t ulIndex, uint32_t ulCount );
+static ERROR_CODE Database_JournalBatch( DATABASE_HANDLE hDatabase );
+static void Database_CheckJournalSize( DATABASE_HANDLE hDatabase );
+static ERROR_CODE Database_ReplayChange( uint32_t ulSequence, uint32_t ulType, const void *pvData, uint32_t ulSize, void *pvDatabase );
+static ERROR_CODE Database_ReplayJournals( DATABASE_HANDLE hDatabase );
+static ERROR_CODE Database_StartCompaction( DATABASE_HANDLE hDatabase );
+static void *Database_CompactionThread( void *pvCompaction );
 /* 
    Counts the number of valid posts in a given list. The count stops at the first invalid post
    @param (INPUT):      pasList  -> List of Blog Posts
@@ -50,11 +261,64 @@ static ERROR_CODE Database_FindIndex( const BLOG_POST *psPost, int32_t *plIndex
  */
 static ERROR_CODE Database_CountPostsInList( const BLOG_POST *pasList, uint32_t ulArraySize, uint32_t *pulCount );
 
-ERROR_CODE Database_Init( void )
+ERROR_CODE Database_Open( const char *pszName, DATABASE_HANDLE *phDatabase )
+{
+   DATABASE_HANDLE hDatabase = _null_;
+
+   RETURN_ON_NULL( pszName );
+   RETURN_ON_NULL( phDatabase );
+   UTIL_ASSERT( ( strlen( pszName ) > 0 && strlen( pszName ) <= DATABASE_MAX_NAME_LEN ), INVALID_ARG );
+
+   hDatabase = calloc( 1, sizeof( struct DATABASE_STATE ) );
+   UTIL_ASSERT( hDatabase, NO_MEMORY );
+
+   snprintf( hDatabase->szFile, sizeof( hDatabase->szFile ), "%s%s", pszName, DATABASE_FILE_EXTENSION );
+   snprintf( hDatabase->szXmlFile, sizeof( hDatabase->szXmlFile ), "%s%s", pszName, DATABASE_XML_EXTENSION );
+   snprintf( hDatabase->szJournalFile, sizeof( hDatabase->szJournalFile ), "%s%s", pszName, DATABASE_JOURNAL_EXTENSION );
+   snprintf( hDatabase->szOldJournalFile, sizeof( hDatabase->szOldJournalFile ), "%s%s", pszName, DATABASE_OLD_JOURNAL_EXTENSION );
+   hDatabase->sList.sPosts.ulRecordSize = sizeof( BLOG_POST );
+   hDatabase->sRefreshFeed.sPosts.ulRecordSize = sizeof( BLOG_POST );
+   hDatabase->sBatchChanges.ulRecordSize = sizeof( DATABASE_CHANGE );
+   hDatabase->sCompaction.sSnapshot.sPosts.ulRecordSize = sizeof( BLOG_POST );
+   hDatabase->sCompaction.pszFile = hDatabase->szFile;
+   hDatabase->sCompaction.pszOldJournalFile = hDatabase->szOldJournalFile;
+
+   *phDatabase = hDatabase;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE Database_Close( DATABASE_HANDLE hDatabase )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+
+   // Whatever the compaction didn't write is still in the journal
+   eRet = Database_Flush( hDatabase );
+   Database_CancelRefresh( hDatabase );
+   Journal_Close( &hDatabase->sJournal );
+   RecordArray_Free( &hDatabase->sList.sPosts );
+   RecordArray_Free( &hDatabase->sRefreshFeed.sPosts );
+   RecordArray_Free( &hDatabase->sBatchChanges );
+   RecordArray_Free( &hDatabase->sCompaction.sSnapshot.sPosts );
+   HashIndex_Free( &hDatabase->sIndex );
+   BucketQueue_Free( &hDatabase->sShareQueue );
+   free( hDatabase );
+
+   return eRet;
+}
+
+ERROR_CODE Database_Init( DATABASE_HANDLE hDatabase )
 {
    ERROR_CODE eRet = NO_ERROR;
 
-   eRet = ReadDatabaseFile();
+   RETURN_ON_NULL( hDatabase );
+
+   if( hDatabase->bResident )
+      return NO_ERROR;
+
+   eRet = LoadDatabase( hDatabase );
    if( ISERROR( eRet ) )
    {
       char szRSSfeedFile[MAX_FILENAME_LEN + 1] = { 0, };
@@ -62,253 +326,1317 @@ ERROR_CODE Database_Init( void )
       // Try to instantiate the database file from xml file
       RETURN_ON_FAIL( Config_GetRssFilename( szRSSfeedFile, sizeof( szRSSfeedFile ) ) );
 
-      RETURN_ON_FAIL( ReadFeedXmlFile( szRSSfeedFile ) );
-      // Create Database file
-      eRet = CreateDatabaseFile( );
+      // A fresh install has no feed file either, it starts from an empty database that the first refresh fills
+      if( eRet != NOT_FOUND || access( szRSSfeedFile, F_OK ) == 0 )
+      {
+         RETURN_ON_FAIL( ReadFeedXmlFile( hDatabase, szRSSfeedFile ) );
+         RETURN_ON_FAIL( Database_RebuildIndex( hDatabase ) );
+      }
+      // Changes journaled before the database file went missing
+      hDatabase->ulSequence = 0;
+      RETURN_ON_FAIL( Database_ReplayJournals( hDatabase ) );
+      // Create Database file, an empty database only has a journal until it is written with its first posts
+      eRet = ( hDatabase->sList.sPosts.ulCount == 0 ) ? NO_ERROR : CreateDatabaseFile( hDatabase );
+      hDatabase->bResident = !ISERROR( eRet );
    }
 
    return eRet;
 }
 
-ERROR_CODE Database_RefreshDatabase( void )
+/* 
+   Reads the database file, or the database.xml of an older version which is converted to one.
+   NOT_FOUND when there is neither
+ */
+static ERROR_CODE LoadDatabase( DATABASE_HANDLE hDatabase )
+{
+   if( access( hDatabase->szFile, F_OK ) != 0 && access( hDatabase->szXmlFile, F_OK ) != 0 )
+   {
+      return NOT_FOUND;
+   }
+
+   if( !ISERROR( ReadDatabaseFile( hDatabase ) ) )
+   {
+      hDatabase->bResident = true;
+      return NO_ERROR;
+   }
+
+   // The journal goes on from where the older version left it
+   RETURN_ON_FAIL( ReadDatabaseXml( hDatabase, hDatabase->szXmlFile ) );
+   hDatabase->ulSequence = hDatabase->sList.ulJournalSequence;
+   RETURN_ON_FAIL( Database_ReplayJournals( hDatabase ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+   hDatabase->bResident = true;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE Database_RefreshDatabase( DATABASE_HANDLE hDatabase )
 {
-   uint32_t ulRssFilePostCount = 0;
-   DATABASE sTemp = {0, };
    char szRSSfeedFile[MAX_FILENAME_LEN + 1] = { 0, };
-   bool bNeedToRewrite = false;
+   char acChunk[DATABASE_READ_CHUNK];
+   FILE *psFile = _null_;
+   size_t ulRead = 0;
+   ERROR_CODE eRet = NO_ERROR;
 
-   memset( &s_sList, 0, sizeof( DATABASE ) );
+   RETURN_ON_NULL( hDatabase );
 
    // Try to instantiate the database file from xml file
    RETURN_ON_FAIL( Config_GetRssFilename( szRSSfeedFile, sizeof( szRSSfeedFile ) ) );
 
-   RETURN_ON_FAIL( ReadFeedXmlFile( szRSSfeedFile ) );
-   
-   sTemp = s_sList;
-   RETURN_ON_FAIL( Database_CountPostsInList( sTemp.asList, ARRAY_COUNT( sTemp.asList ), &ulRssFilePostCount ) );
+   psFile = fopen( szRSSfeedFile, "rb" );
+   UTIL_ASSERT( psFile, FILE_ERROR );
 
-   RETURN_ON_FAIL( ReadDatabaseFile() );
+   eRet = Database_BeginRefresh( hDatabase, GetMaxFeedPosts() );
+   // Only read as much of the file as is needed
+   while( !ISERROR( eRet ) && ( ulRead = fread( acChunk, 1, sizeof( acChunk ), psFile ) ) > 0 )
+   {
+      eRet = Database_PushRefreshData( hDatabase, acChunk, ulRead );
+   }
+   fclose( psFile );
 
-   for( int x = ulRssFilePostCount - 1; x >=0 ; x )
+   if( ISERROR( eRet ) && eRet != STOPPED )
    {
-      if( Database_IsUniquePost( &sTemp.asList[x] ) )
-      {
-         RETURN_ON_FAIL( Database_AddNewItem( &sTemp.asList[x] ) );
-         bNeedToRewrite = true;
-      }
+      Database_CancelRefresh( hDatabase );
+      return eRet;
+   }
+
+   return Database_EndRefresh( hDatabase );
+}
+
+ERROR_CODE Database_RefreshDatabaseFromMemory( DATABASE_HANDLE hDatabase, const char *pcFeed, size_t ulSize )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( pcFeed );
+   UTIL_ASSERT( ( ulSize > 0 ), INVALID_ARG );
+
+   RETURN_ON_FAIL( Database_BeginRefresh( hDatabase, GetMaxFeedPosts() ) );
+
+   eRet = Database_PushRefreshData( hDatabase, pcFeed, ulSize );
+   if( ISERROR( eRet ) && eRet != STOPPED )
+   {
+      Database_CancelRefresh( hDatabase );
+      return eRet;
+   }
+
+   return Database_EndRefresh( hDatabase );
+}
+
+ERROR_CODE Database_BeginRefresh( DATABASE_HANDLE hDatabase, uint32_t ulMaxPosts )
+{
+   const XML_SCHEMA *psSchema = _null_;
+
+   RETURN_ON_NULL( hDatabase );
+
+   Database_CancelRefresh( hDatabase );
+
+   RETURN_ON_FAIL( GetRefreshSchema( &psSchema ) );
+   // Posts are checked against the database as soon as they are parsed, a missing database is created
+   RETURN_ON_FAIL( Database_Init( hDatabase ) );
+
+   // The feed's posts are emptied by the parser, their memory is reused. A hint missing from the feed stays 0
+   hDatabase->ulRefreshMaxPosts = ulMaxPosts;
+   hDatabase->sRefreshFeed.ulTtl = 0;
+   hDatabase->sRefreshFeed.szUpdatePeriod[0] = '\0';
+   hDatabase->sRefreshFeed.ulUpdateFrequency = 0;
+
+   return xmlWrapperPushStart( psSchema, &hDatabase->sRefreshFeed, OnRefreshPost, hDatabase, &hDatabase->psRefreshParser );
+}
+
+ERROR_CODE Database_PushRefreshData( DATABASE_HANDLE hDatabase, const char *pcChunk, size_t ulSize )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( hDatabase->psRefreshParser );
+
+   // Everything after the last post needed is skipped
+   if( hDatabase->bRefreshStopped )
+      return STOPPED;
+
+   eRet = xmlWrapperPushChunk( hDatabase->psRefreshParser, pcChunk, ulSize );
+   hDatabase->bRefreshStopped = ( eRet == STOPPED );
+
+   return eRet;
+}
+
+ERROR_CODE Database_EndRefresh( DATABASE_HANDLE hDatabase )
+{
+   BLOG_POST *pasPosts = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( hDatabase->psRefreshParser );
+
+   eRet = xmlWrapperPushFinish( hDatabase->psRefreshParser );
+   hDatabase->psRefreshParser = _null_;
+   hDatabase->bRefreshStopped = false;
+   // A stopped parse never reaches the end of the document
+   if( eRet != STOPPED )
+   {
+      RETURN_ON_FAIL( eRet );
+   }
+
+   // The post the parse stopped at is known & the feed can list the same post twice,
+   // so every post is checked again. It is a single index lookup
+   RETURN_ON_FAIL( RecordArray_Linearize( &hDatabase->sRefreshFeed.sPosts, ( void ** )&pasPosts ) );
+   // The channel's elements come before its items, a stopped parse has them as well
+   Database_ReadFeedHints( &hDatabase->sRefreshFeed, &hDatabase->sFeedHints );
+
+   return pasPosts ? Database_MergePosts( hDatabase, pasPosts, hDatabase->sRefreshFeed.sPosts.ulCount ) : NO_ERROR;
+}
+
+void Database_CancelRefresh( DATABASE_HANDLE hDatabase )
+{
+   if( hDatabase == _null_ )
+      return;
+
+   xmlWrapperPushFree( hDatabase->psRefreshParser );
+   hDatabase->psRefreshParser = _null_;
+   hDatabase->bRefreshStopped = false;
+}
+
+ERROR_CODE Database_ParseFeed( const char *pcFeed, size_t ulSize, uint32_t ulMaxPosts, DATABASE_FEED *psFeed )
+{
+   const XML_SCHEMA *psSchema = _null_;
+   XML_PUSH_PARSER *psParser = _null_;
+   RSS_FEED sFeed = { { _null_, sizeof( BLOG_POST ), 0, 0, 0 }, 0, { 0, }, 0 };
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( pcFeed );
+   RETURN_ON_NULL( psFeed );
+   UTIL_ASSERT( ( ulSize > 0 ), INVALID_ARG );
+
+   RETURN_ON_FAIL( GetRefreshSchema( &psSchema ) );
+   // Pushed as a single chunk, the parser stops as soon as the last post needed is parsed
+   RETURN_ON_FAIL( xmlWrapperPushStart( psSchema, &sFeed, OnParsedPost, &ulMaxPosts, &psParser ) );
+   eRet = xmlWrapperPushChunk( psParser, pcFeed, ulSize );
+   if( ISERROR( eRet ) && eRet != STOPPED )
+   {
+      xmlWrapperPushFree( psParser );
+   }
+   else
+   {
+      eRet = xmlWrapperPushFinish( psParser );
    }
 
-   if( bNeedToRewrite )
+   if( ISERROR( eRet ) && eRet != STOPPED )
    {
-      RETURN_ON_FAIL( CreateDatabaseFile() );
+      RecordArray_Free( &sFeed.sPosts );
+      return eRet;
    }
 
+   psFeed->sPosts = sFeed.sPosts;
+   Database_ReadFeedHints( &sFeed, &psFeed->sHints );
+
    return NO_ERROR;
 }
 
+ERROR_CODE Database_MergeFeed( DATABASE_HANDLE hDatabase, DATABASE_FEED *psFeed )
+{
+   BLOG_POST *pasPosts = _null_;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psFeed );
 
-static ERROR_CODE ReadFeedXmlFile( const char *pszFileName )
+   RETURN_ON_FAIL( RecordArray_Linearize( &psFeed->sPosts, ( void ** )&pasPosts ) );
+
+   return pasPosts ? Database_MergePosts( hDatabase, pasPosts, psFeed->sPosts.ulCount ) : NO_ERROR;
+}
+
+void Database_FreeFeed( DATABASE_FEED *psFeed )
 {
-   const XML_ITEM asRssPosts[] =
+   if( psFeed )
    {
-      XML_ARRAY( "item", DATABASE, asList, s_asPost, ARRAY_COUNT( s_asPost ), ARRAY_COUNT( s_sList.asList ) )
-   };
+      RecordArray_Free( &psFeed->sPosts );
+      memset( &psFeed->sHints, 0, sizeof( FEED_HINTS ) );
+   }
+}
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+ERROR_CODE Database_GetFeedHints( DATABASE_HANDLE hDatabase, FEED_HINTS *psHints )
+{
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psHints );
 
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asRssPosts, ARRAY_COUNT( asRssPosts ), &s_sList ) );
+   *psHints = hDatabase->sFeedHints;
 
    return NO_ERROR;
 }
 
-ERROR_CODE CreateDatabaseFile( void )
+ERROR_CODE Database_GetRefreshInterval( DATABASE_HANDLE hDatabase, const FEED_HINTS *psHints, time_t tNow, uint32_t *pulSeconds )
 {
-   uint32_t x = 0;
-   ERROR_CODE eRet = NO_ERROR;
+   time_t atPubDates[DATABASE_SCHEDULE_POSTS] = { 0, };
+   uint32_t ulDated = 0;
 
-   RETURN_ON_FAIL( Database_CountPostsInList( s_sList.asList, ARRAY_COUNT( s_sList.asList ), &x ) );
-   
-   if( x != 0 )
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psHints );
+   RETURN_ON_NULL( pulSeconds );
+
+   // Posts are added at index 0, the newest ones are at the start. Older versions didn't keep the dates
+   for( uint32_t x = 0; x < hDatabase->sList.sPosts.ulCount && ulDated < DATABASE_SCHEDULE_POSTS; x++ )
    {
-      DBG_PRINTF( "Writing [%u] posts onto the database file", x );
-      snprintf( s_sList.szPostCount, sizeof( s_sList.szPostCount ), "%u", x );
-      eRet = xmlWrapperWriteFile( DATABASE_FILE, s_asPosts, ARRAY_COUNT( s_asPosts ), &s_sList );
+      const BLOG_POST *psPost = Database_Post( hDatabase, x );
+
+      if( psPost->tPubDate != 0 )
+      {
+         atPubDates[ulDated++] = psPost->tPubDate;
+      }
+   }
+
+   return Database_ScheduleRefresh( atPubDates, ulDated, psHints, tNow, pulSeconds );
+}
+
+/* 
+   Converts the channel elements of a feed into seconds
+ */
+static void Database_ReadFeedHints( const RSS_FEED *psFeed, FEED_HINTS *psHints )
+{
+   static const struct
+   {
+      const char *pszPeriod;
+      uint32_t ulSeconds;
+   } asPeriods[] =
+   {
+      { "hourly", 60 * 60 },
+      { "daily", 24 * 60 * 60 },
+      { "weekly", 7 * 24 * 60 * 60 },
+      { "monthly", 30 * 24 * 60 * 60 },
+      { "yearly", 365 * 24 * 60 * 60 }
+   };
+   uint32_t ulFrequency = ( psFeed->ulUpdateFrequency == 0 ) ? 1 : psFeed->ulUpdateFrequency;
+
+   // Minutes which don't fit in seconds aren't a sensible ttl
+   psHints->ulTtl = ( psFeed->ulTtl < UINT32_MAX / 60 ) ? psFeed->ulTtl * 60 : 0;
+   psHints->ulUpdateInterval = 0;
+   for( uint32_t x = 0; x < ARRAY_COUNT( asPeriods ); x++ )
+   {
+      // Blogging software surrounds the period with whitespace
+      if( strstr( psFeed->szUpdatePeriod, asPeriods[x].pszPeriod ) != _null_ )
+      {
+         psHints->ulUpdateInterval = asPeriods[x].ulSeconds / ulFrequency;
+      }
+   }
+}
+
+/* 
+   Works out how long to wait before fetching the feed again
+   The blog's own publishing rate, the median interval between its newest posts, is trusted over
+   sy:updatePeriod which most blogging software sets to the same value for every blog
+   A blog which has been quiet for longer than that is fetched less & less often, half the time it
+   has been quiet, & the feed's ttl is never cut short
+   Publication dates can be in any order, NOT_FOUND if neither them nor the feed tell how often the blog is updated
+ */
+static ERROR_CODE Database_ScheduleRefresh( const time_t *patPubDates, uint32_t ulCount, const FEED_HINTS *psHints, time_t tNow, uint32_t *pulSeconds )
+{
+   time_t atSorted[DATABASE_SCHEDULE_POSTS] = { 0, };
+   time_t atIntervals[DATABASE_SCHEDULE_POSTS] = { 0, };
+   time_t tInterval = 0;
 
-      DebugDatabaseFile( );
+   RETURN_ON_NULL( pulSeconds );
+   UTIL_ASSERT( ( ulCount <= DATABASE_SCHEDULE_POSTS ), INVALID_ARG );
+
+   if( ulCount > 1 )
+   {
+      memcpy( atSorted, patPubDates, ulCount * sizeof( time_t ) );
+      qsort( atSorted, ulCount, sizeof( time_t ), Database_CompareTime );
+      // The median isn't thrown off by a burst of posts or a long break
+      for( uint32_t x = 0; x + 1 < ulCount; x++ )
+      {
+         atIntervals[x] = atSorted[x + 1] - atSorted[x];
+      }
+      qsort( atIntervals, ulCount - 1, sizeof( time_t ), Database_CompareTime );
+      tInterval = atIntervals[( ulCount - 1 ) / 2];
+   }
+   else if( psHints->ulUpdateInterval != 0 )
+   {
+      atSorted[0] = ( ulCount == 1 ) ? patPubDates[0] : 0;
+      tInterval = psHints->ulUpdateInterval;
    }
    else
    {
-      DBG_PRINTF( "Database Count is 0" );
-      eRet = INVALID_ARG;
+      return NOT_FOUND;
+   }
+
+   // atSorted[ulCount - 1] is the newest post
+   if( ulCount > 0 && tNow > atSorted[ulCount - 1] && ( tNow - atSorted[ulCount - 1] ) / 2 > tInterval )
+   {
+      tInterval = ( tNow - atSorted[ulCount - 1] ) / 2;
+   }
+   if( tInterval < psHints->ulTtl )
+   {
+      tInterval = psHints->ulTtl;
+   }
+
+   *pulSeconds = ( tInterval > UINT32_MAX ) ? UINT32_MAX : ( uint32_t )tInterval;
+
+   return NO_ERROR;
+}
+
+/* 
+   Sorts times in ascending order
+ */
+static int Database_CompareTime( const void *pvFirst, const void *pvSecond )
+{
+   time_t tFirst = *( const time_t * )pvFirst;
+   time_t tSecond = *( const time_t * )pvSecond;
+
+   return ( tFirst > tSecond ) - ( tFirst < tSecond );
+}
+
+static ERROR_CODE OnRefreshPost( void *pvRecord, uint32_t ulIndex, void *pvDatabase )
+{
+   const BLOG_POST *psPost = ( const BLOG_POST * )pvRecord;
+   DATABASE_HANDLE hDatabase = ( DATABASE_HANDLE )pvDatabase;
+
+   // The feed is newest first, every post after a known one is known as well
+   // Posts without a title or a link are never added
+   if( strlen( psPost->szTitle ) > 0 && strlen( psPost->szLink ) > 0 && !Database_IsUniquePost( hDatabase, psPost ) )
+      return STOPPED;
+
+   if( hDatabase->ulRefreshMaxPosts != 0 && ulIndex + 1 >= hDatabase->ulRefreshMaxPosts )
+   {
+      DBG_PRINTF( "Reached the limit of [%u] feed posts", hDatabase->ulRefreshMaxPosts );
+      return STOPPED;
+   }
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE OnParsedPost( void *pvRecord, uint32_t ulIndex, void *pvMaxPosts )
+{
+   const uint32_t ulMaxPosts = *( const uint32_t * )pvMaxPosts;
+
+   ( void )pvRecord;
+
+   return ( ulMaxPosts != 0 && ulIndex + 1 >= ulMaxPosts ) ? STOPPED : NO_ERROR;
+}
+
+static uint32_t GetMaxFeedPosts( void )
+{
+   uint32_t ulMaxPosts = 0;
+
+   // No limit if the config can't be read
+   if( ISERROR( Config_GetMaxFeedItems( &ulMaxPosts ) ) )
+   {
+      ulMaxPosts = 0;
+   }
+
+   return ulMaxPosts;
+}
+
+/* 
+   Compiles a schema the first time it is needed
+   Databases are used by several threads at once, the compiled schemas are only read
+ */
+static ERROR_CODE GetSchema( const XML_ITEM *pasItems, uint32_t ulCount, XML_SCHEMA **ppsCompiled, const XML_SCHEMA **ppsSchema )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   pthread_mutex_lock( &s_sSchemaLock );
+   if( *ppsCompiled == _null_ )
+   {
+      eRet = xmlWrapperCompileSchema( pasItems, ulCount, ppsCompiled );
    }
+   *ppsSchema = *ppsCompiled;
+   pthread_mutex_unlock( &s_sSchemaLock );
 
    return eRet;
 }
 
-ERROR_CODE ReadDatabaseFile( void )
+static ERROR_CODE GetFeedSchema( const XML_SCHEMA **ppsSchema )
+{
+   return GetSchema( s_asRssPosts, ARRAY_COUNT( s_asRssPosts ), &s_psRssPostsSchema, ppsSchema );
+}
+
+static ERROR_CODE GetRefreshSchema( const XML_SCHEMA **ppsSchema )
 {
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   RETURN_ON_FAIL( xmlWrapperParseFile( DATABASE_FILE, s_asPosts, ARRAY_COUNT( s_asPosts ), &s_sList ) );
+   return GetSchema( s_asRssFeed, ARRAY_COUNT( s_asRssFeed ), &s_psRssFeedSchema, ppsSchema );
+}
 
-   return DebugDatabaseFile();
+/* 
+   Replaces the posts of the database with a list parsed on the side, the list is emptied
+   The index & the share queue have to be rebuilt afterwards
+ */
+static void Database_ReplacePosts( DATABASE_HANDLE hDatabase, DATABASE *psList )
+{
+   Database_TrimPosts( &psList->sPosts );
+   RecordArray_Free( &hDatabase->sList.sPosts );
+   hDatabase->sList = *psList;
+   memset( &psList->sPosts, 0, sizeof( RECORD_ARRAY ) );
 }
 
-ERROR_CODE DebugDatabaseFile( void )
+static ERROR_CODE ReadFeedXmlFile( DATABASE_HANDLE hDatabase, const char *pszFileName )
 {
-#if DEBUG_DATABASE
-   uint32_t ulCount = atoi( s_sList.szPostCount );
+   const XML_SCHEMA *psSchema = _null_;
+   DATABASE sList = { 0, 0, { _null_, sizeof( BLOG_POST ), 0, 0, 0 } };
+   ERROR_CODE eRet = NO_ERROR;
 
-   DBG_PRINTF( "Listing [%u] posts", ulCount );
-   for( int x = 0; x < ulCount; x++ )
+   RETURN_ON_FAIL( GetFeedSchema( &psSchema ) );
+
+   // The database is left as it was if the file can't be parsed
+   eRet = xmlWrapperParseFileWithSchema( pszFileName, psSchema, &sList );
+   if( ISERROR( eRet ) )
    {
-      DBG_PRINTF( "----------------------------------------" );
-      DBG_PRINTF( "Item#         = [%d]", x );
-      DBG_PRINTF( "Title         = [%0.20s]", s_sList.asList[x].szTitle );
-      DBG_PRINTF( "Link          = [%0.20s]", s_sList.asList[x].szLink );
-      DBG_PRINTF( "TimesShared   = [%s]", s_sList.asList[x].szTimesShared );
-      DBG_PRINTF( "----------------------------------------" );
+      RecordArray_Free( &sList.sPosts );
+      return eRet;
    }
-#endif
+   Database_ReplacePosts( hDatabase, &sList );
+
    return NO_ERROR;
 }
 
-ERROR_CODE Database_GetOldestLeastSharedPost(BLOG_POST * psPost)
+ERROR_CODE CreateDatabaseFile( DATABASE_HANDLE hDatabase )
 {
-   const uint32_t ulPostCount = atol( s_sList.szPostCount );
-   uint32_t ulOldestCount = UINT32_MAX, ulIndexFound = UINT32_MAX;
+   const uint32_t x = hDatabase->sList.sPosts.ulCount;
    ERROR_CODE eRet = NO_ERROR;
 
-   RETURN_ON_NULL( psPost );
-   memset( psPost, 0, sizeof( BLOG_POST ) );
+   if( hDatabase->ulBatchDepth > 0 )
+   {
+      hDatabase->bBatchDirty = true;
+      return NO_ERROR;
+   }
 
-   if( ulPostCount == 0 || ( ulPostCount > ARRAY_COUNT( s_sList.asList ) ) )
-      return NOT_FOUND;
+   // The files have to be written in order. A failed compaction is made good by this file, which
+   // holds every change of the journal it was compacting
+   eRet = Database_Flush( hDatabase );
+   if( ISERROR( eRet ) )
+   {
+      DBG_PRINTF( "Compaction failed = [%d], the database file is written instead", eRet );
+   }
 
-   for( uint32_t x = 0; x < ulPostCount; x++ )
+   if( x != 0 )
    {
-      uint32_t ulTemp = atol( s_sList.asList[x].szTimesShared );
-      if( ulOldestCount >= ulTemp )
+      DBG_PRINTF( "Writing [%u] posts onto the database file", x );
+      hDatabase->sList.ulPostCount = x;
+      hDatabase->sList.ulJournalSequence = hDatabase->ulSequence;
+      eRet = Database_WriteSnapshot( hDatabase->szFile, &hDatabase->sList );
+
+      // Every change is in the file now
+      if( !ISERROR( eRet ) )
       {
-         // By making it >=, we shall make sure we use the oldest & least
-         ulOldestCount = ulTemp;
-         ulIndexFound = x;
+         unlink( hDatabase->szOldJournalFile );
+         if( !hDatabase->sJournal.bOpen )
+         {
+            eRet = Journal_Open( &hDatabase->sJournal, hDatabase->szJournalFile );
+         }
+         if( !ISERROR( eRet ) )
+         {
+            eRet = Journal_Truncate( &hDatabase->sJournal );
+         }
       }
-   }
 
-   if( ulIndexFound < ARRAY_COUNT( s_sList.asList ) )
-   {
-      *psPost = s_sList.asList[ulIndexFound];
+      DebugDatabaseFile( hDatabase );
    }
    else
    {
-      DBG_PRINTF( "Unable to find a valid index, it is [%u]", ulIndexFound );
-      eRet = NOT_FOUND;
+      DBG_PRINTF( "Database Count is 0" );
+      eRet = INVALID_ARG;
    }
 
    return eRet;
 }
 
-
+ERROR_CODE ReadDatabaseFile( DATABASE_HANDLE hDatabase )
+{
+   // A compaction still running may be replacing the file
+   Database_Flush( hDatabase );
+   RETURN_ON_FAIL( Database_ReadSnapshot( hDatabase, hDatabase->szFile ) );
+
+   // The file is brought up to date with the changes made since it was written
+   hDatabase->ulSequence = hDatabase->sList.ulJournalSequence;
+   RETURN_ON_FAIL( Database_ReplayJournals( hDatabase ) );
+
+   return DebugDatabaseFile( hDatabase );
+}
+
+/* 
+   Replaces the posts in memory with those of a database exported by Database_ExportXml
+ */
+static ERROR_CODE ReadDatabaseXml( DATABASE_HANDLE hDatabase, const char *pszFileName )
+{
+   const XML_SCHEMA *psSchema = _null_;
+   DATABASE sList = { 0, 0, { _null_, sizeof( BLOG_POST ), 0, 0, 0 } };
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_FAIL( GetSchema( s_asPosts, ARRAY_COUNT( s_asPosts ), &s_psPostsSchema, &psSchema ) );
+
+   // The database is left as it was if the file can't be parsed
+   eRet = xmlWrapperParseFileWithSchema( pszFileName, psSchema, &sList );
+   if( ISERROR( eRet ) )
+   {
+      RecordArray_Free( &sList.sPosts );
+      return eRet;
+   }
+   Database_Flush( hDatabase );
+   Database_ReplacePosts( hDatabase, &sList );
+
+   return Database_RebuildIndex( hDatabase );
+}
+
+ERROR_CODE Database_ImportXml( DATABASE_HANDLE hDatabase, const char *pszFileName )
+{
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( pszFileName );
+   RETURN_ON_FAIL( ReadDatabaseXml( hDatabase, pszFileName ) );
+
+   // The file replaces the whole database, the journal of the old one is dropped when it is written
+   return CreateDatabaseFile( hDatabase );
+}
+
+ERROR_CODE Database_ExportXml( DATABASE_HANDLE hDatabase, const char *pszFileName )
+{
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( pszFileName );
+
+   hDatabase->sList.ulPostCount = hDatabase->sList.sPosts.ulCount;
+   hDatabase->sList.ulJournalSequence = hDatabase->ulSequence;
+
+   return xmlWrapperWriteFile( pszFileName, s_asPosts, ARRAY_COUNT( s_asPosts ), &hDatabase->sList );
+}
+
+/* 
+   Writes posts into a database file, along with the index of their links
+   Only touches psDatabase, so that it can run on the compaction thread
+ */
+static ERROR_CODE Database_WriteSnapshot( const char *pszFileName, const DATABASE *psDatabase )
+{
+   const uint32_t ulCount = psDatabase->sPosts.ulCount;
+   DATABASE_SNAPSHOT_HEADER sHeader = { 0, };
+   DATABASE_SNAPSHOT_RECORD *pasRecords = _null_;
+   HASH_INDEX sIndex = { 0, };
+   uint64_t ullFileSize = 0;
+   uint32_t ulString = 0;
+   ERROR_CODE eRet = NO_ERROR;
+   void *pvFile = _null_;
+
+   // The live index may be changing on the main thread, the one written is built from these posts
+   for( uint32_t ulOrder = 0; ulOrder < ulCount && !ISERROR( eRet ); ulOrder++ )
+   {
+      const BLOG_POST *psPost = RecordArray_Get( &psDatabase->sPosts, ulCount - 1 - ulOrder );
+
+      eRet = HashIndex_Insert( &sIndex, Database_HashLink( psPost->szLink ), ulOrder );
+      sHeader.ullStringsSize += strlen( psPost->szTitle ) + 1 + strlen( psPost->szLink ) + 1;
+   }
+   if( !ISERROR( eRet ) && sHeader.ullStringsSize > UINT32_MAX )
+   {
+      eRet = OVERFLOW;
+   }
+
+   sHeader.ulMagic = DATABASE_SNAPSHOT_MAGIC;
+   sHeader.ulVersion = DATABASE_SNAPSHOT_VERSION;
+   sHeader.ulPostCount = ulCount;
+   sHeader.ulJournalSequence = psDatabase->ulJournalSequence;
+   sHeader.ulIndexCapacity = sIndex.ulCapacity;
+   sHeader.ullRecordsOffset = sizeof( DATABASE_SNAPSHOT_HEADER );
+   sHeader.ullIndexOffset = sHeader.ullRecordsOffset + ( uint64_t )ulCount * sizeof( DATABASE_SNAPSHOT_RECORD );
+   sHeader.ullStringsOffset = sHeader.ullIndexOffset + ( uint64_t )sIndex.ulCapacity * ( sizeof( uint64_t ) + sizeof( uint32_t ) );
+   ullFileSize = sHeader.ullStringsOffset + sHeader.ullStringsSize;
+
+   pvFile = ISERROR( eRet ) ? _null_ : calloc( 1, ullFileSize );
+   if( pvFile == _null_ )
+   {
+      HashIndex_Free( &sIndex );
+      return ISERROR( eRet ) ? eRet : NO_MEMORY;
+   }
+
+   memcpy( pvFile, &sHeader, sizeof( sHeader ) );
+   pasRecords = pvFile + sHeader.ullRecordsOffset;
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      const BLOG_POST *psPost = RecordArray_Get( &psDatabase->sPosts, x );
+      char *pcStrings = pvFile + sHeader.ullStringsOffset;
+
+      pasRecords[x].ulTitle = ulString;
+      strcpy( pcStrings + ulString, psPost->szTitle );
+      ulString += strlen( psPost->szTitle ) + 1;
+      pasRecords[x].ulLink = ulString;
+      strcpy( pcStrings + ulString, psPost->szLink );
+      ulString += strlen( psPost->szLink ) + 1;
+      pasRecords[x].ulTimesShared = psPost->ulTimesShared;
+      pasRecords[x].llPubDate = ( int64_t )psPost->tPubDate;
+   }
+   if( sIndex.ulCapacity > 0 )
+   {
+      memcpy( pvFile + sHeader.ullIndexOffset, sIndex.paullHashes, sIndex.ulCapacity * sizeof( uint64_t ) );
+      memcpy( pvFile + sHeader.ullIndexOffset + sIndex.ulCapacity * sizeof( uint64_t ), sIndex.paulValues, sIndex.ulCapacity * sizeof( uint32_t ) );
+   }
+
+   eRet = WriteFileAtomic( pszFileName, pvFile, ullFileSize );
+   free( pvFile );
+   HashIndex_Free( &sIndex );
+
+   return eRet;
+}
+
+/* 
+   Maps a database file & loads it without parsing anything, the index is loaded as it was saved
+ */
+static ERROR_CODE Database_ReadSnapshot( DATABASE_HANDLE hDatabase, const char *pszFileName )
+{
+   struct stat sStat = { 0, };
+   void *pvFile = MAP_FAILED;
+   ERROR_CODE eRet = NO_ERROR;
+   int iFd = -1;
+
+   iFd = open( pszFileName, O_RDONLY );
+   UTIL_ASSERT( ( iFd >= 0 ), FILE_ERROR );
+   if( fstat( iFd, &sStat ) == 0 && sStat.st_size >= ( off_t )sizeof( DATABASE_SNAPSHOT_HEADER ) )
+   {
+      pvFile = mmap( _null_, sStat.st_size, PROT_READ, MAP_PRIVATE, iFd, 0 );
+   }
+   // The mapping outlives the descriptor
+   close( iFd );
+   UTIL_ASSERT( ( pvFile != MAP_FAILED ), FILE_ERROR );
+
+   eRet = Database_CheckSnapshot( pvFile, sStat.st_size );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = Database_LoadSnapshot( hDatabase, pvFile );
+   }
+   munmap( pvFile, sStat.st_size );
+
+   if( ISERROR( eRet ) )
+   {
+      DBG_PRINTF( "[%s] isn't a valid database file", pszFileName );
+   }
+
+   return eRet;
+}
+
+/* 
+   Every section has to be inside the file, nothing is read past its end
+ */
+static ERROR_CODE Database_CheckSnapshot( const DATABASE_SNAPSHOT_HEADER *psHeader, uint64_t ullFileSize )
+{
+   const uint64_t ullRecordsSize = ( uint64_t )psHeader->ulPostCount * sizeof( DATABASE_SNAPSHOT_RECORD );
+   const uint64_t ullIndexSize = ( uint64_t )psHeader->ulIndexCapacity * ( sizeof( uint64_t ) + sizeof( uint32_t ) );
+
+   UTIL_ASSERT( ( psHeader->ulMagic == DATABASE_SNAPSHOT_MAGIC && psHeader->ulVersion == DATABASE_SNAPSHOT_VERSION ), FILE_ERROR );
+   UTIL_ASSERT( ( psHeader->ullRecordsOffset >= sizeof( DATABASE_SNAPSHOT_HEADER ) && psHeader->ullRecordsOffset % 8 == 0 ), FILE_ERROR );
+   UTIL_ASSERT( ( psHeader->ullRecordsOffset <= ullFileSize && ullRecordsSize <= ullFileSize - psHeader->ullRecordsOffset ), FILE_ERROR );
+   UTIL_ASSERT( ( psHeader->ullIndexOffset >= psHeader->ullRecordsOffset + ullRecordsSize && psHeader->ullIndexOffset % 8 == 0 ), FILE_ERROR );
+   UTIL_ASSERT( ( psHeader->ullIndexOffset <= ullFileSize && ullIndexSize <= ullFileSize - psHeader->ullIndexOffset ), FILE_ERROR );
+   UTIL_ASSERT( ( psHeader->ullStringsOffset >= psHeader->ullIndexOffset + ullIndexSize ), FILE_ERROR );
+   UTIL_ASSERT( ( psHeader->ullStringsOffset <= ullFileSize && psHeader->ullStringsSize == ullFileSize - psHeader->ullStringsOffset ), FILE_ERROR );
+
+   return NO_ERROR;
+}
+
+/* 
+   Replaces the posts in memory with those of a checked database file
+ */
+static ERROR_CODE Database_LoadSnapshot( DATABASE_HANDLE hDatabase, const void *pvFile )
+{
+   const DATABASE_SNAPSHOT_HEADER *psHeader = pvFile;
+   const DATABASE_SNAPSHOT_RECORD *pasRecords = pvFile + psHeader->ullRecordsOffset;
+   const char *pcStrings = pvFile + psHeader->ullStringsOffset;
+   const uint64_t *paullHashes = pvFile + psHeader->ullIndexOffset;
+
+   RecordArray_Clear( &hDatabase->sList.sPosts );
+   RETURN_ON_FAIL( RecordArray_Reserve( &hDatabase->sList.sPosts, psHeader->ulPostCount ) );
+   for( uint32_t x = 0; x < psHeader->ulPostCount; x++ )
+   {
+      BLOG_POST sPost = { { 0, }, { 0, }, 0, 0 };
+
+      RETURN_ON_FAIL( Database_SnapshotString( pcStrings, psHeader->ullStringsSize, pasRecords[x].ulTitle, sPost.szTitle, sizeof( sPost.szTitle ) ) );
+      RETURN_ON_FAIL( Database_SnapshotString( pcStrings, psHeader->ullStringsSize, pasRecords[x].ulLink, sPost.szLink, sizeof( sPost.szLink ) ) );
+      sPost.ulTimesShared = pasRecords[x].ulTimesShared;
+      sPost.tPubDate = ( time_t )pasRecords[x].llPubDate;
+      // Can't fail, there is enough room
+      RecordArray_Append( &hDatabase->sList.sPosts, &sPost, _null_ );
+   }
+   hDatabase->sList.ulPostCount = psHeader->ulPostCount;
+   hDatabase->sList.ulJournalSequence = psHeader->ulJournalSequence;
+
+   // Values past the number of posts never match, so a bad index can't point outside the list
+   RETURN_ON_FAIL( HashIndex_Load( &hDatabase->sIndex, paullHashes, ( const uint32_t * )( paullHashes + psHeader->ulIndexCapacity ), psHeader->ulIndexCapacity ) );
+
+   return Database_RebuildShareQueue( hDatabase );
+}
+
+/* 
+   Copies a string of the pool, it has to end inside the pool & fit the buffer
+ */
+static ERROR_CODE Database_SnapshotString( const char *pcStrings, uint64_t ullStringsSize, uint32_t ulOffset, char *pszString, uint32_t ulBufferSize )
+{
+   const char *pcEnd = _null_;
+
+   UTIL_ASSERT( ( ulOffset < ullStringsSize ), FILE_ERROR );
+   pcEnd = memchr( pcStrings + ulOffset, '\0', ( ullStringsSize - ulOffset < ulBufferSize ) ? ullStringsSize - ulOffset : ulBufferSize );
+   UTIL_ASSERT( pcEnd, FILE_ERROR );
+   memcpy( pszString, pcStrings + ulOffset, pcEnd - ( pcStrings + ulOffset ) + 1 );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE DebugDatabaseFile( DATABASE_HANDLE hDatabase )
+{
+#if DEBUG_DATABASE
+   uint32_t ulCount = hDatabase->sList.sPosts.ulCount;
+
+   DBG_PRINTF( "Listing [%u] posts", ulCount );
+   for( int x = 0; x < ulCount; x++ )
+   {
+      DBG_PRINTF( "----------------------------------------" );
+      DBG_PRINTF( "Item#         = [%d]", x );
+      DBG_PRINTF( "Title         = [%0.20s]", Database_Post( hDatabase, x )->szTitle );
+      DBG_PRINTF( "Link          = [%0.20s]", Database_Post( hDatabase, x )->szLink );
+      DBG_PRINTF( "TimesShared   = [%u]", Database_Post( hDatabase, x )->ulTimesShared );
+      DBG_PRINTF( "----------------------------------------" );
+   }
+#else
+   ( void )hDatabase;
+#endif
+   return NO_ERROR;
+}
+
+static BLOG_POST *Database_Post( DATABASE_HANDLE hDatabase, uint32_t ulIndex )
+{
+   return RecordArray_Get( &hDatabase->sList.sPosts, ulIndex );
+}
+
+/* 
+   Drops posts without a title from the end of the list, same count as Database_CountPostsInList
+ */
+static void Database_TrimPosts( RECORD_ARRAY *psPosts )
+{
+   const BLOG_POST *psLast = _null_;
+
+   // RecordArray_Get returns NULL once the list is empty
+   while( ( psLast = RecordArray_Get( psPosts, psPosts->ulCount - 1 ) ) != _null_ && strlen( psLast->szTitle ) == 0 )
+   {
+      psPosts->ulCount--;
+   }
+}
+
+ERROR_CODE Database_GetOldestLeastSharedPost( DATABASE_HANDLE hDatabase, BLOG_POST * psPost)
+{
+   uint32_t ulPostCount = 0;
+   uint32_t ulOrder = UINT32_MAX;
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psPost );
+   ulPostCount = hDatabase->sList.sPosts.ulCount;
+   memset( psPost, 0, sizeof( BLOG_POST ) );
+
+   if( ulPostCount == 0 )
+      return NOT_FOUND;
+
+   // Lowest bucket is the least shared, its first post the oldest
+   eRet = BucketQueue_First( &hDatabase->sShareQueue, &ulOrder );
+   if( !ISERROR( eRet ) && ulOrder < ulPostCount )
+   {
+      *psPost = *Database_Post( hDatabase, ulPostCount - 1 - ulOrder );
+   }
+   else
+   {
+      DBG_PRINTF( "Unable to find a valid index, it is [%u]", ulOrder );
+      eRet = NOT_FOUND;
+   }
+
+   return eRet;
+}
+
+
+/* 
+   Returns the index of the post in the database if found
+   @param[IN]   psPost  : Post which needs to be found
+   @param[OUT] plIndex  : Index of the post if found, else -1
+   @return NO_ERROR     : Success
+   @return INVALID_ARG  : Invalid Post found
+ */
+
+typedef struct
+{
+   char szLink[sizeof( ( ( BLOG_POST * )0 )->szLink )];
+   const char *pszTitle;
+   uint32_t ulCount;
+   DATABASE_HANDLE hDatabase;
+} INDEX_KEY;
+
+static ERROR_CODE Database_FindIndex( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost, int32_t *plIndex )
+{
+   const uint32_t ulCount = hDatabase->sList.sPosts.ulCount;
+
+   RETURN_ON_NULL( psPost );
+   RETURN_ON_NULL( plIndex );
+   UTIL_ASSERT( ( strlen( psPost->szTitle ) > 0 && strlen( psPost->szLink ) > 0 ), INVALID_ARG );
+   *plIndex = -1;
+
+   if( ulCount > 0 )
+   {
+      INDEX_KEY sKey = { { 0, }, psPost->szTitle, ulCount, hDatabase };
+      uint32_t ulOrder = 0;
+
+      Database_NormalizeLink( psPost->szLink, sKey.szLink, sizeof( sKey.szLink ) );
+      if( !ISERROR( HashIndex_Find( &hDatabase->sIndex, HashIndex_HashString( sKey.szLink ), Database_IndexMatch, &sKey, &ulOrder ) ) )
+      {
+         *plIndex = ( int32_t )( ulCount - 1 - ulOrder );
+      }
+   }
+
+   return NO_ERROR;
+}
+
+/* 
+   Same link once normalized & same title
+ */
+static bool Database_IndexMatch( uint32_t ulOrder, const void *pvKey )
+{
+   const INDEX_KEY *psKey = ( const INDEX_KEY * )pvKey;
+   char szLink[sizeof( psKey->szLink )] = { 0, };
+   const BLOG_POST *psPost = _null_;
+
+   if( ulOrder >= psKey->ulCount )
+      return false;
+
+   psPost = Database_Post( psKey->hDatabase, psKey->ulCount - 1 - ulOrder );
+   Database_NormalizeLink( psPost->szLink, szLink, sizeof( szLink ) );
+
+   return ( strcmp( psKey->szLink, szLink ) == 0 && strcmp( psKey->pszTitle, psPost->szTitle ) == 0 );
+}
+
+/* 
+   Links only differing by their scheme, the case of the host or a trailing '/' point to the same post
+ */
+static void Database_NormalizeLink( const char *pszLink, char *pszNormalized, uint32_t ulBufferSize )
+{
+   const char *pszHost = strstr( pszLink, "://" );
+   uint32_t ulLength = 0;
+   bool bInHost = true;
+
+   pszLink = pszHost ? pszHost + 3 : pszLink;
+   for( ; *pszLink && ulLength < ulBufferSize - 1; pszLink++ )
+   {
+      bInHost = bInHost && ( *pszLink != '/' );
+      pszNormalized[ulLength++] = bInHost ? tolower( ( unsigned char )*pszLink ) : *pszLink;
+   }
+
+   while( ulLength > 0 && pszNormalized[ulLength - 1] == '/' )
+   {
+      ulLength--;
+   }
+   pszNormalized[ulLength] = '\0';
+}
+
+/* 
+   Files the post in the bucket of its share count
+ */
+static ERROR_CODE Database_QueuePost( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost, uint32_t ulOrder )
+{
+   if( hDatabase->sShareQueue.ulBuckets == 0 )
+   {
+      RETURN_ON_FAIL( BucketQueue_Init( &hDatabase->sShareQueue, DATABASE_SHARE_BUCKETS ) );
+   }
+
+   // Anything past the last bucket is filed in the last one
+   return BucketQueue_Add( &hDatabase->sShareQueue, ulOrder, psPost->ulTimesShared );
+}
+
+/* 
+   Rebuilds the hash index & the share queue from the posts in memory
+ */
+static ERROR_CODE Database_RebuildIndex( DATABASE_HANDLE hDatabase )
+{
+   const uint32_t ulCount = hDatabase->sList.sPosts.ulCount;
+
+   HashIndex_Clear( &hDatabase->sIndex );
+
+   // Oldest post first, in the order they were added
+   for( uint32_t ulOrder = 0; ulOrder < ulCount; ulOrder++ )
+   {
+      RETURN_ON_FAIL( HashIndex_Insert( &hDatabase->sIndex, Database_HashLink( Database_Post( hDatabase, ulCount - 1 - ulOrder )->szLink ), ulOrder ) );
+   }
+
+   return Database_RebuildShareQueue( hDatabase );
+}
+
+static ERROR_CODE Database_RebuildShareQueue( DATABASE_HANDLE hDatabase )
+{
+   const uint32_t ulCount = hDatabase->sList.sPosts.ulCount;
+
+   BucketQueue_Clear( &hDatabase->sShareQueue );
+
+   // Oldest post first, so that posts are added at the end of their bucket
+   for( uint32_t ulOrder = 0; ulOrder < ulCount; ulOrder++ )
+   {
+      RETURN_ON_FAIL( Database_QueuePost( hDatabase, Database_Post( hDatabase, ulCount - 1 - ulOrder ), ulOrder ) );
+   }
+
+   return NO_ERROR;
+}
+
+/* 
+   Hash of a link once normalized, the key of the hash index
+ */
+static uint64_t Database_HashLink( const char *pszLink )
+{
+   char szLink[sizeof( ( ( BLOG_POST * )0 )->szLink )] = { 0, };
+
+   Database_NormalizeLink( pszLink, szLink, sizeof( szLink ) );
+
+   return HashIndex_HashString( szLink );
+}
+
+
+bool Database_IsUniquePost( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost )
+{
+   bool bIsUnique = false;
+
+   if( ( _null_ == hDatabase ) || ( _null_ == psPost ) )
+   {
+#if DEBUG_DATABASE
+      DBG_PRINTF( "hDatabase or psPost is NULL, returned false" );
+#endif
+   }
+   else
+   {
+      int32_t lIndex = -1;
+
+      RETURN_ON_FAIL( Database_FindIndex( hDatabase, psPost, &lIndex ) );
+      bIsUnique = ( lIndex < 0 );
+   }
+   
+
+   return bIsUnique; 
+}
+
+ERROR_CODE Database_AddNewItem( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost )
+{
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psPost );
+   UTIL_ASSERT( ( strlen( psPost->szLink ) > 0 && strlen( psPost->szTitle ) > 0 ), INVALID_ARG );
+   RETURN_ON_FAIL( Database_InsertPost( hDatabase, psPost ) );
+
+   return Database_Journal( hDatabase, DATABASE_JOURNAL_ADD, 0, 1 );
+}
+
+ERROR_CODE Database_MergePosts( DATABASE_HANDLE hDatabase, const BLOG_POST *pasPosts, uint32_t ulCount )
+{
+   uint32_t ulPostCount = 0;
+   uint32_t ulAdded = 0;
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( pasPosts );
+   ulPostCount = hDatabase->sList.sPosts.ulCount;
+   UTIL_ASSERT( ( ulCount <= UINT32_MAX - ulPostCount ), NO_MEMORY );
+   // Room for every post is made at once
+   RETURN_ON_FAIL( RecordArray_Reserve( &hDatabase->sList.sPosts, ulPostCount + ulCount ) );
+
+   // Oldest post first so that the newest one ends up at index 0. Posts listed twice are
+   // caught as well, each post added is in the index before the next one is looked up
+   for( uint32_t x = ulCount; x > 0 && !ISERROR( eRet ); x-- )
+   {
+      const BLOG_POST *psPost = &pasPosts[x - 1];
+
+      if( strlen( psPost->szTitle ) > 0 && strlen( psPost->szLink ) > 0 && Database_IsUniquePost( hDatabase, psPost ) )
+      {
+         eRet = Database_InsertPost( hDatabase, psPost );
+         ulAdded += !ISERROR( eRet );
+      }
+   }
+
+   // The posts added are all at the front, they are journaled together even if a later one failed
+   if( ulAdded > 0 )
+   {
+      ERROR_CODE eJournal = Database_Journal( hDatabase, DATABASE_JOURNAL_ADD, 0, ulAdded );
+
+      eRet = ISERROR( eRet ) ? eRet : eJournal;
+   }
+
+   return eRet;
+}
+
+/* 
+   Adds a post at index 0 of the posts held in memory
+ */
+static ERROR_CODE Database_InsertPost( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost )
+{
+   const uint32_t ulCount = hDatabase->sList.sPosts.ulCount;
+
+   // Room is made first so that neither the index nor the list is touched if that fails
+   RETURN_ON_FAIL( RecordArray_Reserve( &hDatabase->sList.sPosts, ulCount + 1 ) );
+
+   RETURN_ON_FAIL( HashIndex_Insert( &hDatabase->sIndex, Database_HashLink( psPost->szLink ), ulCount ) );
+   // Should that fail, the order indexed above is past the end of the list & never matches
+   RETURN_ON_FAIL( Database_QueuePost( hDatabase, psPost, ulCount ) );
+
+   // Can't fail, there is enough room. The newest post is index 0, nothing is moved to make room for it
+   return RecordArray_Prepend( &hDatabase->sList.sPosts, psPost );
+}
+
+ERROR_CODE Database_UpdateTimesShared( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost )
+{
+   int32_t lIndex = -1;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psPost );
+   UTIL_ASSERT( ( strlen( psPost->szTitle ) > 0 && strlen( psPost->szLink ) > 0 ), INVALID_ARG );
+
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, psPost, &lIndex ) );
+   if( lIndex >= 0 )
+   {
+      RETURN_ON_FAIL( Database_SharePost( hDatabase, lIndex ) );
+      // A few bytes are appended instead of rewriting the whole database file
+      RETURN_ON_FAIL( Database_Journal( hDatabase, DATABASE_JOURNAL_SHARE, lIndex, 1 ) );
+   }
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_SharePost( DATABASE_HANDLE hDatabase, int32_t lIndex )
+{
+   BLOG_POST *psFound = Database_Post( hDatabase, lIndex );
+
+   psFound->ulTimesShared++;
+   // Moved to the next bucket without looking at any other post
+   return BucketQueue_Move( &hDatabase->sShareQueue, hDatabase->sList.sPosts.ulCount - 1 - lIndex, psFound->ulTimesShared );
+}
+
+/* 
+   Appends a change of the posts from ulIndex to ulIndex + ulCount - 1 to the journal, oldest first
+   The journal is compacted once it grows past DATABASE_JOURNAL_LIMIT
+ */
+static ERROR_CODE Database_Journal( DATABASE_HANDLE hDatabase, DATABASE_JOURNAL_TYPE eType, uint32_t ulIndex, uint32_t ulCount )
+{
+   BLOG_POST *pasRecords = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   if( hDatabase->ulBatchDepth == 0 && !hDatabase->sJournal.bOpen )
+   {
+      RETURN_ON_FAIL( Journal_Open( &hDatabase->sJournal, hDatabase->szJournalFile ) );
+   }
+
+   // Padding bytes are zeroed, the records are written as they are
+   pasRecords = calloc( ulCount, sizeof( BLOG_POST ) );
+   UTIL_ASSERT( pasRecords, NO_MEMORY );
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      const BLOG_POST *psPost = Database_Post( hDatabase, ulIndex + ulCount - 1 - x );
+
+      Strcpy_safe( pasRecords[x].szTitle, psPost->szTitle, sizeof( pasRecords[x].szTitle ) );
+      Strcpy_safe( pasRecords[x].szLink, psPost->szLink, sizeof( pasRecords[x].szLink ) );
+      pasRecords[x].ulTimesShared = psPost->ulTimesShared;
+      pasRecords[x].tPubDate = psPost->tPubDate;
+   }
+
+   // A batch journals its changes once it ends
+   if( hDatabase->ulBatchDepth > 0 )
+   {
+      for( uint32_t x = 0; !ISERROR( eRet ) && x < ulCount; x++ )
+      {
+         DATABASE_CHANGE sChange;
+
+         memset( &sChange, 0, sizeof( sChange ) );
+         sChange.eType = eType;
+         memcpy( &sChange.sPost, &pasRecords[x], sizeof( BLOG_POST ) );
+         eRet = RecordArray_Append( &hDatabase->sBatchChanges, &sChange, _null_ );
+      }
+      free( pasRecords );
+      // The database file holds every change if they can't all be kept
+      hDatabase->bBatchDirty = hDatabase->bBatchDirty || ISERROR( eRet );
+
+      return NO_ERROR;
+   }
+
+   eRet = Journal_AppendRecords( &hDatabase->sJournal, hDatabase->ulSequence + 1, eType, pasRecords, sizeof( BLOG_POST ), ulCount );
+   free( pasRecords );
+   RETURN_ON_FAIL( eRet );
+   hDatabase->ulSequence += ulCount;
+   Database_CheckJournalSize( hDatabase );
+
+   return NO_ERROR;
+}
+
+/* 
+   Appends the changes of a batch to the journal with a single write
+   @return OVERFLOW if they would take the journal past its limit, the database file is better written
+ */
+static ERROR_CODE Database_JournalBatch( DATABASE_HANDLE hDatabase )
+{
+   const uint32_t ulCount = hDatabase->sBatchChanges.ulCount;
+   JOURNAL_RECORD *pasRecords = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   // The size is only known once the journal is open
+   if( !hDatabase->sJournal.bOpen )
+   {
+      RETURN_ON_FAIL( Journal_Open( &hDatabase->sJournal, hDatabase->szJournalFile ) );
+   }
+   UTIL_ASSERT( ( hDatabase->sJournal.ullSize + ( uint64_t )ulCount * sizeof( BLOG_POST ) < DATABASE_JOURNAL_LIMIT ), OVERFLOW );
+
+   pasRecords = calloc( ulCount, sizeof( JOURNAL_RECORD ) );
+   UTIL_ASSERT( pasRecords, NO_MEMORY );
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      const DATABASE_CHANGE *psChange = RecordArray_Get( &hDatabase->sBatchChanges, x );
+
+      pasRecords[x].ulType = psChange->eType;
+      pasRecords[x].pvData = &psChange->sPost;
+      pasRecords[x].ulSize = sizeof( BLOG_POST );
+   }
+   eRet = Journal_AppendBatch( &hDatabase->sJournal, hDatabase->ulSequence + 1, pasRecords, ulCount );
+   free( pasRecords );
+   RETURN_ON_FAIL( eRet );
+   hDatabase->ulSequence += ulCount;
+   Database_CheckJournalSize( hDatabase );
+
+   return NO_ERROR;
+}
+
+/* 
+   Folds the journal back into the database file once it is large enough
+ */
+static void Database_CheckJournalSize( DATABASE_HANDLE hDatabase )
+{
+   if( hDatabase->sJournal.ullSize >= DATABASE_JOURNAL_LIMIT && ISERROR( Database_StartCompaction( hDatabase ) ) )
+   {
+      // The changes themselves are safe in the journal, the compaction is tried again with the next change
+      DBG_PRINTF( "Journal couldn't be compacted" );
+   }
+}
+
+/* 
+   Applies a journaled change which isn't in the database file yet
+ */
+static ERROR_CODE Database_ReplayChange( uint32_t ulSequence, uint32_t ulType, const void *pvData, uint32_t ulSize, void *pvDatabase )
+{
+   const BLOG_POST *psPost = ( const BLOG_POST * )pvData;
+   DATABASE_HANDLE hDatabase = ( DATABASE_HANDLE )pvDatabase;
+   int32_t lIndex = -1;
+
+   if( ulSequence <= hDatabase->ulSequence )
+      return NO_ERROR;
+   UTIL_ASSERT( ( ulSize == sizeof( BLOG_POST ) ), INVALID_ARG );
+
+   // The same post can be in the database file already if it was rebuilt from the feed
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, psPost, &lIndex ) );
+   if( ulType == DATABASE_JOURNAL_ADD && lIndex < 0 )
+   {
+      RETURN_ON_FAIL( Database_InsertPost( hDatabase, psPost ) );
+   }
+   else if( ulType == DATABASE_JOURNAL_SHARE && lIndex >= 0 )
+   {
+      RETURN_ON_FAIL( Database_SharePost( hDatabase, lIndex ) );
+   }
+   hDatabase->ulSequence = ulSequence;
+
+   return NO_ERROR;
+}
+
 /* 
-   Returns the index of the post in the database if found
-   @param[IN]   psPost  : Post which needs to be found
-   @param[OUT] plIndex  : Index of the post if found, else -1
-   @return NO_ERROR     : Success
-   @return INVALID_ARG  : Invalid Post found
+   Replays the journal being compacted, if any, & then the current one
  */
+static ERROR_CODE Database_ReplayJournals( DATABASE_HANDLE hDatabase )
+{
+   RETURN_ON_FAIL( Journal_Replay( hDatabase->szOldJournalFile, Database_ReplayChange, hDatabase ) );
+
+   return Journal_Replay( hDatabase->szJournalFile, Database_ReplayChange, hDatabase );
+}
 
-static ERROR_CODE Database_FindIndex( const BLOG_POST *psPost, int32_t *plIndex )
+/* 
+   Moves the journal aside & writes the posts into the database file on a background thread
+   Changes keep going to a new journal in the meantime
+ */
+static ERROR_CODE Database_StartCompaction( DATABASE_HANDLE hDatabase )
 {
-   const uint32_t ulCount = atol( s_sList.szPostCount );
+   DATABASE *psSnapshot = &hDatabase->sCompaction.sSnapshot;
 
-   RETURN_ON_NULL( psPost );
-   RETURN_ON_NULL( plIndex );
-   UTIL_ASSERT( ( strlen( psPost->szTitle ) > 0 && strlen( psPost->szLink ) > 0 ), INVALID_ARG );
-   *plIndex = -1;
+   // One compaction at a time
+   Database_Flush( hDatabase );
 
-   if( ulCount > 0 )
+   // The last compaction failed, its journal can't be replaced before a database file holds it
+   if( access( hDatabase->szOldJournalFile, F_OK ) == 0 )
+      return CreateDatabaseFile( hDatabase );
+
+   RecordArray_Clear( &psSnapshot->sPosts );
+   RETURN_ON_FAIL( RecordArray_Reserve( &psSnapshot->sPosts, hDatabase->sList.sPosts.ulCount ) );
+   for( uint32_t x = 0; x < hDatabase->sList.sPosts.ulCount; x++ )
    {
-      bool bFound = false;
-      uint32_t x = 0;
+      // Can't fail, there is enough room
+      RecordArray_Append( &psSnapshot->sPosts, Database_Post( hDatabase, x ), _null_ );
+   }
+   psSnapshot->ulPostCount = hDatabase->sList.sPosts.ulCount;
+   psSnapshot->ulJournalSequence = hDatabase->ulSequence;
 
-      for( ; ( !bFound && x < ulCount ); x++ )
-      {
-         bFound = ( strcmp( psPost->szLink, s_sList.asList[x].szLink ) == 0 && 
-                    strcmp( psPost->szTitle, s_sList.asList[x].szTitle ) == 0 );
-      }
+   RETURN_ON_FAIL( Journal_Rotate( &hDatabase->sJournal, hDatabase->szOldJournalFile ) );
 
-      *plIndex = bFound ? ( int32_t )--x : -1;
+   hDatabase->sCompaction.eResult = NO_ERROR;
+   if( pthread_create( &hDatabase->sCompaction.sThread, _null_, Database_CompactionThread, &hDatabase->sCompaction ) != 0 )
+   {
+      // Couldn't get a thread, compact synchronously instead
+      Database_CompactionThread( &hDatabase->sCompaction );
+      return Database_Flush( hDatabase );
    }
+   hDatabase->sCompaction.bStarted = true;
 
    return NO_ERROR;
 }
 
-
-bool Database_IsUniquePost( const BLOG_POST *psPost )
+static void *Database_CompactionThread( void *pvCompaction )
 {
-   bool bIsUnique = false;
+   DATABASE_COMPACTION *psCompaction = ( DATABASE_COMPACTION * )pvCompaction;
 
-   if( _null_ == psPost )
-   {
-#if DEBUG_DATABASE
-      DBG_PRINTF( "psPost is NULL, returned false" );
-#endif
-   }
-   else
+   psCompaction->eResult = Database_WriteSnapshot( psCompaction->pszFile, &psCompaction->sSnapshot );
+   // The journal is only dropped once the database file holding its changes is safe
+   if( !ISERROR( psCompaction->eResult ) && unlink( psCompaction->pszOldJournalFile ) != 0 )
    {
-      int32_t lIndex = -1;
-
-      RETURN_ON_FAIL( Database_FindIndex( psPost, &lIndex ) );
-      bIsUnique = ( lIndex < 0 );
+      psCompaction->eResult = FILE_ERROR;
    }
-   
 
-   return bIsUnique; 
+   return _null_;
 }
 
-ERROR_CODE Database_AddNewItem( const BLOG_POST *psPost )
+ERROR_CODE Database_Flush( DATABASE_HANDLE hDatabase )
 {
-   const uint32_t ulCount = atol( s_sList.szPostCount );
+   ERROR_CODE eRet = NO_ERROR;
 
-   RETURN_ON_NULL( psPost );
-   UTIL_ASSERT( ( strlen( psPost->szLink ) > 0 && strlen( psPost->szTitle ) > 0 ), INVALID_ARG );
-   UTIL_ASSERT( ( ARRAY_COUNT( s_sList.asList ) > ( ulCount + 1 ) ), OVERFLOW );
+   RETURN_ON_NULL( hDatabase );
 
-   if( ulCount == 0 )
+   if( hDatabase->sCompaction.bStarted )
    {
-      memcpy( &s_sList.asList[0], psPost, sizeof( BLOG_POST ) );
+      pthread_join( hDatabase->sCompaction.sThread, _null_ );
+      hDatabase->sCompaction.bStarted = false;
    }
-   else
-   {
-      const uint32_t ulCopySize = sizeof( s_sList.asList ) - sizeof ( BLOG_POST );
 
-      memmove( &s_sList.asList[1], &s_sList.asList[0], ulCopySize );
-      memcpy( &s_sList.asList[0], psPost, sizeof( BLOG_POST ) );
-   }
+   // A failed compaction is reported once, its journal is kept until a database file holds it
+   eRet = hDatabase->sCompaction.eResult;
+   hDatabase->sCompaction.eResult = NO_ERROR;
 
-   snprintf( s_sList.szPostCount, sizeof( s_sList.szPostCount ), "%u", ulCount + 1 );
-   
-   return NO_ERROR;
+   return eRet;
 }
 
-ERROR_CODE Database_UpdateTimesShared( const BLOG_POST *psPost )
+void Database_BeginBatch( DATABASE_HANDLE hDatabase )
 {
-   int32_t lIndex = -1;
+   if( hDatabase == _null_ )
+      return;
 
-   RETURN_ON_NULL( psPost );
-   UTIL_ASSERT( ( strlen( psPost->szTitle ) > 0 && strlen( psPost->szLink ) > 0 ), INVALID_ARG );
+   hDatabase->ulBatchDepth++;
+}
 
-   RETURN_ON_FAIL( Database_FindIndex( psPost, &lIndex ) );
-   if( lIndex >= 0 )
-   {
-      uint32_t ulCurrentCount = atol( s_sList.asList[lIndex].szTimesShared );
+ERROR_CODE Database_EndBatch( DATABASE_HANDLE hDatabase )
+{
+   RETURN_ON_NULL( hDatabase );
+   UTIL_ASSERT( hDatabase->ulBatchDepth, INVALID_ARG );
 
-      ulCurrentCount++;
-      snprintf( s_sList.asList[lIndex].szTimesShared, sizeof( s_sList.asList[lIndex].szTimesShared), 
-      "%u", ulCurrentCount );
-   }
+   hDatabase->ulBatchDepth--;
+   if( hDatabase->ulBatchDepth > 0 )
+      return NO_ERROR;
 
-   RETURN_ON_FAIL( CreateDatabaseFile() );
+   // The database file is written instead if the changes can't be journaled
+   if( !hDatabase->bBatchDirty && hDatabase->sBatchChanges.ulCount > 0 )
+   {
+      hDatabase->bBatchDirty = ISERROR( Database_JournalBatch( hDatabase ) );
+   }
+   RecordArray_Clear( &hDatabase->sBatchChanges );
+   if( hDatabase->bBatchDirty )
+   {
+      hDatabase->bBatchDirty = false;
+      return CreateDatabaseFile( hDatabase );
+   }
 
    return NO_ERROR;
 }
@@ -333,6 +1661,9 @@ static ERROR_CODE Database_CountPostsInList( const BLOG_POST *pasList, uint32_t
 
 static uint32_t s_ulTestCount = 0;
 
+// Files of the tests' own database, the bot's database in the same directory is left alone
+#define DATABASE_TEST_NAME ( "database_test" )
+
 #if DEBUG_DATABASE
 #define PRINTF_TEST(string) ( DBG_PRINTF( "----- %s | Test Count: %u -----", string, s_ulTestCount++ ) ) 
 #else
@@ -340,240 +1671,307 @@ static uint32_t s_ulTestCount = 0;
 #endif
 
 
-static ERROR_CODE Database_Test_Sanity( void )
+/* 
+   Empties the database held in memory, the file is left untouched
+ */
+static void Database_Test_Clear( DATABASE_HANDLE hDatabase )
+{
+   RecordArray_Clear( &hDatabase->sList.sPosts );
+   hDatabase->sList.ulPostCount = 0;
+   HashIndex_Clear( &hDatabase->sIndex );
+   BucketQueue_Clear( &hDatabase->sShareQueue );
+}
+
+/* 
+   Deletes every file of a test database, once the compaction still running is done with them
+ */
+static void Database_Test_RemoveFiles( DATABASE_HANDLE hDatabase )
+{
+   Database_Flush( hDatabase );
+   unlink( hDatabase->szFile );
+   unlink( hDatabase->szXmlFile );
+   unlink( hDatabase->szJournalFile );
+   unlink( hDatabase->szOldJournalFile );
+}
+
+/* 
+   Replaces the database held in memory with a list of posts, index 0 being the newest
+ */
+static ERROR_CODE Database_Test_SetPosts( DATABASE_HANDLE hDatabase, const BLOG_POST *pasPosts, uint32_t ulCount )
+{
+   Database_Test_Clear( hDatabase );
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      RETURN_ON_FAIL( RecordArray_Append( &hDatabase->sList.sPosts, &pasPosts[x], _null_ ) );
+   }
+
+   return Database_RebuildIndex( hDatabase );
+}
+
+static ERROR_CODE Database_Test_Sanity( DATABASE_HANDLE hDatabase )
 {
    BLOG_POST sPost = { 0, };
+   BLOG_POST asList[1] = { 0, };
    PRINTF_TEST( "Basic Sanity Testing" );
    
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( &sPost ) == NOT_FOUND ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_IsUniquePost( _null_ ) == false ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_AddNewItem( _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_AddNewItem( &sPost ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_UpdateTimesShared( _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_UpdateTimesShared( &sPost ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) == NOT_FOUND ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_IsUniquePost( hDatabase, _null_ ) == false ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
    RETURN_ON_FAIL( Database_CountPostsInList( _null_, 0, _null_ ) == INVALID_ARG ? NO_ERROR: TEST_FAILED );
-   RETURN_ON_FAIL( Database_CountPostsInList( s_sList.asList, 0, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( Database_CountPostsInList( s_sList.asList, ARRAY_COUNT( s_sList.asList ), _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_CountPostsInList( asList, 0, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_CountPostsInList( asList, ARRAY_COUNT( asList ), _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
    
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_SimpleComparison( void )
+static ERROR_CODE Database_Test_SimpleComparison( DATABASE_HANDLE hDatabase )
 {
    BLOG_POST sPost = { 0, };
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 1, 0 },
+      { "TITLE 2", "LINK 2", 0, 0 }
+   };
 
    PRINTF_TEST( "Simple Comparison between two posts" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
 
-   Strcpy_safe( s_sList.asList[0].szLink, "LINK 1", sizeof( s_sList.asList[0].szLink ) );
-   Strcpy_safe( s_sList.asList[0].szTitle, "TITLE 1", sizeof( s_sList.asList[0].szTitle ) );
-   Strcpy_safe( s_sList.asList[0].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[1].szLink, "LINK 2", sizeof( s_sList.asList[1].szLink ) );
-   Strcpy_safe( s_sList.asList[1].szTitle, "TITLE 2", sizeof( s_sList.asList[1].szTitle ) );
-   Strcpy_safe( s_sList.szPostCount, "2", sizeof( s_sList.szPostCount ) );
+   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) );
 
-   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( &sPost ) );
-
-   RETURN_ON_FAIL( memcmp( &sPost, &s_sList.asList[1], sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( memcmp( &sPost, Database_Post( hDatabase, 1 ), sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
 
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_OldestPost()
+static ERROR_CODE Database_Test_OldestPost( DATABASE_HANDLE hDatabase )
 {
    BLOG_POST sPost = {0, };
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 10, 0 },
+      { "TITLE 2", "LINK 2", 1, 0 },
+      { "TITLE 3", "LINK 3", 1, 0 }
+   };
 
    PRINTF_TEST( "Should return oldest post in the list" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   
-   Strcpy_safe( s_sList.asList[0].szLink, "LINK 1", sizeof( s_sList.asList[0].szLink ) );
-   Strcpy_safe( s_sList.asList[0].szTitle, "TITLE 1", sizeof( s_sList.asList[0].szTitle ) );
-   Strcpy_safe( s_sList.asList[0].szTimesShared, "10", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[1].szLink, "LINK 2", sizeof( s_sList.asList[1].szLink ) );
-   Strcpy_safe( s_sList.asList[1].szTitle, "TITLE 2", sizeof( s_sList.asList[1].szTitle ) );
-   Strcpy_safe( s_sList.asList[1].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[2].szLink, "LINK 3", sizeof( s_sList.asList[2].szLink ) );
-   Strcpy_safe( s_sList.asList[2].szTitle, "TITLE 3", sizeof( s_sList.asList[2].szTitle ) );
-   Strcpy_safe( s_sList.asList[2].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.szPostCount, "3", sizeof( s_sList.szPostCount ) );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
 
-   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( &sPost ) );
+   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) );
 
-   RETURN_ON_FAIL( memcmp( &sPost, &s_sList.asList[2], sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( memcmp( &sPost, Database_Post( hDatabase, 2 ), sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
+
+   Database_Test_Clear( hDatabase );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_ShareRotation( DATABASE_HANDLE hDatabase )
+{
+   BLOG_POST sPost = { 0, };
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 0, 0 },
+      { "TITLE 2", "LINK 2", 1, 0 },
+      { "TITLE 3", "LINK 3", 0, 0 },
+      { "TITLE 4", "LINK 4", 0, 0 }
+   };
+   // Oldest least shared post first, TITLE 2 only gets its turn once the others have caught up
+   const char *apszExpected[] = { "TITLE 4", "TITLE 3", "TITLE 1", "TITLE 4", "TITLE 3", "TITLE 2", "TITLE 1", "TITLE 4" };
+
+   PRINTF_TEST( "Posts are shared in turns" );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+
+   for( uint32_t x = 0; x < ARRAY_COUNT( apszExpected ); x++ )
+   {
+      RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) );
+      RETURN_ON_FAIL( strcmp( sPost.szTitle, apszExpected[x] ) == 0 ? NO_ERROR : TEST_FAILED );
+      RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   }
+
+   // Posts shared out of turn still queue by age, TITLE 1 & then TITLE 2 join TITLE 4
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &asPosts[0] ) );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &asPosts[1] ) );
+   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( strcmp( sPost.szTitle, "TITLE 3" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   for( uint32_t x = ARRAY_COUNT( asPosts ); x > 0; x-- )
+   {
+      RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) );
+      RETURN_ON_FAIL( strcmp( sPost.szTitle, asPosts[x - 1].szTitle ) == 0 ? NO_ERROR : TEST_FAILED );
+      RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   }
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
 
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_IsUniqueSimple( void )
+static ERROR_CODE Database_Test_IsUniqueSimple( DATABASE_HANDLE hDatabase )
 {
-   BLOG_POST sPost = { "Unique Title", "Unique Link", "0" };
+   BLOG_POST sPost = { "Unique Title", "Unique Link", 0, 0 };
    bool bRet = false;
 
    PRINTF_TEST( "Simple unique test" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
 
-   bRet = Database_IsUniquePost( &sPost );
+   bRet = Database_IsUniquePost( hDatabase, &sPost );
    RETURN_ON_FAIL( bRet ? NO_ERROR : TEST_FAILED );
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
 
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_IsUniqueFilledDatabase( void )
+static ERROR_CODE Database_Test_IsUniqueFilledDatabase( DATABASE_HANDLE hDatabase )
 {
    bool bRet = false;
-   BLOG_POST sPost = { "UNIQUE TITLE", "UNIQUE LINK", "0" };
+   BLOG_POST sPost = { "UNIQUE TITLE", "UNIQUE LINK", 0, 0 };
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 10, 0 },
+      { "TITLE 2", "LINK 2", 1, 0 },
+      { "TITLE 3", "LINK 3", 1, 0 }
+   };
 
    PRINTF_TEST( "Filled Database Unique test" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   Strcpy_safe( s_sList.asList[0].szLink, "LINK 1", sizeof( s_sList.asList[0].szLink ) );
-   Strcpy_safe( s_sList.asList[0].szTitle, "TITLE 1", sizeof( s_sList.asList[0].szTitle ) );
-   Strcpy_safe( s_sList.asList[0].szTimesShared, "10", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[1].szLink, "LINK 2", sizeof( s_sList.asList[1].szLink ) );
-   Strcpy_safe( s_sList.asList[1].szTitle, "TITLE 2", sizeof( s_sList.asList[1].szTitle ) );
-   Strcpy_safe( s_sList.asList[1].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[2].szLink, "LINK 3", sizeof( s_sList.asList[2].szLink ) );
-   Strcpy_safe( s_sList.asList[2].szTitle, "TITLE 3", sizeof( s_sList.asList[2].szTitle ) );
-   Strcpy_safe( s_sList.asList[2].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.szPostCount, "3", sizeof( s_sList.szPostCount ) );
-
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   bRet = Database_IsUniquePost( &sPost );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+
+   bRet = Database_IsUniquePost( hDatabase, &sPost );
+   Database_Test_Clear( hDatabase );
    RETURN_ON_FAIL( bRet ? NO_ERROR : TEST_FAILED );
 
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_IsNotUniqueFilledDatabase( void )
+static ERROR_CODE Database_Test_IsNotUniqueFilledDatabase( DATABASE_HANDLE hDatabase )
 {
    bool bRet = false;
-   BLOG_POST sPost = { "TITLE 2", "LINK 2", "1" };
+   BLOG_POST sPost = { "TITLE 2", "LINK 2", 1, 0 };
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 10, 0 },
+      { "TITLE 2", "LINK 2", 1, 0 },
+      { "TITLE 3", "LINK 3", 1, 0 }
+   };
 
    PRINTF_TEST( "Filled Database Not Unique test" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   Strcpy_safe( s_sList.asList[0].szLink, "LINK 1", sizeof( s_sList.asList[0].szLink ) );
-   Strcpy_safe( s_sList.asList[0].szTitle, "TITLE 1", sizeof( s_sList.asList[0].szTitle ) );
-   Strcpy_safe( s_sList.asList[0].szTimesShared, "10", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[1].szLink, "LINK 2", sizeof( s_sList.asList[1].szLink ) );
-   Strcpy_safe( s_sList.asList[1].szTitle, "TITLE 2", sizeof( s_sList.asList[1].szTitle ) );
-   Strcpy_safe( s_sList.asList[1].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[2].szLink, "LINK 3", sizeof( s_sList.asList[2].szLink ) );
-   Strcpy_safe( s_sList.asList[2].szTitle, "TITLE 3", sizeof( s_sList.asList[2].szTitle ) );
-   Strcpy_safe( s_sList.asList[2].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.szPostCount, "3", sizeof( s_sList.szPostCount ) );
-
-   bRet = Database_IsUniquePost( &sPost );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+
+   bRet = Database_IsUniquePost( hDatabase, &sPost );
    
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
    RETURN_ON_FAIL( !bRet ? NO_ERROR : TEST_FAILED );
 
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_AddSimpleItem( void )
+static ERROR_CODE Database_Test_AddSimpleItem( DATABASE_HANDLE hDatabase )
 {
-   BLOG_POST sPost = { "NEW TITLE", "NEW LINK", "0" };
+   BLOG_POST sPost = { "NEW TITLE", "NEW LINK", 0, 0 };
 
    PRINTF_TEST( "Testing adding item" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
 
-   RETURN_ON_FAIL( Database_AddNewItem( &sPost ) );
-   RETURN_ON_FAIL( memcmp( &sPost, &s_sList.asList[0], sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( s_sList.szPostCount, "1" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( memcmp( &sPost, Database_Post( hDatabase, 0 ), sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 1 ? NO_ERROR : TEST_FAILED );
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_AddItemToFilledDatabase( void )
+static ERROR_CODE Database_Test_AddItemToFilledDatabase( DATABASE_HANDLE hDatabase )
 {
-   BLOG_POST sPost = { "NEW TITLE", "NEW LINK", "0" };
+   BLOG_POST sPost = { "NEW TITLE", "NEW LINK", 0, 0 };
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 10, 0 },
+      { "TITLE 2", "LINK 2", 1, 0 },
+      { "TITLE 3", "LINK 3", 1, 0 }
+   };
 
    PRINTF_TEST( "Testing adding item on a filled database" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
 
-   Strcpy_safe( s_sList.asList[0].szLink, "LINK 1", sizeof( s_sList.asList[0].szLink ) );
-   Strcpy_safe( s_sList.asList[0].szTitle, "TITLE 1", sizeof( s_sList.asList[0].szTitle ) );
-   Strcpy_safe( s_sList.asList[0].szTimesShared, "10", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[1].szLink, "LINK 2", sizeof( s_sList.asList[1].szLink ) );
-   Strcpy_safe( s_sList.asList[1].szTitle, "TITLE 2", sizeof( s_sList.asList[1].szTitle ) );
-   Strcpy_safe( s_sList.asList[1].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.asList[2].szLink, "LINK 3", sizeof( s_sList.asList[2].szLink ) );
-   Strcpy_safe( s_sList.asList[2].szTitle, "TITLE 3", sizeof( s_sList.asList[2].szTitle ) );
-   Strcpy_safe( s_sList.asList[2].szTimesShared, "1", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.szPostCount, "3", sizeof( s_sList.szPostCount ) );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( memcmp( &sPost, Database_Post( hDatabase, 0 ), sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( memcmp( &asPosts[2], Database_Post( hDatabase, 3 ), sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 4 ? NO_ERROR : TEST_FAILED );
 
-   RETURN_ON_FAIL( Database_AddNewItem( &sPost ) );
-   RETURN_ON_FAIL( memcmp( &sPost, &s_sList.asList[0], sizeof( BLOG_POST ) ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( s_sList.szPostCount, "4" ) == 0 ? NO_ERROR : TEST_FAILED );
-
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_AddItemDatabaseFull() 
+static ERROR_CODE Database_Test_AddItemLargeDatabase( DATABASE_HANDLE hDatabase ) 
 {
-   BLOG_POST sPost = { "UNIQUE TITLE", "UNIQUE TEST", "0" };
-   char szTemp[32 + 1] = { 0, };
-   const uint32_t ulCount = ARRAY_COUNT( s_sList.asList );
+   BLOG_POST sPost = { "UNIQUE TITLE", "UNIQUE TEST", 0, 0 };
+   const uint32_t ulCount = 5000;
+   int32_t lIndex = -1;
 
-   PRINTF_TEST( "Add Item: Database is full" );
+   PRINTF_TEST( "Add Item: Database grows with the posts" );
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
 
+   // Bulk import, written once instead of journaling every post
+   Database_BeginBatch( hDatabase );
    for( uint32_t x = 0; x < ulCount; x++ )
    {
-      snprintf( szTemp, sizeof( szTemp ), "TITLE %u", x );
-      Strcpy_safe( s_sList.asList[x].szTitle, szTemp, sizeof( s_sList.asList[x].szTitle ) );
-      snprintf( szTemp, sizeof( szTemp ), "LINK %u", x );
-      Strcpy_safe( s_sList.asList[x].szLink, szTemp, sizeof( s_sList.asList[x].szLink ) );
+      snprintf( sPost.szTitle, sizeof( sPost.szTitle ), "TITLE %u", x );
+      snprintf( sPost.szLink, sizeof( sPost.szLink ), "LINK %u", x );
+      RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   }
+   RETURN_ON_FAIL( Database_EndBatch( hDatabase ) );
+
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == ulCount ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 0 )->szTitle, "TITLE 4999" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, ulCount - 1 )->szTitle, "TITLE 0" ) == 0 ? NO_ERROR : TEST_FAILED );
+   // Still newest first after the ring buffer has wrapped & grown several times
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      snprintf( sPost.szTitle, sizeof( sPost.szTitle ), "TITLE %u", ulCount - 1 - x );
+      RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, x )->szTitle, sPost.szTitle ) == 0 ? NO_ERROR : TEST_FAILED );
    }
-   snprintf( szTemp, sizeof( szTemp ), "%u", ulCount );
-   Strcpy_safe( s_sList.szPostCount, szTemp, sizeof( s_sList.szPostCount ) );
 
-   RETURN_ON_FAIL( Database_AddNewItem( &sPost ) == OVERFLOW ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( s_sList.szPostCount, szTemp ) == 0 ? NO_ERROR : TEST_FAILED );
+   Strcpy_safe( sPost.szTitle, "TITLE 0", sizeof( sPost.szTitle ) );
+   Strcpy_safe( sPost.szLink, "LINK 0", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, &sPost, &lIndex ) );
+   RETURN_ON_FAIL( lIndex == ( int32_t )( ulCount - 1 ) ? NO_ERROR : TEST_FAILED );
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   Database_Test_Clear( hDatabase );
    
    return NO_ERROR;
 }
 
-static ERROR_CODE Database_Test_UpdatePostSimple() 
+static ERROR_CODE Database_Test_UpdatePostSimple( DATABASE_HANDLE hDatabase ) 
 {
 #define TITLE "TEST_TITLE"
 #define LINK  "TEST LINK"
-#define TIME  "1"
+#define TIME  1
 
-   BLOG_POST sPost = { TITLE, LINK, "0" };
+   BLOG_POST sPost = { TITLE, LINK, 0, 0 };
 
    PRINTF_TEST( "Simple update post test" );
-   memset( &s_sList, 0, sizeof( s_sList ) );
-
-   Strcpy_safe( s_sList.asList[0].szTitle, TITLE, sizeof( s_sList.asList[0].szTitle ) );
-   Strcpy_safe( s_sList.asList[0].szLink, LINK, sizeof( s_sList.asList[0].szLink ) );
-   Strcpy_safe( s_sList.asList[0].szTimesShared, "0", sizeof( s_sList.asList[0].szTimesShared ) );
-   Strcpy_safe( s_sList.szPostCount, "1", sizeof( s_sList.szPostCount ) );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, &sPost, 1 ) );
 
-   RETURN_ON_FAIL( Database_UpdateTimesShared( &sPost ) );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
 
 #if DEBUG_DATABASE
    DBG_PRINTF( "EXPECTED = " );
    DBG_PRINTF( "TITLE = [%s]", sPost.szTitle );
    DBG_PRINTF( "LINK  = [%s]", sPost.szLink );
-   DBG_PRINTF( "TIMES = [%s]", sPost.szTimesShared );
+   DBG_PRINTF( "TIMES = [%u]", sPost.ulTimesShared );
    DBG_PRINTF( "ACTUAL = ")
-   DBG_PRINTF( "TITLE = [%s]", s_sList.asList[0].szTitle );
-   DBG_PRINTF( "LINK  = [%s]", s_sList.asList[0].szLink );
-   DBG_PRINTF( "TIMES = [%s]", s_sList.asList[0].szTimesShared );
+   DBG_PRINTF( "TITLE = [%s]", Database_Post( hDatabase, 0 )->szTitle );
+   DBG_PRINTF( "LINK  = [%s]", Database_Post( hDatabase, 0 )->szLink );
+   DBG_PRINTF( "TIMES = [%u]", Database_Post( hDatabase, 0 )->ulTimesShared );
 #endif
 
-   RETURN_ON_FAIL( ( strcmp( s_sList.asList[0].szTimesShared, TIME ) == 0 ? NO_ERROR : TEST_FAILED ) );
+   RETURN_ON_FAIL( ( Database_Post( hDatabase, 0 )->ulTimesShared == TIME ? NO_ERROR : TEST_FAILED ) );
 
 #undef TITLE
 #undef LINK
@@ -582,6 +1980,528 @@ static ERROR_CODE Database_Test_UpdatePostSimple()
    return NO_ERROR;
 }
 
+static ERROR_CODE Database_Test_Batch( DATABASE_HANDLE hDatabase )
+{
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 0, 0 },
+      { "TITLE 2", "LINK 2", 0, 0 }
+   };
+   const BLOG_POST sPost = { "TITLE 3", "LINK 3", 0, 0 };
+
+   PRINTF_TEST( "Batched changes" );
+   RETURN_ON_FAIL( Database_EndBatch( hDatabase ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+
+   // Nothing is written until the outermost batch ends
+   Database_BeginBatch( hDatabase );
+   Database_BeginBatch( hDatabase );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &asPosts[0] ) );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( Database_EndBatch( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sJournal.ullSize == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_EndBatch( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sJournal.ullSize > 0 ? NO_ERROR : TEST_FAILED );
+
+   // The file & the journal hold every change made during the batch
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 3 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 0 )->ulTimesShared == 1 && Database_Post( hDatabase, 1 )->ulTimesShared == 1 ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_Journal( DATABASE_HANDLE hDatabase )
+{
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "LINK 1", 0, 0 },
+      { "TITLE 2", "LINK 2", 0, 0 }
+   };
+   const BLOG_POST sPost = { "TITLE 3", "LINK 3", 0, 0 };
+   uint32_t ulShares = 0;
+   FILE *pFile = _null_;
+
+   PRINTF_TEST( "Changes are journaled & replayed" );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &asPosts[1] ) );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( hDatabase->sJournal.ullSize > 0 ? NO_ERROR : TEST_FAILED );
+
+   // A record torn by a crash is dropped, the ones before it are kept
+   Journal_Close( &hDatabase->sJournal );
+   pFile = fopen( hDatabase->szJournalFile, "ab" );
+   RETURN_ON_NULL( pFile );
+   fwrite( "TORN", 1, 4, pFile );
+   fclose( pFile );
+
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 3 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 0 )->szTitle, "TITLE 3" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 0 )->ulTimesShared == 1 && Database_Post( hDatabase, 2 )->ulTimesShared == 1 ? NO_ERROR : TEST_FAILED );
+
+   // Appending after the torn record still replays
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 0 )->ulTimesShared == 2 ? NO_ERROR : TEST_FAILED );
+
+   // The journal is folded back into the database file once it is large enough
+   ulShares = 2;
+   while( access( hDatabase->szOldJournalFile, F_OK ) != 0 && !hDatabase->sCompaction.bStarted )
+   {
+      RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+      ulShares++;
+   }
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
+   ulShares++;
+   RETURN_ON_FAIL( Database_Flush( hDatabase ) );
+   RETURN_ON_FAIL( access( hDatabase->szOldJournalFile, F_OK ) != 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( hDatabase->sJournal.ullSize < DATABASE_JOURNAL_LIMIT ? NO_ERROR : TEST_FAILED );
+
+   // A failed compaction is reported once & a database file written afterwards makes up for it
+   hDatabase->sCompaction.eResult = FILE_ERROR;
+   RETURN_ON_FAIL( Database_Flush( hDatabase ) == FILE_ERROR ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Flush( hDatabase ) );
+   hDatabase->sCompaction.eResult = FILE_ERROR;
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( Database_Flush( hDatabase ) );
+
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 3 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 0 )->ulTimesShared == ulShares ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_MergePosts( DATABASE_HANDLE hDatabase )
+{
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "https://blog/1", 3, 0 },
+      { "TITLE 2", "https://blog/2", 0, 0 }
+   };
+   // Newest first, as in a feed
+   const BLOG_POST asFeed[] =
+   {
+      { "TITLE 4", "https://blog/4/", 0, 0 },
+      { "TITLE 4", "https://blog/4", 0, 0 },
+      { "TITLE 3", "https://blog/3", 0, 0 },
+      { "", "https://blog/5", 0, 0 },
+      { "TITLE 1", "http://BLOG/1", 0, 0 }
+   };
+   const uint32_t ulSequence = hDatabase->ulSequence;
+
+   PRINTF_TEST( "Posts merged in a single pass" );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+   RETURN_ON_FAIL( Database_MergePosts( hDatabase, asFeed, 0 ) );
+   RETURN_ON_FAIL( Database_MergePosts( hDatabase, asFeed, ARRAY_COUNT( asFeed ) ) );
+
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 4 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 0 )->szTitle, "TITLE 4" ) == 0 && strcmp( Database_Post( hDatabase, 1 )->szTitle, "TITLE 3" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 2 )->ulTimesShared == 3 ? NO_ERROR : TEST_FAILED );
+   // Both new posts are journaled together
+   RETURN_ON_FAIL( hDatabase->ulSequence == ulSequence + 2 ? NO_ERROR : TEST_FAILED );
+
+   // The newest post is still the first one once replayed
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( Database_MergePosts( hDatabase, asFeed, ARRAY_COUNT( asFeed ) ) );
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 4 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 0 )->szTitle, "TITLE 4" ) == 0 && strcmp( Database_Post( hDatabase, 1 )->szTitle, "TITLE 3" ) == 0 ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_Snapshot( DATABASE_HANDLE hDatabase )
+{
+   const BLOG_POST asPosts[] =
+   {
+      { "TITLE 1", "https://blog/1", 2, 1583845200 },
+      { "TITLE 2", "https://blog/2", 0, 0 },
+      { "TITLE 3", "https://blog/3", 1, 1583931600 }
+   };
+   const BLOG_POST sMixedCase = { "TITLE 2", "http://BLOG/2/", 0, 0 };
+   char acTorn[64] = { 0, };
+   FILE *pFile = _null_;
+   size_t ulRead = 0;
+
+   PRINTF_TEST( "Database file is loaded as it was written" );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == ARRAY_COUNT( asPosts ) ? NO_ERROR : TEST_FAILED );
+   for( uint32_t x = 0; x < ARRAY_COUNT( asPosts ); x++ )
+   {
+      const BLOG_POST *psPost = Database_Post( hDatabase, x );
+
+      RETURN_ON_FAIL( strcmp( psPost->szTitle, asPosts[x].szTitle ) == 0 && strcmp( psPost->szLink, asPosts[x].szLink ) == 0 ? NO_ERROR : TEST_FAILED );
+      RETURN_ON_FAIL( psPost->ulTimesShared == asPosts[x].ulTimesShared && psPost->tPubDate == asPosts[x].tPubDate ? NO_ERROR : TEST_FAILED );
+   }
+   // Lookups go through the index loaded from the file
+   RETURN_ON_FAIL( !Database_IsUniquePost( hDatabase, &sMixedCase ) ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &( BLOG_POST ){ "TITLE 4", "https://blog/4", 0, 0 } ) );
+   RETURN_ON_FAIL( !Database_IsUniquePost( hDatabase, &( BLOG_POST ){ "TITLE 4", "https://blog/4", 0, 0 } ) ? NO_ERROR : TEST_FAILED );
+
+   // Xml copies of the database go both ways
+   RETURN_ON_FAIL( Database_ExportXml( hDatabase, "dbTestExport.xml" ) );
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( Database_ImportXml( hDatabase, "dbTestExport.xml" ) );
+   unlink( "dbTestExport.xml" );
+   Database_Test_Clear( hDatabase );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == ARRAY_COUNT( asPosts ) + 1 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 3 )->tPubDate == asPosts[2].tPubDate ? NO_ERROR : TEST_FAILED );
+
+   // A file cut short is rejected instead of being read past its end
+   pFile = fopen( hDatabase->szFile, "rb" );
+   RETURN_ON_NULL( pFile );
+   ulRead = fread( acTorn, 1, sizeof( acTorn ), pFile );
+   fclose( pFile );
+   RETURN_ON_FAIL( WriteFileAtomic( hDatabase->szFile, acTorn, ulRead ) );
+   RETURN_ON_FAIL( ReadDatabaseFile( hDatabase ) == FILE_ERROR ? NO_ERROR : TEST_FAILED );
+   unlink( hDatabase->szFile );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_IndexLookup( DATABASE_HANDLE hDatabase )
+{
+   BLOG_POST sPost = { "TITLE", "https://Blog.Example.com/post/", 0, 0 };
+   char szTemp[32 + 1] = { 0, };
+   int32_t lIndex = -1;
+
+   PRINTF_TEST( "Indexed lookups" );
+   Database_Test_Clear( hDatabase );
+
+   for( uint32_t x = 0; x < 100; x++ )
+   {
+      snprintf( szTemp, sizeof( szTemp ), "TITLE %u", x );
+      Strcpy_safe( sPost.szTitle, szTemp, sizeof( sPost.szTitle ) );
+      snprintf( szTemp, sizeof( szTemp ), "LINK %u", x );
+      Strcpy_safe( sPost.szLink, szTemp, sizeof( sPost.szLink ) );
+      RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   }
+
+   // The first post added has been moved to the end of the list
+   Strcpy_safe( sPost.szTitle, "TITLE 0", sizeof( sPost.szTitle ) );
+   Strcpy_safe( sPost.szLink, "LINK 0", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, &sPost, &lIndex ) );
+   RETURN_ON_FAIL( lIndex == 99 ? NO_ERROR : TEST_FAILED );
+
+   // Same link, the title is the tiebreak
+   Strcpy_safe( sPost.szTitle, "TITLE 1", sizeof( sPost.szTitle ) );
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, &sPost, &lIndex ) );
+   RETURN_ON_FAIL( lIndex == -1 ? NO_ERROR : TEST_FAILED );
+
+   // Scheme, case of the host & trailing '/' are ignored
+   Strcpy_safe( sPost.szTitle, "NORMALIZED", sizeof( sPost.szTitle ) );
+   Strcpy_safe( sPost.szLink, "http://Blog.Example.com/Post/", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_AddNewItem( hDatabase, &sPost ) );
+   Strcpy_safe( sPost.szLink, "https://blog.example.com/Post", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, &sPost, &lIndex ) );
+   RETURN_ON_FAIL( lIndex == 0 ? NO_ERROR : TEST_FAILED );
+   Strcpy_safe( sPost.szLink, "https://blog.example.com/post", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_IsUniquePost( hDatabase, &sPost ) ? NO_ERROR : TEST_FAILED );
+
+   // Same lookups once the index has been rebuilt
+   RETURN_ON_FAIL( Database_RebuildIndex( hDatabase ) );
+   Strcpy_safe( sPost.szLink, "HTTPS://BLOG.EXAMPLE.COM/Post//", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, &sPost, &lIndex ) );
+   RETURN_ON_FAIL( lIndex == 0 ? NO_ERROR : TEST_FAILED );
+   Strcpy_safe( sPost.szTitle, "TITLE 50", sizeof( sPost.szTitle ) );
+   Strcpy_safe( sPost.szLink, "LINK 50", sizeof( sPost.szLink ) );
+   RETURN_ON_FAIL( Database_FindIndex( hDatabase, &sPost, &lIndex ) );
+   RETURN_ON_FAIL( lIndex == 50 ? NO_ERROR : TEST_FAILED );
+
+   Database_Test_Clear( hDatabase );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_StreamedRefresh( DATABASE_HANDLE hDatabase )
+{
+   // Newest post first, like the blog's feed. The last post is already in the database
+   const char *pszFeed = 
+      "<rss><channel>"
+         "<item><title>NEWEST</title><link>NEWEST LINK</link></item>"
+         "<item><title>NEWER</title><link>NEWER LINK</link></item>"
+         "<item><title>NEWER</title><link>NEWER LINK</link></item>"
+         "<item><title>TEST_TITLE</title><link>TEST LINK</link></item>"
+      "</channel></rss>";
+   const char *pszNewFeed = 
+      "<rss><channel>"
+         "<item><title>NEW 3</title><link>NEW LINK 3</link></item>"
+         "<item><title>NEW 2</title><link>NEW LINK 2</link></item>"
+         "<item><title>NEW 1</title><link>NEW LINK 1</link></item>"
+      "</channel></rss>";
+   const BLOG_POST sKnownPost = { "TEST_TITLE", "TEST LINK", 3, 0 };
+   const size_t ulChunkSize = 7;
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "Refresh from a streamed feed" );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, &sKnownPost, 1 ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+
+   RETURN_ON_FAIL( Database_PushRefreshData( hDatabase, pszFeed, strlen( pszFeed ) ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_BeginRefresh( hDatabase, 0 ) );
+   for( size_t x = 0; x < strlen( pszFeed ) && eRet != STOPPED; x += ulChunkSize )
+   {
+      size_t ulLeft = strlen( pszFeed ) - x;
+
+      eRet = Database_PushRefreshData( hDatabase, &pszFeed[x], ulLeft < ulChunkSize ? ulLeft : ulChunkSize );
+      RETURN_ON_FAIL( ( eRet == NO_ERROR || eRet == STOPPED ) ? NO_ERROR : TEST_FAILED );
+   }
+   // Stopped at the known post, the rest of the document is never looked at
+   RETURN_ON_FAIL( eRet == STOPPED ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_PushRefreshData( hDatabase, "<<<", 3 ) == STOPPED ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_EndRefresh( hDatabase ) );
+
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 3 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 0 )->szTitle, "NEWEST" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 1 )->szTitle, "NEWER" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_Post( hDatabase, 2 )->ulTimesShared == 3 ? NO_ERROR : TEST_FAILED );
+
+   // A truncated feed leaves the database untouched
+   RETURN_ON_FAIL( Database_BeginRefresh( hDatabase, 0 ) );
+   RETURN_ON_FAIL( Database_PushRefreshData( hDatabase, pszNewFeed, strlen( pszNewFeed ) / 2 ) );
+   RETURN_ON_FAIL( Database_EndRefresh( hDatabase ) == FILE_ERROR ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_EndRefresh( hDatabase ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 3 ? NO_ERROR : TEST_FAILED );
+
+   // Only the newest posts are looked at when the feed is capped
+   RETURN_ON_FAIL( Database_BeginRefresh( hDatabase, 2 ) );
+   RETURN_ON_FAIL( Database_PushRefreshData( hDatabase, pszNewFeed, strlen( pszNewFeed ) ) == STOPPED ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_EndRefresh( hDatabase ) );
+   RETURN_ON_FAIL( hDatabase->sList.sPosts.ulCount == 5 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 0 )->szTitle, "NEW 3" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( Database_Post( hDatabase, 1 )->szTitle, "NEW 2" ) == 0 ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE Database_Test_RefreshSchedule( DATABASE_HANDLE hDatabase )
+{
+   const char *pszFeed = 
+      "<rss xmlns:sy=\"http://purl.org/rss/1.0/modules/syndication/\"><channel>"
+         "<ttl>60</ttl>"
+         "<sy:updatePeriod>\n\thourly\t</sy:updatePeriod>"
+         "<sy:updateFrequency>\n\t2\t</sy:updateFrequency>"
+         "<item><title>TEST_TITLE</title><link>TEST LINK</link></item>"
+      "</channel></rss>";
+   const time_t tDay = 24 * 60 * 60;
+   const time_t tNow = 1600000000;
+   // Weekly with a burst of two posts on the same day, newest first
+   const time_t atWeekly[] = { tNow - tDay, tNow - 8 * tDay, tNow - 8 * tDay, tNow - 15 * tDay, tNow - 22 * tDay };
+   const time_t atQuiet[] = { tNow - 60 * tDay, tNow - 67 * tDay, tNow - 74 * tDay };
+   const BLOG_POST sKnownPost = { "TEST_TITLE", "TEST LINK", 0, 0 };
+   BLOG_POST asPosts[ARRAY_COUNT( atWeekly )] = { 0, };
+   FEED_HINTS sHints = { 0, };
+   uint32_t ulSeconds = 0;
+
+   PRINTF_TEST( "Refresh scheduled from the feed & the dates of its posts" );
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, &sKnownPost, 1 ) );
+   RETURN_ON_FAIL( CreateDatabaseFile( hDatabase ) );
+
+   // The hints come before the known post the parse stops at
+   RETURN_ON_FAIL( Database_BeginRefresh( hDatabase, 0 ) );
+   RETURN_ON_FAIL( Database_PushRefreshData( hDatabase, pszFeed, strlen( pszFeed ) ) == STOPPED ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_EndRefresh( hDatabase ) );
+   RETURN_ON_FAIL( Database_GetFeedHints( hDatabase, &sHints ) );
+   RETURN_ON_FAIL( ( sHints.ulTtl == 60 * 60 && sHints.ulUpdateInterval == 30 * 60 ) ? NO_ERROR : TEST_FAILED );
+
+   // Nothing to go by
+   sHints.ulUpdateInterval = 0;
+   RETURN_ON_FAIL( Database_ScheduleRefresh( atWeekly, 1, &sHints, tNow, &ulSeconds ) == NOT_FOUND ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( Database_GetRefreshInterval( hDatabase, &sHints, tNow, &ulSeconds ) == NOT_FOUND ? NO_ERROR : TEST_FAILED );
+
+   // The posts are trusted over sy:updatePeriod
+   sHints.ulUpdateInterval = 60 * 60;
+   RETURN_ON_FAIL( Database_ScheduleRefresh( atWeekly, ARRAY_COUNT( atWeekly ), &sHints, tNow, &ulSeconds ) );
+   RETURN_ON_FAIL( ulSeconds == 7 * tDay ? NO_ERROR : TEST_FAILED );
+   // A blog which has gone quiet is fetched less often, but never before the ttl
+   RETURN_ON_FAIL( Database_ScheduleRefresh( atQuiet, ARRAY_COUNT( atQuiet ), &sHints, tNow, &ulSeconds ) );
+   RETURN_ON_FAIL( ulSeconds == 30 * tDay ? NO_ERROR : TEST_FAILED );
+   sHints.ulTtl = 10 * tDay;
+   RETURN_ON_FAIL( Database_ScheduleRefresh( atWeekly, ARRAY_COUNT( atWeekly ), &sHints, tNow, &ulSeconds ) );
+   RETURN_ON_FAIL( ulSeconds == 10 * tDay ? NO_ERROR : TEST_FAILED );
+   // sy:updatePeriod when there aren't enough dated posts
+   sHints.ulTtl = 0;
+   RETURN_ON_FAIL( Database_ScheduleRefresh( atWeekly, 1, &sHints, tNow, &ulSeconds ) );
+   RETURN_ON_FAIL( ulSeconds == tDay / 2 ? NO_ERROR : TEST_FAILED );
+
+   // Dates are taken from the posts in the database, in any order
+   for( uint32_t x = 0; x < ARRAY_COUNT( asPosts ); x++ )
+   {
+      snprintf( asPosts[x].szTitle, sizeof( asPosts[x].szTitle ), "Title %u", x );
+      snprintf( asPosts[x].szLink, sizeof( asPosts[x].szLink ), "Link %u", x );
+      asPosts[x].tPubDate = atWeekly[ARRAY_COUNT( atWeekly ) - 1 - x];
+   }
+   RETURN_ON_FAIL( Database_Test_SetPosts( hDatabase, asPosts, ARRAY_COUNT( asPosts ) ) );
+   RETURN_ON_FAIL( Database_GetRefreshInterval( hDatabase, &sHints, tNow, &ulSeconds ) );
+   RETURN_ON_FAIL( ulSeconds == 7 * tDay ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
+/* 
+   Database of Database_Test_Handles, filled & read back by a thread of its own
+ */
+typedef struct
+{
+   const char *pszName;
+   pthread_t sThread;
+   ERROR_CODE eResult;
+} DATABASE_TEST_HANDLE;
+
+static ERROR_CODE Database_Test_FillHandle( const char *pszName )
+{
+   DATABASE_HANDLE hDatabase = _null_;
+   BLOG_POST sPost = { "TITLE", "LINK", 0, 0 };
+   ERROR_CODE eRet = NO_ERROR;
+   ERROR_CODE eClose = NO_ERROR;
+
+   RETURN_ON_FAIL( Database_Open( pszName, &hDatabase ) );
+   // Database file with a single post, the others are only journaled
+   eRet = Database_Test_SetPosts( hDatabase, &sPost, 1 );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = CreateDatabaseFile( hDatabase );
+   }
+   for( uint32_t x = 0; !ISERROR( eRet ) && x < 50; x++ )
+   {
+      snprintf( sPost.szLink, sizeof( sPost.szLink ), "https://%s/%u", pszName, x );
+      eRet = Database_AddNewItem( hDatabase, &sPost );
+   }
+   eClose = Database_Close( hDatabase );
+
+   return ISERROR( eRet ) ? eRet : eClose;
+}
+
+static ERROR_CODE Database_Test_ReadHandle( const char *pszName, const char *pszOtherName )
+{
+   DATABASE_HANDLE hDatabase = _null_;
+   BLOG_POST sPost = { "TITLE", "LINK", 0, 0 };
+   ERROR_CODE eRet = NO_ERROR;
+   ERROR_CODE eClose = NO_ERROR;
+
+   RETURN_ON_FAIL( Database_Open( pszName, &hDatabase ) );
+   eRet = Database_Init( hDatabase );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = ( hDatabase->sList.sPosts.ulCount == 51 ) ? NO_ERROR : TEST_FAILED;
+   }
+   // Posts of the other database are nowhere to be seen
+   snprintf( sPost.szLink, sizeof( sPost.szLink ), "https://%s/%u", pszName, 49 );
+   eRet = ( !ISERROR( eRet ) && !Database_IsUniquePost( hDatabase, &sPost ) ) ? NO_ERROR : TEST_FAILED;
+   snprintf( sPost.szLink, sizeof( sPost.szLink ), "https://%s/%u", pszOtherName, 49 );
+   eRet = ( !ISERROR( eRet ) && Database_IsUniquePost( hDatabase, &sPost ) ) ? NO_ERROR : TEST_FAILED;
+
+   Database_Test_RemoveFiles( hDatabase );
+   eClose = Database_Close( hDatabase );
+
+   return ISERROR( eRet ) ? eRet : eClose;
+}
+
+static void *Database_Test_HandleThread( void *pvHandle )
+{
+   DATABASE_TEST_HANDLE *psHandle = ( DATABASE_TEST_HANDLE * )pvHandle;
+
+   psHandle->eResult = Database_Test_FillHandle( psHandle->pszName );
+
+   return _null_;
+}
+
+/* 
+   Databases opened under different names share nothing, they can be used by two threads at once
+ */
+static ERROR_CODE Database_Test_Handles( void )
+{
+   DATABASE_TEST_HANDLE asHandles[] = { { "database_a", 0, NO_ERROR }, { "database_b", 0, NO_ERROR } };
+   const uint32_t ulCount = ARRAY_COUNT( asHandles );
+   DATABASE_HANDLE hDatabase = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "Independent database handles" );
+
+   RETURN_ON_FAIL( ( Database_Open( "", &hDatabase ) == INVALID_ARG ) ? NO_ERROR : TEST_FAILED );
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      UTIL_ASSERT( ( pthread_create( &asHandles[x].sThread, _null_, Database_Test_HandleThread, &asHandles[x] ) == 0 ), TEST_FAILED );
+   }
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      pthread_join( asHandles[x].sThread, _null_ );
+   }
+   for( uint32_t x = 0; !ISERROR( eRet ) && x < ulCount; x++ )
+   {
+      eRet = asHandles[x].eResult;
+      if( !ISERROR( eRet ) )
+      {
+         eRet = Database_Test_ReadHandle( asHandles[x].pszName, asHandles[( x + 1 ) % ulCount].pszName );
+      }
+   }
+
+   return eRet;
+}
+
+/* 
+   A fresh install has no database files, the first refresh starts from an empty database
+ */
+static ERROR_CODE Database_Test_FreshInstall( void )
+{
+   const char *pszFeed = 
+      "<rss><channel>"
+         "<item><title>FRESH 2</title><link>FRESH LINK 2</link></item>"
+         "<item><title>FRESH 1</title><link>FRESH LINK 1</link></item>"
+      "</channel></rss>";
+   DATABASE_HANDLE hDatabase = _null_;
+   BLOG_POST sPost = { "FRESH 1", "FRESH LINK 1", 0, 0 };
+   uint32_t ulCount = 0;
+   ERROR_CODE eRet = NO_ERROR;
+   ERROR_CODE eClose = NO_ERROR;
+
+   PRINTF_TEST( "Refresh without any database file" );
+
+   RETURN_ON_FAIL( Database_Open( "database_fresh", &hDatabase ) );
+   eRet = Database_RefreshDatabaseFromMemory( hDatabase, pszFeed, strlen( pszFeed ) );
+   if( !ISERROR( eRet ) )
+   {
+      ulCount = hDatabase->sList.sPosts.ulCount;
+      eRet = ( ulCount >= 2 && !Database_IsUniquePost( hDatabase, &sPost ) ) ? NO_ERROR : TEST_FAILED;
+   }
+   eClose = Database_Close( hDatabase );
+   eRet = ISERROR( eRet ) ? eRet : eClose;
+
+   // The refreshed posts were written onto the new database
+   RETURN_ON_FAIL( Database_Open( "database_fresh", &hDatabase ) );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = Database_Init( hDatabase );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      eRet = ( hDatabase->sList.sPosts.ulCount == ulCount && !Database_IsUniquePost( hDatabase, &sPost ) ) ? NO_ERROR : TEST_FAILED;
+   }
+
+   Database_Test_RemoveFiles( hDatabase );
+   eClose = Database_Close( hDatabase );
+
+   return ISERROR( eRet ) ? eRet : eClose;
+}
+
 static ERROR_CODE Database_Test_CountList( void )
 {
    BLOG_POST asList[20] = {0, };
@@ -590,7 +2510,7 @@ static ERROR_CODE Database_Test_CountList( void )
 
    PRINTF_TEST( "Simple Test to count the number of items" );
 
-   for( int x = 0; x < ulFillCount; x++ )
+   for( int x = 0; x < ( int )ulFillCount; x++ )
    {
       snprintf( asList[x].szTitle, sizeof( asList[x].szTitle ), "Title %u", x );
    }
@@ -605,23 +2525,54 @@ static ERROR_CODE Database_Test_CountList( void )
    return NO_ERROR;
 }
 
-ERROR_CODE Database_Tests( void )
+/* 
+   Tests sharing a single database, its files are removed by the caller whatever the result
+ */
+static ERROR_CODE Database_Test_Shared( DATABASE_HANDLE hDatabase )
 {
-   memset( &s_sList, 0, sizeof( s_sList ) );
-   
-   RETURN_ON_FAIL( Database_Test_Sanity() );
-   RETURN_ON_FAIL( Database_Test_SimpleComparison() );
-   RETURN_ON_FAIL( Database_Test_OldestPost() );
-   RETURN_ON_FAIL( Database_Test_IsUniqueSimple() );
-   RETURN_ON_FAIL( Database_Test_IsUniqueFilledDatabase() );
-   RETURN_ON_FAIL( Database_Test_IsNotUniqueFilledDatabase() );
-   RETURN_ON_FAIL( Database_Test_AddSimpleItem() );
-   RETURN_ON_FAIL( Database_Test_AddItemToFilledDatabase() );
-   RETURN_ON_FAIL( Database_Test_AddItemDatabaseFull() );
-   RETURN_ON_FAIL( Database_Test_UpdatePostSimple() );
+   RETURN_ON_FAIL( Database_Test_Sanity( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_SimpleComparison( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_OldestPost( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_ShareRotation( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_IsUniqueSimple( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_IsUniqueFilledDatabase( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_IsNotUniqueFilledDatabase( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_AddSimpleItem( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_AddItemToFilledDatabase( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_AddItemLargeDatabase( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_UpdatePostSimple( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_Batch( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_Journal( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_MergePosts( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_Snapshot( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_IndexLookup( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_StreamedRefresh( hDatabase ) );
+   RETURN_ON_FAIL( Database_Test_RefreshSchedule( hDatabase ) );
    RETURN_ON_FAIL( Database_Test_CountList() );
 
-   memset( &s_sList, 0, sizeof( s_sList ) );
+   return NO_ERROR;
+}
+
+ERROR_CODE Database_Tests( void )
+{
+   DATABASE_HANDLE hDatabase = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+   ERROR_CODE eClose = NO_ERROR;
+
+   RETURN_ON_FAIL( Database_Open( DATABASE_TEST_NAME, &hDatabase ) );
+   // Left over by a run which was interrupted
+   Database_Test_RemoveFiles( hDatabase );
+
+   eRet = Database_Test_Shared( hDatabase );
+   Database_Test_Clear( hDatabase );
+   Database_Test_RemoveFiles( hDatabase );
+   eClose = Database_Close( hDatabase );
+   eRet = ISERROR( eRet ) ? eRet : eClose;
+   RETURN_ON_FAIL( eRet );
+   eRet = Database_Test_Handles();
+   RETURN_ON_FAIL( eRet );
+   eRet = Database_Test_FreshInstall();
+   RETURN_ON_FAIL( eRet );
    DBG_PRINTF( "------------- %s: [%u] Tests passed -------------", __func__, s_ulTestCount );
 
    return NO_ERROR;
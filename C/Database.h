@@ -8,71 +8,298 @@
 
 #include "Utils.h"
 #include "xmlWrapper.h"
+#include "RecordArray.h"
+
+// Database the bot has always used, i.e. database.bin & database.journal
+#define DATABASE_DEFAULT_NAME ( "database" )
+// Longest name of a database, its files are the name followed by an extension
+#define DATABASE_MAX_NAME_LEN ( 32 )
 
 /*
     Blog Post Structure
     - Valid Blog post: Title & Link cannot be empty
-    Times share can be empty
+    Times shared & the publication date can be 0
     Assumption: There is only website being used to share posts.
 */
 typedef struct
 {
     char szTitle[128 + 1];     // Title extracted from the website's RSS
     char szLink[128 + 1];      // Link extracted from the website's RSS
-    char szTimesShared[2 + 1]; // Non-RSS variable. Used for internal database
+    uint32_t ulTimesShared;    // Non-RSS variable. Used for internal database
+    time_t tPubDate;           // Publication date extracted from the website's RSS, 0 if unknown
 } BLOG_POST;
 
+/*
+    How often a feed says it should be fetched, 0 if the feed doesn't say
+*/
+typedef struct
+{
+    uint32_t ulTtl;             // <ttl>, the feed shouldn't be fetched again before it has passed
+    uint32_t ulUpdateInterval;  // sy:updatePeriod divided by sy:updateFrequency
+} FEED_HINTS;
+
+/*
+    Feed parsed by Database_ParseFeed, free it with Database_FreeFeed
+*/
+typedef struct
+{
+    RECORD_ARRAY sPosts;        // BLOG_POSTs, index 0 being the newest as in the feed
+    FEED_HINTS sHints;
+} DATABASE_FEED;
+
+/*
+    Database opened by Database_Open, every function taking one only touches that database
+    Databases can be used by different threads at once, a database by a single thread at a time
+*/
+typedef struct DATABASE_STATE *DATABASE_HANDLE;
+
+/*
+    Opens a database, nothing is read before Database_Init or the first refresh
+    @param (INPUT):     pszName     -> Name of the database, e.g. DATABASE_DEFAULT_NAME. Its files are <name>.bin,
+                                       <name>.journal & <name>.journal.old, <name>.xml is imported from older versions
+    @param (OUTPUT):    phDatabase  -> Database, close it with Database_Close
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> Name is empty or longer than DATABASE_MAX_NAME_LEN
+    @return             NO_MEMORY   -> Database couldn't be allocated
+ */
+ERROR_CODE Database_Open( const char *pszName, DATABASE_HANDLE *phDatabase );
+
+/*
+    Waits for the database file being written in the background & frees the database
+    @param (INPUT):     hDatabase   -> Database, can't be used afterwards
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> hDatabase is NULL
+    @return             FILE_ERROR  -> Database file couldn't be written, its changes are still in the journal
+ */
+ERROR_CODE Database_Close( DATABASE_HANDLE hDatabase );
+
 /*
     Initializes Database variables
-    Will try to open the database file
-    If database file is absent, will try to open the RSS file
+    Will try to open the database file, a binary file which is mapped instead of parsed
+    If database file is absent, will try to import database.xml of older versions & then the RSS file
     Name of the RSS file is in Config file
-    @param: None
+    The database stays in memory, later calls return straight away
+    @param (INPUT):     hDatabase   -> Database
     @return: NO_ERROR = Success
 */
-ERROR_CODE Database_Init(void);
+ERROR_CODE Database_Init( DATABASE_HANDLE hDatabase );
+
+/* 
+    Replaces the database with one exported by Database_ExportXml & writes the database file
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     pszFileName -> Xml file
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> File holds no posts
+    @return             FILE_ERROR  -> File couldn't be read or the database file couldn't be written
+ */
+ERROR_CODE Database_ImportXml( DATABASE_HANDLE hDatabase, const char *pszFileName );
+
+/* 
+    Writes the database as xml, e.g. to look at it or edit it before importing it back
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     pszFileName -> Xml file, replaced if it exists
+    @return             NO_ERROR    -> Success
+    @return             FILE_ERROR  -> File couldn't be written
+ */
+ERROR_CODE Database_ExportXml( DATABASE_HANDLE hDatabase, const char *pszFileName );
 
 /* 
     Gets the blog post which has been shared the least number of times
     When searching for the post, it will try to find the post which is at a higher index in the array
+    @param (INPUT):     hDatabase   -> Database
     @param (OUTPUT):    psPost      -> Blog Post shared least number of times
     @return:            NO_ERROR    -> Success
  */
-ERROR_CODE Database_GetOldestLeastSharedPost(BLOG_POST *psPost);
+ERROR_CODE Database_GetOldestLeastSharedPost( DATABASE_HANDLE hDatabase, BLOG_POST *psPost );
 
 /* 
     Adds new blog post to the database.
-    Will always add a post to index 0 of the queue
+    Will always add a post to index 0 of the queue, the database grows as required
+    The post is appended to the database journal, the database file isn't rewritten
+    @param (INPUT):     hDatabase   -> Database
     @param (INPUT):     psPost      -> New Blog post which needs to be added
     @return:            NO_ERROR    -> Success
     @return:            INVALID_ARG -> psPost pointer is NULL
-    @return:            OVERFLOW    -> Database is full, need to expand the count
+    @return:            NO_MEMORY   -> Database couldn't be grown, it is left as it was
+    @return:            FILE_ERROR  -> Post couldn't be journaled
+ */
+ERROR_CODE Database_AddNewItem( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost );
+
+/* 
+    Adds the posts which aren't in the database yet, e.g. the posts of a feed
+    Duplicates & invalid posts are skipped, so are posts listed twice. The new posts are
+    journaled together with a single write
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     pasPosts    -> Posts, index 0 being the newest as in a feed. Ends up at index 0
+    @param (INPUT):     ulCount     -> Number of posts
+    @return:            NO_ERROR    -> Success
+    @return:            INVALID_ARG -> pasPosts pointer is NULL
+    @return:            NO_MEMORY   -> Database couldn't be grown, the posts added until then are kept
+    @return:            FILE_ERROR  -> Posts couldn't be journaled
  */
-ERROR_CODE Database_AddNewItem(const BLOG_POST *psPost);
+ERROR_CODE Database_MergePosts( DATABASE_HANDLE hDatabase, const BLOG_POST *pasPosts, uint32_t ulCount );
 
 /* 
     Compares blog post with the database to find if the post is unique
+    @param (INPUT):     hDatabase   -> Database
     @param (INPUT):     psPost      -> Blog post whose uniquesness is to be determined
     @return:            true        -> Blog post is unique
     @return:            false       -> Blog post is already in the database
  */
-bool Database_IsUniquePost(const BLOG_POST *psPost);
+bool Database_IsUniquePost( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost );
 
 /*
     Updates a post which is already on the database.
+    The change is appended to the database journal, the database file isn't rewritten
+    @param (INPUT):     hDatabase   -> Database
     @param (INPUT):     psPost      -> Blog Post which needs to be updated
     @return:            NO_ERROR    -> Success
     @return:            INVALID_ARG -> psPost is invalid
-    @return:            OVERFLOW    -> Database is full, need to expand the count
+    @return:            FILE_ERROR  -> Change couldn't be journaled
 */
-ERROR_CODE Database_UpdateTimesShared( const BLOG_POST *psPost );
+ERROR_CODE Database_UpdateTimesShared( DATABASE_HANDLE hDatabase, const BLOG_POST *psPost );
 
 /* 
     Refreshes already initialized database
-    Will re-read the config specified RSS file
+    Will re-read the config specified RSS file, up to the first post which is already in the database
+    @param (INPUT):     hDatabase   -> Database
     @return             NO_ERROR    -> Database updated
  */
-ERROR_CODE Database_RefreshDatabase( void );
+ERROR_CODE Database_RefreshDatabase( DATABASE_HANDLE hDatabase );
+
+/* 
+    Refreshes already initialized database from a feed held in memory
+    Same as Database_RefreshDatabase, the rest of the feed is skipped after the first known post
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     pcFeed      -> RSS feed, e.g. downloaded by DownloadFeedToBuffer
+    @param (INPUT):     ulSize      -> Size of the feed in bytes
+    @return             NO_ERROR    -> Database updated
+    @return             INVALID_ARG -> Feed is empty
+ */
+ERROR_CODE Database_RefreshDatabaseFromMemory( DATABASE_HANDLE hDatabase, const char *pcFeed, size_t ulSize );
+
+/* 
+    Starts refreshing the database from a feed which is still being downloaded
+    Every post is compared with the database as soon as it has been parsed. The feed is newest first,
+    so the parse stops at the first post which is already in the database
+    Has to be followed by Database_EndRefresh or Database_CancelRefresh
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     ulMaxPosts  -> Number of feed posts after which the parse stops, 0 for no limit
+    @return             NO_ERROR    -> Refresh started
+    @return             FILE_ERROR  -> Database file couldn't be read
+ */
+ERROR_CODE Database_BeginRefresh( DATABASE_HANDLE hDatabase, uint32_t ulMaxPosts );
+
+/* 
+    Parses the next chunk of the feed
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     pcChunk     -> Next bytes of the feed, e.g. from DownloadFeedStream
+    @param (INPUT):     ulSize      -> Size of the chunk in bytes
+    @return             NO_ERROR    -> Success
+    @return             STOPPED     -> The rest of the feed isn't needed, Database_EndRefresh can be called straight away
+    @return             INVALID_ARG -> No refresh has been started
+    @return             FILE_ERROR  -> Feed isn't valid XML
+ */
+ERROR_CODE Database_PushRefreshData( DATABASE_HANDLE hDatabase, const char *pcChunk, size_t ulSize );
+
+/* 
+    Finishes the refresh, the new posts are added by Database_MergePosts
+    @param (INPUT):     hDatabase   -> Database
+    @return             NO_ERROR    -> Database updated
+    @return             INVALID_ARG -> No refresh has been started
+    @return             FILE_ERROR  -> Feed is incomplete or isn't valid XML, unless the parse had already stopped
+ */
+ERROR_CODE Database_EndRefresh( DATABASE_HANDLE hDatabase );
+
+/* 
+    Drops a refresh started by Database_BeginRefresh, the database is left untouched
+    @param (INPUT):     hDatabase   -> Database
+ */
+void Database_CancelRefresh( DATABASE_HANDLE hDatabase );
+
+/* 
+    Parses a whole feed without looking at the database, so that feeds can be parsed on other
+    threads while the database is being refreshed with the feeds parsed before
+    @param (INPUT):     pcFeed      -> RSS feed
+    @param (INPUT):     ulSize      -> Size of the feed in bytes
+    @param (INPUT):     ulMaxPosts  -> Number of feed posts after which the parse stops, 0 for no limit
+    @param (OUTPUT):    psFeed      -> Posts & hints of the feed
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> One or more parameters are invalid
+    @return             FILE_ERROR  -> Feed isn't valid XML, psFeed is left empty
+    @return             NO_MEMORY   -> Posts couldn't be stored, psFeed is left empty
+ */
+ERROR_CODE Database_ParseFeed( const char *pcFeed, size_t ulSize, uint32_t ulMaxPosts, DATABASE_FEED *psFeed );
+
+/* 
+    Adds the posts of a feed parsed by Database_ParseFeed which aren't in the database yet, see Database_MergePosts
+    Not thread safe, every change to the database has to be made by the same thread at a time
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     psFeed      -> Feed
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> psFeed is NULL
+    @return             NO_MEMORY   -> Database couldn't be grown, the posts added until then are kept
+    @return             FILE_ERROR  -> Posts couldn't be journaled
+ */
+ERROR_CODE Database_MergeFeed( DATABASE_HANDLE hDatabase, DATABASE_FEED *psFeed );
+
+/* 
+    Frees a feed parsed by Database_ParseFeed
+    @param (INPUT):     psFeed      -> Feed, can be empty
+ */
+void Database_FreeFeed( DATABASE_FEED *psFeed );
+
+/* 
+    Gets the hints of the last feed refreshed by Database_EndRefresh, in seconds
+    @param (INPUT):     hDatabase   -> Database
+    @param (OUTPUT):    psHints     -> Hints, 0 if the feed didn't have them or no feed has been refreshed
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> psHints is NULL
+ */
+ERROR_CODE Database_GetFeedHints( DATABASE_HANDLE hDatabase, FEED_HINTS *psHints );
+
+/* 
+    Works out how long to wait before fetching the feed again, from the publication dates of the
+    newest posts in the database & the hints of the feed
+    Active blogs are fetched about as often as they publish, quiet ones less & less often
+    @param (INPUT):     hDatabase   -> Database
+    @param (INPUT):     psHints     -> Hints of the feed, e.g. from Database_GetFeedHints
+    @param (INPUT):     tNow        -> Current time
+    @param (OUTPUT):    pulSeconds  -> Seconds until the next fetch
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> One or more parameters are NULL
+    @return             NOT_FOUND   -> Neither the posts nor the hints tell how often the blog is updated
+ */
+ERROR_CODE Database_GetRefreshInterval( DATABASE_HANDLE hDatabase, const FEED_HINTS *psHints, time_t tNow, uint32_t *pulSeconds );
+
+/* 
+    Starts a batch of changes, e.g. a bulk import or every change of a run
+    Changes made during the batch are only written by Database_EndBatch, with a single write &
+    sync instead of one per change. Batches can be nested
+    @param (INPUT):     hDatabase   -> Database
+ */
+void Database_BeginBatch( DATABASE_HANDLE hDatabase );
+
+/* 
+    Ends a batch, the changes made since the outermost batch started are appended to the journal
+    The database file is written instead if they would take the journal past its limit
+    @param (INPUT):     hDatabase   -> Database
+    @return             NO_ERROR    -> Success
+    @return             INVALID_ARG -> No batch has been started
+    @return             FILE_ERROR  -> Database file couldn't be written
+ */
+ERROR_CODE Database_EndBatch( DATABASE_HANDLE hDatabase );
+
+/* 
+    Waits for the database file being written in the background, if any
+    Once the database journal grows large enough, it is folded back into the database file on
+    a background thread. Call this before exiting so that the work isn't lost
+    @param (INPUT):     hDatabase   -> Database
+    @return             NO_ERROR    -> Success
+    @return             FILE_ERROR  -> Database file couldn't be written, its changes are still in the journal
+                                   Only returned once, the next database file written holds them
+ */
+ERROR_CODE Database_Flush( DATABASE_HANDLE hDatabase );
 
 /* 
     Database Unit Tests
@@ -0,0 +1,195 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include <libxml/parser.h>
+#include "FeedPipeline.h"
+#include "BoundedQueue.h"
+
+/* 
+   A feed on its way through the pipeline, owned by the stage which popped it last
+ */
+typedef struct
+{
+   uint32_t ulRequest;
+   ERROR_CODE eResult;
+   FEED_BUFFER sBuffer;
+   DATABASE_FEED sFeed;
+} FEED_PIPELINE_JOB;
+
+typedef struct
+{
+   DATABASE_HANDLE hDatabase;
+   // One job per feed, handed out by the fetch in the order the feeds are downloaded
+   FEED_PIPELINE_JOB *pasJobs;
+   uint32_t ulJobs;
+   BOUNDED_QUEUE sParseQueue;
+   BOUNDED_QUEUE sMergeQueue;
+   uint32_t ulMaxPosts;
+   // Result of the database batch the feeds are merged in
+   ERROR_CODE eMergeResult;
+} FEED_PIPELINE;
+
+// Static Functions
+static ERROR_CODE feedPipelineFetched( uint32_t ulRequest, ERROR_CODE eResult, FEED_BUFFER *psBuffer, void *pvPipeline );
+static void *feedPipelineParse( void *pvPipeline );
+static void *feedPipelineMerge( void *pvPipeline );
+static uint32_t feedPipelineWorkers( const FEED_PIPELINE_OPTIONS *psOptions, uint32_t ulCount );
+
+/* 
+   Fetch stage, waits for room in the parse queue. The downloads still running are held back meanwhile
+ */
+static ERROR_CODE feedPipelineFetched( uint32_t ulRequest, ERROR_CODE eResult, FEED_BUFFER *psBuffer, void *pvPipeline )
+{
+   FEED_PIPELINE *psPipeline = ( FEED_PIPELINE * )pvPipeline;
+   FEED_PIPELINE_JOB *psJob = &psPipeline->pasJobs[psPipeline->ulJobs++];
+
+   psJob->ulRequest = ulRequest;
+   psJob->eResult = eResult;
+   // The buffer is kept until the feed is merged
+   psJob->sBuffer = *psBuffer;
+   memset( psBuffer, 0, sizeof( FEED_BUFFER ) );
+
+   return BoundedQueue_PushWait( &psPipeline->sParseQueue, psJob );
+}
+
+static void *feedPipelineParse( void *pvPipeline )
+{
+   FEED_PIPELINE *psPipeline = ( FEED_PIPELINE * )pvPipeline;
+   FEED_PIPELINE_JOB *psJob = _null_;
+
+   while( BoundedQueue_PopWait( &psPipeline->sParseQueue, ( void ** )&psJob ) == NO_ERROR )
+   {
+      // Feeds which couldn't be downloaded, or haven't changed, go straight through
+      if( !ISERROR( psJob->eResult ) )
+      {
+         psJob->eResult = Database_ParseFeed( psJob->sBuffer.pcData, psJob->sBuffer.ulSize, psPipeline->ulMaxPosts, &psJob->sFeed );
+      }
+      BoundedQueue_PushWait( &psPipeline->sMergeQueue, psJob );
+   }
+
+   return _null_;
+}
+
+/* 
+   The only thread changing the database while the pipeline runs
+ */
+static void *feedPipelineMerge( void *pvPipeline )
+{
+   FEED_PIPELINE *psPipeline = ( FEED_PIPELINE * )pvPipeline;
+   FEED_PIPELINE_JOB *psJob = _null_;
+
+   Database_BeginBatch( psPipeline->hDatabase );
+   while( BoundedQueue_PopWait( &psPipeline->sMergeQueue, ( void ** )&psJob ) == NO_ERROR )
+   {
+      if( !ISERROR( psJob->eResult ) )
+      {
+         psJob->eResult = Database_MergeFeed( psPipeline->hDatabase, &psJob->sFeed );
+      }
+      if( ISERROR( psJob->eResult ) )
+      {
+         DBG_PRINTF( "Feed [%u] wasn't merged, eRet = [%d]", psJob->ulRequest, psJob->eResult );
+      }
+      FeedBuffer_Free( &psJob->sBuffer );
+      Database_FreeFeed( &psJob->sFeed );
+   }
+   // The merged posts are journaled together, once every feed is in the database
+   psPipeline->eMergeResult = Database_EndBatch( psPipeline->hDatabase );
+
+   return _null_;
+}
+
+static uint32_t feedPipelineWorkers( const FEED_PIPELINE_OPTIONS *psOptions, uint32_t ulCount )
+{
+   uint32_t ulWorkers = psOptions->ulParseWorkers;
+
+   if( ulWorkers == 0 )
+   {
+      long lCores = sysconf( _SC_NPROCESSORS_ONLN );
+
+      ulWorkers = ( lCores > 0 ) ? ( uint32_t )lCores : 1;
+   }
+   // There is no point in more workers than feeds
+   ulWorkers = ( ulWorkers > FEED_PIPELINE_MAX_WORKERS ) ? FEED_PIPELINE_MAX_WORKERS : ulWorkers;
+   ulWorkers = ( ulWorkers > ulCount ) ? ulCount : ulWorkers;
+
+   return ulWorkers;
+}
+
+ERROR_CODE FeedPipeline_Run( DATABASE_HANDLE hDatabase, CURL_SESSION *psSession, const FEED_REQUEST *pasRequests, uint32_t ulCount, const FEED_PIPELINE_OPTIONS *psOptions )
+{
+   const FEED_PIPELINE_OPTIONS sDefaults = { { 0, }, 0, 0, 0 };
+   FEED_PIPELINE sPipeline = { 0, };
+   pthread_t asWorkers[FEED_PIPELINE_MAX_WORKERS];
+   pthread_t sMergeThread;
+   uint32_t ulWorkers = 0;
+   uint32_t ulStarted = 0;
+   uint32_t ulDepth = 0;
+   bool bMergeStarted = false;
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   RETURN_ON_NULL( psSession );
+   RETURN_ON_NULL( pasRequests );
+   UTIL_ASSERT( ( ulCount > 0 ), INVALID_ARG );
+
+   psOptions = psOptions ? psOptions : &sDefaults;
+   ulWorkers = feedPipelineWorkers( psOptions, ulCount );
+   ulDepth = psOptions->ulQueueDepth ? psOptions->ulQueueDepth : FEED_PIPELINE_DEFAULT_DEPTH;
+   sPipeline.hDatabase = hDatabase;
+   sPipeline.ulMaxPosts = psOptions->ulMaxPosts;
+
+   sPipeline.pasJobs = calloc( ulCount, sizeof( FEED_PIPELINE_JOB ) );
+   UTIL_ASSERT( sPipeline.pasJobs, NO_MEMORY );
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      sPipeline.pasJobs[x].sFeed.sPosts.ulRecordSize = sizeof( BLOG_POST );
+   }
+
+   eRet = BoundedQueue_Init( &sPipeline.sParseQueue, ulDepth );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = BoundedQueue_Init( &sPipeline.sMergeQueue, ulDepth );
+   }
+
+   if( !ISERROR( eRet ) )
+   {
+      // libxml2 has to be initialised before several threads use it
+      xmlInitParser();
+      bMergeStarted = ( pthread_create( &sMergeThread, _null_, feedPipelineMerge, &sPipeline ) == 0 );
+      for( ulStarted = 0; ulStarted < ulWorkers; ulStarted++ )
+      {
+         if( pthread_create( &asWorkers[ulStarted], _null_, feedPipelineParse, &sPipeline ) != 0 )
+            break;
+      }
+      // Fewer parse workers than asked for still make a pipeline
+      eRet = ( bMergeStarted && ulStarted > 0 ) ? NO_ERROR : NO_MEMORY;
+   }
+
+   if( !ISERROR( eRet ) )
+   {
+      eRet = DownloadFeeds( psSession, pasRequests, ulCount, &psOptions->sFetch, feedPipelineFetched, &sPipeline );
+   }
+
+   // Every stage drains its queue before the next one is told that nothing else is coming
+   BoundedQueue_Close( &sPipeline.sParseQueue );
+   for( uint32_t x = 0; x < ulStarted; x++ )
+   {
+      pthread_join( asWorkers[x], _null_ );
+   }
+   BoundedQueue_Close( &sPipeline.sMergeQueue );
+   if( bMergeStarted )
+   {
+      pthread_join( sMergeThread, _null_ );
+      eRet = ISERROR( eRet ) ? eRet : sPipeline.eMergeResult;
+   }
+
+   BoundedQueue_Free( &sPipeline.sParseQueue );
+   BoundedQueue_Free( &sPipeline.sMergeQueue );
+   free( sPipeline.pasJobs );
+
+   return eRet;
+}
@@ -0,0 +1,54 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef FEED_PIPELINE_H
+#define FEED_PIPELINE_H
+
+#include "Utils.h"
+#include "CurlWrapper.h"
+#include "Database.h"
+
+// Feeds held between two stages unless told otherwise
+#define FEED_PIPELINE_DEFAULT_DEPTH ( 8 )
+// Most parse workers, whatever the number of cores
+#define FEED_PIPELINE_MAX_WORKERS ( 16 )
+
+/*
+    Settings of FeedPipeline_Run, a zeroed FEED_PIPELINE_OPTIONS uses the defaults
+*/
+typedef struct
+{
+    FEED_FETCH_LIMITS sFetch;
+    // Threads parsing feeds, 0 for one per core
+    uint32_t ulParseWorkers;
+    // Feeds held between two stages, 0 for FEED_PIPELINE_DEFAULT_DEPTH
+    uint32_t ulQueueDepth;
+    // Number of posts looked at per feed, 0 for no limit
+    uint32_t ulMaxPosts;
+} FEED_PIPELINE_OPTIONS;
+
+/*
+    Refreshes the database from several feeds. Each feed goes through three stages, connected by
+    bounded queues so that a feed can be in one stage while the next ones are in the stages before:
+    - fetch: downloads the feeds at once through DownloadFeeds, on the calling thread
+    - parse: a pool of workers parses the downloaded feeds with Database_ParseFeed
+    - merge: a single thread adds the new posts to the database with Database_MergeFeed & frees the feed
+    A full queue holds the stage before it back, down to the downloads which aren't read until there is room
+    The merges are a single database batch, journaled once they are all done
+    The database has to be initialised & mustn't be used by another thread until this returns
+    @param hDatabase[IN]: Database the feeds are merged into
+    @param psSession[IN]: Session the downloads go through
+    @param pasRequests[IN/OUT]: Feeds to be refreshed from, validators are updated as in DownloadFeeds
+    @param ulCount[IN]: Number of feeds
+    @param psOptions[IN]: Optional, NULL uses the defaults
+    @return NO_ERROR: Every feed went through the pipeline, whether it could be downloaded or not
+    @return INVALID_ARG: One or more parameters are invalid
+    @return NO_MEMORY: Pipeline couldn't be set up, nothing is downloaded
+    @return FILE_ERROR: Database couldn't be written, the feeds merged are kept in memory
+    @return Other: As returned by DownloadFeeds
+*/
+ERROR_CODE FeedPipeline_Run( DATABASE_HANDLE hDatabase, CURL_SESSION *psSession, const FEED_REQUEST *pasRequests, uint32_t ulCount, const FEED_PIPELINE_OPTIONS *psOptions );
+
+#endif
@@ -0,0 +1,83 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include <pthread.h>
+#include "Transaction.h"
+#include "config.h"
+
+// Static variables
+// Guards the transaction's owner & depth
+static pthread_mutex_t s_sTransactionLock = PTHREAD_MUTEX_INITIALIZER;
+// Thread which started the outermost transaction
+static pthread_t s_sTransactionOwner;
+// Number of Transaction_Begin calls which haven't been committed yet
+static uint32_t s_ulTransactionDepth = 0;
+
+// Static Functions
+static bool transactionIsOwner( void );
+
+/* 
+   Whether the calling thread holds the open transaction
+ */
+static bool transactionIsOwner( void )
+{
+   bool bOwner = false;
+
+   pthread_mutex_lock( &s_sTransactionLock );
+   bOwner = ( s_ulTransactionDepth > 0 && pthread_equal( s_sTransactionOwner, pthread_self() ) );
+   pthread_mutex_unlock( &s_sTransactionLock );
+
+   return bOwner;
+}
+
+ERROR_CODE Transaction_Begin( DATABASE_HANDLE hDatabase )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+
+   pthread_mutex_lock( &s_sTransactionLock );
+   if( s_ulTransactionDepth == 0 )
+   {
+      s_sTransactionOwner = pthread_self();
+      Config_DeferWrites( true );
+   }
+   else if( !pthread_equal( s_sTransactionOwner, pthread_self() ) )
+   {
+      eRet = INVALID_ARG;
+   }
+   if( !ISERROR( eRet ) )
+   {
+      s_ulTransactionDepth++;
+   }
+   pthread_mutex_unlock( &s_sTransactionLock );
+   RETURN_ON_FAIL( eRet );
+
+   Database_BeginBatch( hDatabase );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE Transaction_Commit( DATABASE_HANDLE hDatabase )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( hDatabase );
+   // No other thread can begin or commit while the owner's transaction is open
+   UTIL_ASSERT( transactionIsOwner(), INVALID_ARG );
+
+   eRet = Database_EndBatch( hDatabase );
+
+   // A thread waiting to start a transaction only does so once the config is written
+   pthread_mutex_lock( &s_sTransactionLock );
+   if( --s_ulTransactionDepth == 0 )
+   {
+      Config_DeferWrites( false );
+      eRet = ISERROR( eRet ) ? eRet : Config_Flush();
+   }
+   pthread_mutex_unlock( &s_sTransactionLock );
+
+   return eRet;
+}
@@ -0,0 +1,35 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include "Utils.h"
+#include "Database.h"
+
+/*
+    Starts a transaction over the config & the database, e.g. for a whole run of the bot
+    Changes made until Transaction_Commit are kept in memory, so that every file is written once
+    per transaction instead of once per change. Transactions can be nested, over the same database
+    The config is shared by the whole process, so is the transaction: once started, only the thread
+    which started it can begin or commit a transaction until the outermost one is committed
+    @param: hDatabase = Database the transaction is over, along with the config
+    @return: NO_ERROR = Success
+    @return: INVALID_ARG = hDatabase is NULL, or another thread's transaction is still open
+*/
+ERROR_CODE Transaction_Begin( DATABASE_HANDLE hDatabase );
+
+/*
+    Ends a transaction, the outermost one writes every change made since it started:
+    the database's changes with a single journal write, then the config file once
+    The config is only written once the database is, so that the config never gets ahead of it
+    @param: hDatabase = Database the transaction was started over
+    @return: NO_ERROR = Success, or an inner transaction ended
+    @return: INVALID_ARG = No transaction has been started by the calling thread
+    @return: FILE_ERROR = Database or config couldn't be written
+*/
+ERROR_CODE Transaction_Commit( DATABASE_HANDLE hDatabase );
+
+#endif
@@ -0,0 +1,202 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include "BoundedQueue.h"
+
+// Largest capacity, positions are compared as signed numbers
+#define BOUNDED_QUEUE_MAX_CAPACITY ( 1u << 30 )
+// Tries spent spinning & then yielding before a waiting thread sleeps
+#define BOUNDED_QUEUE_SPINS ( 64 )
+#define BOUNDED_QUEUE_YIELDS ( 128 )
+// Longest sleep of a waiting thread
+#define BOUNDED_QUEUE_MAX_SLEEP_NS ( 1000 * 1000 )
+
+// Static Functions
+static void boundedQueueBackoff( uint32_t * pulTries );
+
+/*
+    Waits a little longer every try: spins first as the other side is usually just about done,
+    then gives the core away & finally sleeps so that a stalled stage doesn't burn a core
+ */
+static void boundedQueueBackoff( uint32_t * pulTries )
+{
+   uint32_t ulTries = ( *pulTries )++;
+
+   if( ulTries < BOUNDED_QUEUE_SPINS )
+   {
+      __asm__ __volatile__( "" ::: "memory" );
+   }
+   else if( ulTries < BOUNDED_QUEUE_YIELDS )
+   {
+      sched_yield();
+   }
+   else
+   {
+      uint32_t ulShift = ulTries - BOUNDED_QUEUE_YIELDS;
+      struct timespec sSleep = { 0, BOUNDED_QUEUE_MAX_SLEEP_NS };
+
+      // 1us, doubled every try up to BOUNDED_QUEUE_MAX_SLEEP_NS
+      if( ulShift < 10 )
+      {
+         sSleep.tv_nsec = 1000L << ulShift;
+      }
+      nanosleep( &sSleep, _null_ );
+   }
+}
+
+ERROR_CODE BoundedQueue_Init( BOUNDED_QUEUE * psQueue, uint32_t ulCapacity )
+{
+   uint32_t ulSize = 1;
+
+   RETURN_ON_NULL( psQueue );
+   UTIL_ASSERT( ( ulCapacity > 0 && ulCapacity <= BOUNDED_QUEUE_MAX_CAPACITY ), INVALID_ARG );
+
+   while( ulSize < ulCapacity )
+   {
+      ulSize <<= 1;
+   }
+
+   memset( psQueue, 0, sizeof( BOUNDED_QUEUE ) );
+   psQueue->pasCells = malloc( ulSize * sizeof( BOUNDED_QUEUE_CELL ) );
+   UTIL_ASSERT( psQueue->pasCells, NO_MEMORY );
+
+   // A cell is free for the position equal to its sequence
+   for( uint32_t x = 0; x < ulSize; x++ )
+   {
+      psQueue->pasCells[x].ullSequence = x;
+      psQueue->pasCells[x].pvItem = _null_;
+   }
+   psQueue->ulMask = ulSize - 1;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE BoundedQueue_Push( BOUNDED_QUEUE * psQueue, void * pvItem )
+{
+   BOUNDED_QUEUE_CELL * psCell = _null_;
+   uint64_t ullPosition = 0;
+
+   RETURN_ON_NULL( psQueue );
+   UTIL_ASSERT( ( __atomic_load_n( &psQueue->ulClosed, __ATOMIC_RELAXED ) == 0 ), INVALID_ARG );
+
+   ullPosition = __atomic_load_n( &psQueue->ullTail, __ATOMIC_RELAXED );
+   for( ;; )
+   {
+      int64_t llDiff = 0;
+
+      psCell = &psQueue->pasCells[ullPosition & psQueue->ulMask];
+      llDiff = ( int64_t )( __atomic_load_n( &psCell->ullSequence, __ATOMIC_ACQUIRE ) - ullPosition );
+      if( llDiff == 0 )
+      {
+         // The cell is free, claim the position. A failed claim reloads ullPosition
+         if( __atomic_compare_exchange_n( &psQueue->ullTail, &ullPosition, ullPosition + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            break;
+      }
+      else if( llDiff < 0 )
+      {
+         // The cell still holds the item pushed a lap ago
+         return OVERFLOW;
+      }
+      else
+      {
+         // Another producer has claimed the position
+         ullPosition = __atomic_load_n( &psQueue->ullTail, __ATOMIC_RELAXED );
+      }
+   }
+
+   psCell->pvItem = pvItem;
+   // Hands the cell over to the consumer of this position
+   __atomic_store_n( &psCell->ullSequence, ullPosition + 1, __ATOMIC_RELEASE );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE BoundedQueue_PushWait( BOUNDED_QUEUE * psQueue, void * pvItem )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   uint32_t ulTries = 0;
+
+   while( ( eRet = BoundedQueue_Push( psQueue, pvItem ) ) == OVERFLOW )
+   {
+      boundedQueueBackoff( &ulTries );
+   }
+
+   return eRet;
+}
+
+ERROR_CODE BoundedQueue_Pop( BOUNDED_QUEUE * psQueue, void ** ppvItem )
+{
+   BOUNDED_QUEUE_CELL * psCell = _null_;
+   uint64_t ullPosition = 0;
+   bool bClosed = false;
+
+   RETURN_ON_NULL( psQueue );
+   RETURN_ON_NULL( ppvItem );
+
+   // Read before looking at the cells, every item pushed before the queue was closed is visible then
+   bClosed = ( __atomic_load_n( &psQueue->ulClosed, __ATOMIC_ACQUIRE ) != 0 );
+   ullPosition = __atomic_load_n( &psQueue->ullHead, __ATOMIC_RELAXED );
+   for( ;; )
+   {
+      int64_t llDiff = 0;
+
+      psCell = &psQueue->pasCells[ullPosition & psQueue->ulMask];
+      llDiff = ( int64_t )( __atomic_load_n( &psCell->ullSequence, __ATOMIC_ACQUIRE ) - ( ullPosition + 1 ) );
+      if( llDiff == 0 )
+      {
+         if( __atomic_compare_exchange_n( &psQueue->ullHead, &ullPosition, ullPosition + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            break;
+      }
+      else if( llDiff < 0 )
+      {
+         // Nothing has been pushed to this position yet
+         return bClosed ? STOPPED : NOT_FOUND;
+      }
+      else
+      {
+         ullPosition = __atomic_load_n( &psQueue->ullHead, __ATOMIC_RELAXED );
+      }
+   }
+
+   *ppvItem = psCell->pvItem;
+   // Frees the cell for the producer of the next lap
+   __atomic_store_n( &psCell->ullSequence, ullPosition + psQueue->ulMask + 1, __ATOMIC_RELEASE );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE BoundedQueue_PopWait( BOUNDED_QUEUE * psQueue, void ** ppvItem )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   uint32_t ulTries = 0;
+
+   while( ( eRet = BoundedQueue_Pop( psQueue, ppvItem ) ) == NOT_FOUND )
+   {
+      boundedQueueBackoff( &ulTries );
+   }
+
+   return eRet;
+}
+
+void BoundedQueue_Close( BOUNDED_QUEUE * psQueue )
+{
+   if( psQueue )
+   {
+      __atomic_store_n( &psQueue->ulClosed, 1, __ATOMIC_RELEASE );
+   }
+}
+
+void BoundedQueue_Free( BOUNDED_QUEUE * psQueue )
+{
+   if( psQueue )
+   {
+      free( psQueue->pasCells );
+      psQueue->pasCells = _null_;
+      psQueue->ulMask = 0;
+   }
+}
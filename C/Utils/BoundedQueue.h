@@ -0,0 +1,102 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <stdbool.h>
+#include "Utils.h"
+
+// Cache line, the positions of producers & consumers are kept on lines of their own
+#define BOUNDED_QUEUE_LINE ( 64 )
+
+/*
+    Slot of a BOUNDED_QUEUE, its sequence tells whether it is free or holds an item for a position
+ */
+typedef struct
+{
+    uint64_t ullSequence;
+    void * pvItem;
+} BOUNDED_QUEUE_CELL;
+
+/*
+    Fixed size FIFO of pointers which any number of threads can push to & pop from without a lock
+    A full queue refuses items, which lets a fast stage be held back by a slower one
+    Initialise it with BoundedQueue_Init, it mustn't be moved or copied afterwards
+ */
+typedef struct
+{
+    BOUNDED_QUEUE_CELL * pasCells;
+    uint32_t ulMask;
+    // Next position pushed to
+    uint64_t ullTail __attribute__( ( aligned( BOUNDED_QUEUE_LINE ) ) );
+    // Next position popped from
+    uint64_t ullHead __attribute__( ( aligned( BOUNDED_QUEUE_LINE ) ) );
+    // Set once nothing else is pushed
+    uint32_t ulClosed __attribute__( ( aligned( BOUNDED_QUEUE_LINE ) ) );
+} BOUNDED_QUEUE;
+
+/*
+    Allocates the queue, it starts empty
+    @param psQueue[OUT]: Queue
+    @param ulCapacity[IN]: Items the queue holds, rounded up to a power of two
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Capacity is 0 or too large
+    @return NO_MEMORY: Queue couldn't be allocated
+ */
+ERROR_CODE BoundedQueue_Init( BOUNDED_QUEUE * psQueue, uint32_t ulCapacity );
+
+/*
+    Adds an item at the end of the queue
+    @param psQueue[IN/OUT]: Queue
+    @param pvItem[IN]: Item, owned by whoever pops it
+    @return NO_ERROR: Success
+    @return OVERFLOW: Queue is full
+    @return INVALID_ARG: Queue has been closed
+ */
+ERROR_CODE BoundedQueue_Push( BOUNDED_QUEUE * psQueue, void * pvItem );
+
+/*
+    Same as BoundedQueue_Push, waits for room while the queue is full
+    @param psQueue[IN/OUT]: Queue
+    @param pvItem[IN]: Item, owned by whoever pops it
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Queue has been closed
+ */
+ERROR_CODE BoundedQueue_PushWait( BOUNDED_QUEUE * psQueue, void * pvItem );
+
+/*
+    Removes the first item of the queue
+    @param psQueue[IN/OUT]: Queue
+    @param ppvItem[OUT]: Item
+    @return NO_ERROR: Success
+    @return NOT_FOUND: Queue is empty
+    @return STOPPED: Queue is empty & has been closed, nothing will be pushed anymore
+ */
+ERROR_CODE BoundedQueue_Pop( BOUNDED_QUEUE * psQueue, void ** ppvItem );
+
+/*
+    Same as BoundedQueue_Pop, waits for an item while the queue is empty
+    @param psQueue[IN/OUT]: Queue
+    @param ppvItem[OUT]: Item
+    @return NO_ERROR: Success
+    @return STOPPED: Queue is empty & has been closed
+ */
+ERROR_CODE BoundedQueue_PopWait( BOUNDED_QUEUE * psQueue, void ** ppvItem );
+
+/*
+    Tells the consumers that nothing else is pushed, the items still in the queue can be popped
+    Only call it once every producer has pushed its last item
+    @param psQueue[IN/OUT]: Queue
+ */
+void BoundedQueue_Close( BOUNDED_QUEUE * psQueue );
+
+/*
+    Frees the queue, items still in it aren't freed
+    @param psQueue[IN/OUT]: Queue, can be zeroed
+ */
+void BoundedQueue_Free( BOUNDED_QUEUE * psQueue );
+
+#endif
@@ -0,0 +1,184 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include "BucketQueue.h"
+
+// Defines
+#define BUCKET_QUEUE_NONE ( UINT32_MAX )
+
+// Static Functions
+static BUCKET_QUEUE_NODE * bucketQueueNode( const BUCKET_QUEUE * psQueue, uint32_t ulValue );
+static void bucketQueueLink( BUCKET_QUEUE * psQueue, uint32_t ulValue, uint32_t ulBucket );
+static void bucketQueueUnlink( BUCKET_QUEUE * psQueue, uint32_t ulValue );
+
+/*
+    Node of a value which is in the queue, NULL otherwise
+ */
+static BUCKET_QUEUE_NODE * bucketQueueNode( const BUCKET_QUEUE * psQueue, uint32_t ulValue )
+{
+   BUCKET_QUEUE_NODE * psNode = RecordArray_Get( &psQueue->sNodes, ulValue );
+
+   return ( psNode && psNode->ulBucket != BUCKET_QUEUE_NONE ) ? psNode : _null_;
+}
+
+/*
+    Values usually arrive in ascending order, so the bucket is walked from its tail
+ */
+static void bucketQueueLink( BUCKET_QUEUE * psQueue, uint32_t ulValue, uint32_t ulBucket )
+{
+   BUCKET_QUEUE_NODE * psNode = RecordArray_Get( &psQueue->sNodes, ulValue );
+   uint32_t ulPrev = BUCKET_QUEUE_NONE;
+
+   ulBucket = ( ulBucket < psQueue->ulBuckets ) ? ulBucket : psQueue->ulBuckets - 1;
+   ulPrev = psQueue->paulTails[ulBucket];
+   while( ulPrev != BUCKET_QUEUE_NONE && ulPrev > ulValue )
+   {
+      ulPrev = bucketQueueNode( psQueue, ulPrev )->ulPrev;
+   }
+
+   psNode->ulBucket = ulBucket;
+   psNode->ulPrev = ulPrev;
+   if( ulPrev == BUCKET_QUEUE_NONE )
+   {
+      psNode->ulNext = psQueue->paulHeads[ulBucket];
+      psQueue->paulHeads[ulBucket] = ulValue;
+   }
+   else
+   {
+      BUCKET_QUEUE_NODE * psPrev = bucketQueueNode( psQueue, ulPrev );
+
+      psNode->ulNext = psPrev->ulNext;
+      psPrev->ulNext = ulValue;
+   }
+
+   if( psNode->ulNext == BUCKET_QUEUE_NONE )
+   {
+      psQueue->paulTails[ulBucket] = ulValue;
+   }
+   else
+   {
+      bucketQueueNode( psQueue, psNode->ulNext )->ulPrev = ulValue;
+   }
+}
+
+static void bucketQueueUnlink( BUCKET_QUEUE * psQueue, uint32_t ulValue )
+{
+   BUCKET_QUEUE_NODE * psNode = bucketQueueNode( psQueue, ulValue );
+
+   if( psNode->ulPrev == BUCKET_QUEUE_NONE )
+   {
+      psQueue->paulHeads[psNode->ulBucket] = psNode->ulNext;
+   }
+   else
+   {
+      bucketQueueNode( psQueue, psNode->ulPrev )->ulNext = psNode->ulNext;
+   }
+
+   if( psNode->ulNext == BUCKET_QUEUE_NONE )
+   {
+      psQueue->paulTails[psNode->ulBucket] = psNode->ulPrev;
+   }
+   else
+   {
+      bucketQueueNode( psQueue, psNode->ulNext )->ulPrev = psNode->ulPrev;
+   }
+
+   psNode->ulBucket = BUCKET_QUEUE_NONE;
+}
+
+ERROR_CODE BucketQueue_Init( BUCKET_QUEUE * psQueue, uint32_t ulBuckets )
+{
+   RETURN_ON_NULL( psQueue );
+   UTIL_ASSERT( ulBuckets != 0, INVALID_ARG );
+   memset( psQueue, 0, sizeof( BUCKET_QUEUE ) );
+
+   psQueue->sNodes.ulRecordSize = sizeof( BUCKET_QUEUE_NODE );
+   psQueue->paulHeads = malloc( ulBuckets * sizeof( uint32_t ) );
+   psQueue->paulTails = malloc( ulBuckets * sizeof( uint32_t ) );
+   if( !psQueue->paulHeads || !psQueue->paulTails )
+   {
+      BucketQueue_Free( psQueue );
+      return NO_MEMORY;
+   }
+   psQueue->ulBuckets = ulBuckets;
+   BucketQueue_Clear( psQueue );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE BucketQueue_Add( BUCKET_QUEUE * psQueue, uint32_t ulValue, uint32_t ulBucket )
+{
+   RETURN_ON_NULL( psQueue );
+   RETURN_ON_NULL( psQueue->paulHeads );
+   UTIL_ASSERT( ( ulValue != BUCKET_QUEUE_NONE ), INVALID_ARG );
+   UTIL_ASSERT( ( bucketQueueNode( psQueue, ulValue ) == _null_ ), INVALID_ARG );
+
+   RETURN_ON_FAIL( RecordArray_Reserve( &psQueue->sNodes, ulValue + 1 ) );
+   // Values which have been skipped are out of the queue
+   while( psQueue->sNodes.ulCount <= ulValue )
+   {
+      BUCKET_QUEUE_NODE sNode = { BUCKET_QUEUE_NONE, BUCKET_QUEUE_NONE, BUCKET_QUEUE_NONE };
+
+      // Can't fail, there is enough room
+      RecordArray_Append( &psQueue->sNodes, &sNode, _null_ );
+   }
+
+   bucketQueueLink( psQueue, ulValue, ulBucket );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE BucketQueue_Move( BUCKET_QUEUE * psQueue, uint32_t ulValue, uint32_t ulBucket )
+{
+   RETURN_ON_NULL( psQueue );
+   UTIL_ASSERT( bucketQueueNode( psQueue, ulValue ), NOT_FOUND );
+
+   bucketQueueUnlink( psQueue, ulValue );
+   bucketQueueLink( psQueue, ulValue, ulBucket );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE BucketQueue_First( const BUCKET_QUEUE * psQueue, uint32_t * pulValue )
+{
+   RETURN_ON_NULL( psQueue );
+   RETURN_ON_NULL( pulValue );
+
+   // The number of buckets is small & fixed, so this doesn't depend on the number of values
+   for( uint32_t ulBucket = 0; ulBucket < psQueue->ulBuckets; ulBucket++ )
+   {
+      if( psQueue->paulHeads[ulBucket] != BUCKET_QUEUE_NONE )
+      {
+         *pulValue = psQueue->paulHeads[ulBucket];
+         return NO_ERROR;
+      }
+   }
+
+   return NOT_FOUND;
+}
+
+void BucketQueue_Clear( BUCKET_QUEUE * psQueue )
+{
+   if( psQueue && psQueue->paulHeads )
+   {
+      for( uint32_t ulBucket = 0; ulBucket < psQueue->ulBuckets; ulBucket++ )
+      {
+         psQueue->paulHeads[ulBucket] = BUCKET_QUEUE_NONE;
+         psQueue->paulTails[ulBucket] = BUCKET_QUEUE_NONE;
+      }
+      RecordArray_Clear( &psQueue->sNodes );
+   }
+}
+
+void BucketQueue_Free( BUCKET_QUEUE * psQueue )
+{
+   if( psQueue )
+   {
+      RecordArray_Free( &psQueue->sNodes );
+      free( psQueue->paulHeads );
+      free( psQueue->paulTails );
+      memset( psQueue, 0, sizeof( BUCKET_QUEUE ) );
+   }
+}
@@ -0,0 +1,89 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef BUCKET_QUEUE_H
+#define BUCKET_QUEUE_H
+
+#include <stdbool.h>
+#include "Utils.h"
+#include "RecordArray.h"
+
+/*
+    Priority queue for a small, bounded range of priorities e.g. a share count
+    Values are dense ids ( 0, 1, 2... ), each one sits in a single bucket at a time
+    Within a bucket, values are kept in ascending order so that the first value is the smallest one
+    Initialise it with BucketQueue_Init, BUCKET_QUEUE_NODEs are internal
+ */
+typedef struct
+{
+    uint32_t ulPrev;
+    uint32_t ulNext;
+    uint32_t ulBucket;
+} BUCKET_QUEUE_NODE;
+
+typedef struct
+{
+    // BUCKET_QUEUE_NODE per value, indexed by the value
+    RECORD_ARRAY sNodes;
+    // First & last value of every bucket
+    uint32_t * paulHeads;
+    uint32_t * paulTails;
+    uint32_t ulBuckets;
+} BUCKET_QUEUE;
+
+/*
+    Allocates the buckets, the queue starts empty
+    @param psQueue[OUT]: Queue
+    @param ulBuckets[IN]: Number of buckets, i.e. priorities go from 0 to ulBuckets - 1
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Buckets couldn't be allocated
+ */
+ERROR_CODE BucketQueue_Init( BUCKET_QUEUE * psQueue, uint32_t ulBuckets );
+
+/*
+    Adds a value to a bucket
+    O(1) when the value is larger than the ones already in the bucket, e.g. values added in order
+    @param psQueue[IN/OUT]: Queue
+    @param ulValue[IN]: Value, mustn't be in the queue already
+    @param ulBucket[IN]: Bucket, priorities past the last bucket go in the last one
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Value is already in the queue
+    @return NO_MEMORY: Queue couldn't be grown
+ */
+ERROR_CODE BucketQueue_Add( BUCKET_QUEUE * psQueue, uint32_t ulValue, uint32_t ulBucket );
+
+/*
+    Moves a value to another bucket
+    O(1) when the value is larger than the ones already in the new bucket
+    @param psQueue[IN/OUT]: Queue
+    @param ulValue[IN]: Value in the queue
+    @param ulBucket[IN]: New bucket, priorities past the last bucket go in the last one
+    @return NO_ERROR: Success
+    @return NOT_FOUND: Value isn't in the queue
+ */
+ERROR_CODE BucketQueue_Move( BUCKET_QUEUE * psQueue, uint32_t ulValue, uint32_t ulBucket );
+
+/*
+    Gets the smallest value of the lowest bucket which isn't empty, the value stays in the queue
+    @param psQueue[IN]: Queue
+    @param pulValue[OUT]: Value found
+    @return NO_ERROR: Success
+    @return NOT_FOUND: Queue is empty
+ */
+ERROR_CODE BucketQueue_First( const BUCKET_QUEUE * psQueue, uint32_t * pulValue );
+
+/*
+    Removes every value, the memory is kept for reuse
+    @param psQueue[IN/OUT]: Queue
+ */
+void BucketQueue_Clear( BUCKET_QUEUE * psQueue );
+
+/*
+    Frees the queue, it has to be initialised again before it is reused
+    @param psQueue[IN/OUT]: Queue
+ */
+void BucketQueue_Free( BUCKET_QUEUE * psQueue );
+
+#endif
@@ -3,10 +3,36 @@
     Created: Feb 2020
 */
 #include <curl/curl.h>
+#include <strings.h>
 #include "CurlWrapper.h"
 
+// Defines
+#define FEED_BUFFER_INITIAL_SIZE ( 64 * 1024 )
+#define HTTP_NOT_MODIFIED        ( 304 )
+#define FEED_FETCH_POLL_MS       ( 1000 )
+
+// Typedefs
+// Same as curl_write_callback, with the buffer as a void pointer like the sinks below
+typedef size_t ( *RSS_WRITE_CALLBACK )( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream );
+
 // Static Functions
 static size_t writeStreamToFile( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream );
+static size_t writeStreamToBuffer( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream );
+static size_t writeStreamToCallback( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream );
+static size_t writeDecodedStream( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream );
+static size_t readValidatorHeader( char * pcBuffer, size_t iSize, size_t iNItems, void * pvValidators );
+static ERROR_CODE performDownload( CURL_SESSION * psSession, const char * pszURL, FEED_VALIDATORS * psValidators, RSS_WRITE_CALLBACK pfnWrite, void * pvWriteData );
+static char * feedHost( const char * pszURL );
+static void * archiveThread( void * pvArchive );
+static void curlGlobalInit( void );
+static void sessionLock( CURL * psCurl, curl_lock_data eData, curl_lock_access eAccess, void * pvSession );
+static void sessionUnlock( CURL * psCurl, curl_lock_data eData, void * pvSession );
+static CURL * sessionAcquire( CURL_SESSION * psSession );
+static void sessionRelease( CURL_SESSION * psSession, CURL * psCurl );
+
+// Curl is initialised once per process, by the first session
+static pthread_once_t sCurlOnce = PTHREAD_ONCE_INIT;
+static CURLcode eCurlInit = CURLE_FAILED_INIT;
 
 typedef struct
 {
@@ -14,6 +40,55 @@ typedef struct
     FILE * psStream;
 } RSS_FILE_STREAM;
 
+typedef struct
+{
+    FEED_CHUNK_CALLBACK pfnOnChunk;
+    void * pvUserData;
+    // Error returned by pfnOnChunk, curl only reports a write error
+    ERROR_CODE eError;
+} RSS_CALLBACK_STREAM;
+
+/*
+    Sits in front of the caller's write callback & counts the bytes once decoded
+ */
+typedef struct
+{
+    RSS_WRITE_CALLBACK pfnWrite;
+    void * pvWriteData;
+    curl_off_t llDecodedSize;
+} RSS_DECODED_STREAM;
+
+/*
+    A download, from the set up of its easy handle to its result
+    Curl writes into it while the download runs, it mustn't move in the meantime
+ */
+typedef struct
+{
+    CURL * psCurl;
+    struct curl_slist * psHeaders;
+    const char * pszURL;
+    // Validators to send & update, NULL for an unconditional download
+    FEED_VALIDATORS * psValidators;
+    FEED_VALIDATORS sReceived;
+    RSS_DECODED_STREAM sDecoded;
+} RSS_TRANSFER;
+
+/*
+    A feed of DownloadFeeds
+ */
+typedef struct
+{
+    RSS_TRANSFER sTransfer;
+    FEED_BUFFER sBuffer;
+    // Used for the per host limit, NULL if the URL couldn't be parsed
+    char * pszHost;
+    bool bStarted;
+} RSS_FEED_FETCH;
+
+static void transferSetup( RSS_TRANSFER * psTransfer, const char * pszURL, FEED_VALIDATORS * psValidators, RSS_WRITE_CALLBACK pfnWrite, void * pvWriteData );
+static ERROR_CODE transferFinish( RSS_TRANSFER * psTransfer, CURL_SESSION * psSession, CURLcode resCode );
+static uint32_t feedHostTransfers( const RSS_FEED_FETCH * pasFetches, const uint32_t * paulRunning, uint32_t ulRunning, const char * pszHost );
+
 static size_t writeStreamToFile( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream )
 {
     RSS_FILE_STREAM * psOutStream = ( RSS_FILE_STREAM * )pvStream;
@@ -27,11 +102,347 @@ static size_t writeStreamToFile( void * pvBuffer, size_t iSize, size_t iNMemb, v
     return fwrite( pvBuffer, iSize, iNMemb, psOutStream->psStream );
 }
 
+static size_t writeStreamToBuffer( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream )
+{
+    size_t ulLength = iSize * iNMemb;
+
+    if( ISERROR( FeedBuffer_Append( ( FEED_BUFFER * )pvStream, pvBuffer, ulLength ) ) )
+        return 0; /* failure, curl aborts the transfer */
+
+    return ulLength;
+}
+
+static size_t writeStreamToCallback( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream )
+{
+    RSS_CALLBACK_STREAM * psStream = ( RSS_CALLBACK_STREAM * )pvStream;
+    size_t ulLength = iSize * iNMemb;
+
+    psStream->eError = psStream->pfnOnChunk( pvBuffer, ulLength, psStream->pvUserData );
+    if( ISERROR( psStream->eError ) )
+        return 0; /* failure, curl aborts the transfer */
+
+    return ulLength;
+}
+
+static size_t writeDecodedStream( void * pvBuffer, size_t iSize, size_t iNMemb, void * pvStream )
+{
+    RSS_DECODED_STREAM * psStream = ( RSS_DECODED_STREAM * )pvStream;
+    size_t ulWritten = psStream->pfnWrite( pvBuffer, iSize, iNMemb, psStream->pvWriteData );
+
+    psStream->llDecodedSize += ( curl_off_t )ulWritten;
+
+    return ulWritten;
+}
+
+/*
+    Picks the ETag out of the response headers, Last-Modified is parsed by curl
+ */
+static size_t readValidatorHeader( char * pcBuffer, size_t iSize, size_t iNItems, void * pvValidators )
+{
+    FEED_VALIDATORS * psReceived = ( FEED_VALIDATORS * )pvValidators;
+    size_t ulLength = iSize * iNItems;
+
+    // Every response of a redirect has its own headers, only those of the last one count
+    if( ulLength >= 5 && strncmp( pcBuffer, "HTTP/", 5 ) == 0 )
+    {
+        memset( psReceived->szETag, 0, sizeof( psReceived->szETag ) );
+    }
+    else if( ulLength > 5 && strncasecmp( pcBuffer, "ETag:", 5 ) == 0 )
+    {
+        const char * pcValue = pcBuffer + 5;
+        size_t ulValue = ulLength - 5;
+
+        for( ; ulValue > 0 && ( *pcValue == ' ' || *pcValue == '\t' ); pcValue++, ulValue-- );
+        for( ; ulValue > 0 && strchr( " \t\r\n", pcValue[ulValue - 1] ); ulValue-- );
+
+        // A truncated ETag would never match, it is better not to send one
+        if( ulValue < sizeof( psReceived->szETag ) )
+        {
+            memcpy( psReceived->szETag, pcValue, ulValue );
+            psReceived->szETag[ulValue] = '\0';
+        }
+    }
+
+    return ulLength;
+}
+
+static void curlGlobalInit( void )
+{
+    eCurlInit = curl_global_init( CURL_GLOBAL_ALL );
+    if( eCurlInit == CURLE_OK )
+    {
+        atexit( curl_global_cleanup );
+    }
+}
+
+static void sessionLock( CURL * psCurl, curl_lock_data eData, curl_lock_access eAccess, void * pvSession )
+{
+    ( void )psCurl;
+    ( void )eAccess;
+    pthread_mutex_lock( &( ( CURL_SESSION * )pvSession )->asShareLocks[eData] );
+}
+
+static void sessionUnlock( CURL * psCurl, curl_lock_data eData, void * pvSession )
+{
+    ( void )psCurl;
+    pthread_mutex_unlock( &( ( CURL_SESSION * )pvSession )->asShareLocks[eData] );
+}
+
+/*
+    Gets an easy handle attached to the session's share, an idle one if there is any
+ */
+static CURL * sessionAcquire( CURL_SESSION * psSession )
+{
+    CURL * psCurl = _null_;
+
+    pthread_mutex_lock( &psSession->sPoolLock );
+    if( psSession->ulHandles > 0 )
+    {
+        psCurl = psSession->apsHandles[--psSession->ulHandles];
+    }
+    pthread_mutex_unlock( &psSession->sPoolLock );
+
+    if( psCurl )
+    {
+        // Options of the last download are dropped, the share keeps the connections
+        curl_easy_reset( psCurl );
+    }
+    else
+    {
+        psCurl = curl_easy_init();
+    }
+    if( psCurl )
+    {
+        curl_easy_setopt( psCurl, CURLOPT_SHARE, psSession->psShare );
+    }
+
+    return psCurl;
+}
+
+static void sessionRelease( CURL_SESSION * psSession, CURL * psCurl )
+{
+    pthread_mutex_lock( &psSession->sPoolLock );
+    if( psSession->ulHandles < ARRAY_COUNT( psSession->apsHandles ) )
+    {
+        psSession->apsHandles[psSession->ulHandles++] = psCurl;
+        psCurl = _null_;
+    }
+    pthread_mutex_unlock( &psSession->sPoolLock );
 
-ERROR_CODE DownloadFeedFile( const char * pszURL, const char *pszFilename )
+    // The pool is full
+    if( psCurl )
+    {
+        curl_easy_cleanup( psCurl );
+    }
+}
+
+ERROR_CODE CurlSession_Init( CURL_SESSION * psSession )
+{
+    RETURN_ON_NULL( psSession );
+    memset( psSession, 0, sizeof( CURL_SESSION ) );
+
+    pthread_once( &sCurlOnce, curlGlobalInit );
+    UTIL_ASSERT( ( eCurlInit == CURLE_OK ), NETWORK_ERROR );
+
+    psSession->psShare = curl_share_init();
+    UTIL_ASSERT( psSession->psShare, NETWORK_ERROR );
+
+    for( uint32_t x = 0; x < ARRAY_COUNT( psSession->asShareLocks ); x++ )
+    {
+        pthread_mutex_init( &psSession->asShareLocks[x], _null_ );
+    }
+    pthread_mutex_init( &psSession->sPoolLock, _null_ );
+
+    curl_share_setopt( psSession->psShare, CURLSHOPT_LOCKFUNC, sessionLock );
+    curl_share_setopt( psSession->psShare, CURLSHOPT_UNLOCKFUNC, sessionUnlock );
+    curl_share_setopt( psSession->psShare, CURLSHOPT_USERDATA, psSession );
+    curl_share_setopt( psSession->psShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+    curl_share_setopt( psSession->psShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT );
+    curl_share_setopt( psSession->psShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+
+    return NO_ERROR;
+}
+
+void CurlSession_Free( CURL_SESSION * psSession )
+{
+    if( psSession && psSession->psShare )
+    {
+        for( uint32_t x = 0; x < psSession->ulHandles; x++ )
+        {
+            curl_easy_cleanup( psSession->apsHandles[x] );
+        }
+        // Closes the connections kept in the share
+        curl_share_cleanup( psSession->psShare );
+
+        for( uint32_t x = 0; x < ARRAY_COUNT( psSession->asShareLocks ); x++ )
+        {
+            pthread_mutex_destroy( &psSession->asShareLocks[x] );
+        }
+        pthread_mutex_destroy( &psSession->sPoolLock );
+        memset( psSession, 0, sizeof( CURL_SESSION ) );
+    }
+}
+
+/*
+    Sets up a transfer on an easy handle of the session, the handle is left to be performed
+ */
+static void transferSetup( RSS_TRANSFER * psTransfer, const char * pszURL, FEED_VALIDATORS * psValidators, RSS_WRITE_CALLBACK pfnWrite, void * pvWriteData )
+{
+    CURL * psCurl = psTransfer->psCurl;
+
+    psTransfer->pszURL = pszURL;
+    psTransfer->psValidators = psValidators;
+    psTransfer->sDecoded.pfnWrite = pfnWrite;
+    psTransfer->sDecoded.pvWriteData = pvWriteData;
+
+    curl_easy_setopt( psCurl, CURLOPT_URL, pszURL );
+    curl_easy_setopt( psCurl, CURLOPT_FOLLOWLOCATION, 1 );
+    // Every encoding curl was built with is offered, the sinks only ever see the decoded feed
+    curl_easy_setopt( psCurl, CURLOPT_ACCEPT_ENCODING, "" );
+    curl_easy_setopt( psCurl, CURLOPT_WRITEFUNCTION, writeDecodedStream );
+    curl_easy_setopt( psCurl, CURLOPT_WRITEDATA, &psTransfer->sDecoded );
+    if( psValidators )
+    {
+        // The server answers 304 & no body if the file hasn't changed
+        if( strlen( psValidators->szETag ) > 0 )
+        {
+            char szHeader[sizeof( "If-None-Match: " ) + FEED_ETAG_SIZE] = { 0, };
+
+            snprintf( szHeader, sizeof( szHeader ), "If-None-Match: %s", psValidators->szETag );
+            psTransfer->psHeaders = curl_slist_append( psTransfer->psHeaders, szHeader );
+            curl_easy_setopt( psCurl, CURLOPT_HTTPHEADER, psTransfer->psHeaders );
+        }
+        if( psValidators->tLastModified != 0 )
+        {
+            curl_easy_setopt( psCurl, CURLOPT_TIMECONDITION, ( long )CURL_TIMECOND_IFMODSINCE );
+            curl_easy_setopt( psCurl, CURLOPT_TIMEVALUE_LARGE, ( curl_off_t )psValidators->tLastModified );
+        }
+        curl_easy_setopt( psCurl, CURLOPT_FILETIME, 1L );
+        curl_easy_setopt( psCurl, CURLOPT_HEADERFUNCTION, readValidatorHeader );
+        curl_easy_setopt( psCurl, CURLOPT_HEADERDATA, &psTransfer->sReceived );
+    }
+}
+
+/*
+    Works out how a performed transfer went & updates its validators
+    The easy handle is given back to the session & the transfer can't be used afterwards
+ */
+static ERROR_CODE transferFinish( RSS_TRANSFER * psTransfer, CURL_SESSION * psSession, CURLcode resCode )
+{
+    FEED_VALIDATORS * psValidators = psTransfer->psValidators;
+    long lResponseCode = 0;
+    long lConditionUnmet = 0;
+    long lNewConnections = 0;
+    curl_off_t llFileTime = -1;
+    curl_off_t llRawSize = 0;
+
+    curl_easy_getinfo( psTransfer->psCurl, CURLINFO_RESPONSE_CODE, &lResponseCode );
+    curl_easy_getinfo( psTransfer->psCurl, CURLINFO_CONDITION_UNMET, &lConditionUnmet );
+    curl_easy_getinfo( psTransfer->psCurl, CURLINFO_FILETIME_T, &llFileTime );
+    // Bytes of the body as they came over the network, i.e. still encoded
+    curl_easy_getinfo( psTransfer->psCurl, CURLINFO_SIZE_DOWNLOAD_T, &llRawSize );
+    // 0 when a connection of the session was reused
+    curl_easy_getinfo( psTransfer->psCurl, CURLINFO_NUM_CONNECTS, &lNewConnections );
+    sessionRelease( psSession, psTransfer->psCurl );
+    curl_slist_free_all( psTransfer->psHeaders );
+    psTransfer->psCurl = _null_;
+    psTransfer->psHeaders = _null_;
+
+    DBG_PRINTF( "Downloaded [%" CURL_FORMAT_CURL_OFF_T "] bytes, [%" CURL_FORMAT_CURL_OFF_T "] once decoded, over [%ld] new connections", llRawSize, psTransfer->sDecoded.llDecodedSize, lNewConnections );
+
+    // A transfer stopped by the write callback has received every header
+    if( psValidators && ( resCode == CURLE_OK || resCode == CURLE_WRITE_ERROR ) )
+    {
+        // Curl reports an unmet If-Modified-Since itself, e.g. for a file:// URL
+        if( lResponseCode == HTTP_NOT_MODIFIED || lConditionUnmet )
+        {
+            DBG_PRINTF( "[%s] hasn't changed since it was last downloaded", psTransfer->pszURL );
+            return NOT_MODIFIED;
+        }
+        psTransfer->sReceived.tLastModified = ( llFileTime > 0 ) ? ( time_t )llFileTime : 0;
+        *psValidators = psTransfer->sReceived;
+    }
+
+    if( resCode != CURLE_OK )
+    {
+        DBG_PRINTF( "Download of [%s] failed = [%d]", psTransfer->pszURL, resCode );
+        return NETWORK_ERROR;
+    }
+
+    return NO_ERROR;
+}
+
+static ERROR_CODE performDownload( CURL_SESSION * psSession, const char * pszURL, FEED_VALIDATORS * psValidators, RSS_WRITE_CALLBACK pfnWrite, void * pvWriteData )
+{
+    CURL_SESSION sOwnSession = { 0, };
+    RSS_TRANSFER sTransfer = { 0, };
+    ERROR_CODE eRet = NETWORK_ERROR;
+
+    if( !psSession )
+    {
+        RETURN_ON_FAIL( CurlSession_Init( &sOwnSession ) );
+        psSession = &sOwnSession;
+    }
+
+    sTransfer.psCurl = sessionAcquire( psSession );
+    if( sTransfer.psCurl )
+    {
+        transferSetup( &sTransfer, pszURL, psValidators, pfnWrite, pvWriteData );
+        eRet = transferFinish( &sTransfer, psSession, curl_easy_perform( sTransfer.psCurl ) );
+    }
+    else
+    {
+        DBG_PRINTF( "Download of [%s] failed, no curl handle", pszURL );
+    }
+
+    CurlSession_Free( &sOwnSession );
+
+    return eRet;
+}
+
+/*
+    Host a URL is fetched from, NULL if the URL can't be parsed
+ */
+static char * feedHost( const char * pszURL )
+{
+    CURLU * psUrl = curl_url();
+    char * pszCurlHost = _null_;
+    char * pszHost = _null_;
+
+    if( psUrl && curl_url_set( psUrl, CURLUPART_URL, pszURL, 0 ) == CURLUE_OK
+              && curl_url_get( psUrl, CURLUPART_HOST, &pszCurlHost, 0 ) == CURLUE_OK )
+    {
+        // Freed with free() like the rest of the fetch
+        pszHost = strdup( pszCurlHost );
+        curl_free( pszCurlHost );
+    }
+    curl_url_cleanup( psUrl );
+
+    return pszHost;
+}
+
+/*
+    Number of running transfers fetching from a host
+ */
+static uint32_t feedHostTransfers( const RSS_FEED_FETCH * pasFetches, const uint32_t * paulRunning, uint32_t ulRunning, const char * pszHost )
+{
+    uint32_t ulTransfers = 0;
+
+    for( uint32_t x = 0; x < ulRunning; x++ )
+    {
+        const char * pszRunningHost = pasFetches[paulRunning[x]].pszHost;
+
+        if( pszRunningHost && strcmp( pszRunningHost, pszHost ) == 0 )
+        {
+            ulTransfers++;
+        }
+    }
+
+    return ulTransfers;
+}
+
+ERROR_CODE DownloadFeedFile( CURL_SESSION * psSession, const char * pszURL, const char *pszFilename )
 {
-    CURLM * psCurl = _null_;
-    CURLcode resCode = CURLE_OK;
     RSS_FILE_STREAM sFileStream = { 0, };
 
     RETURN_ON_NULL( pszURL );
@@ -40,25 +451,278 @@ ERROR_CODE DownloadFeedFile( const char * pszURL, const char *pszFilename )
 
     snprintf( sFileStream.szFileName, sizeof( sFileStream.szFileName ), "%s", pszFilename );
 
-    curl_global_init( CURL_GLOBAL_ALL );
-    psCurl = curl_easy_init();
+    performDownload( psSession, pszURL, _null_, writeStreamToFile, &sFileStream );
 
-    if( psCurl )
+    if( sFileStream.psStream )
     {
-        curl_easy_setopt( psCurl, CURLOPT_URL, pszURL );
-        curl_easy_setopt( psCurl, CURLOPT_FOLLOWLOCATION, 1 );
-        curl_easy_setopt( psCurl, CURLOPT_WRITEFUNCTION, writeStreamToFile );
-        curl_easy_setopt( psCurl, CURLOPT_WRITEDATA, &sFileStream );
-        resCode = curl_easy_perform( psCurl );
-        curl_easy_cleanup( psCurl );
+        fclose( sFileStream.psStream );
     }
 
-    if( sFileStream.psStream )
+    return NO_ERROR;
+}
+
+ERROR_CODE DownloadFeedToBuffer( CURL_SESSION * psSession, const char * pszURL, FEED_VALIDATORS * psValidators, FEED_BUFFER * psBuffer )
+{
+    ERROR_CODE eRet = NO_ERROR;
+
+    RETURN_ON_NULL( pszURL );
+    RETURN_ON_NULL( psBuffer );
+
+    memset( psBuffer, 0, sizeof( FEED_BUFFER ) );
+
+    eRet = performDownload( psSession, pszURL, psValidators, writeStreamToBuffer, psBuffer );
+    if( ISERROR( eRet ) )
     {
-        fclose( sFileStream.psStream );
+        FeedBuffer_Free( psBuffer );
     }
 
-    curl_global_cleanup();
+    return eRet;
+}
+
+ERROR_CODE DownloadFeedStream( CURL_SESSION * psSession, const char * pszURL, FEED_VALIDATORS * psValidators, FEED_CHUNK_CALLBACK pfnOnChunk, void * pvUserData )
+{
+    RSS_CALLBACK_STREAM sStream = { 0, };
+    ERROR_CODE eRet = NO_ERROR;
+
+    RETURN_ON_NULL( pszURL );
+    RETURN_ON_NULL( pfnOnChunk );
+
+    sStream.pfnOnChunk = pfnOnChunk;
+    sStream.pvUserData = pvUserData;
+
+    eRet = performDownload( psSession, pszURL, psValidators, writeStreamToCallback, &sStream );
+
+    return ISERROR( sStream.eError ) ? sStream.eError : eRet;
+}
+
+ERROR_CODE DownloadFeeds( CURL_SESSION * psSession, const FEED_REQUEST * pasRequests, uint32_t ulCount, const FEED_FETCH_LIMITS * psLimits, FEED_DONE_CALLBACK pfnOnDone, void * pvUserData )
+{
+    const FEED_FETCH_LIMITS sDefaultLimits = { FEED_FETCH_DEFAULT_TRANSFERS, 0, 0 };
+    RSS_FEED_FETCH * pasFetches = _null_;
+    uint32_t * paulRunning = _null_;
+    uint32_t ulRunning = 0;
+    uint32_t ulMaxTransfers = 0;
+    // Every request before it has been started
+    uint32_t ulFirstPending = 0;
+    CURLM * psMulti = _null_;
+    ERROR_CODE eRet = NO_ERROR;
+
+    RETURN_ON_NULL( psSession );
+    RETURN_ON_NULL( pasRequests );
+    RETURN_ON_NULL( pfnOnDone );
+
+    psLimits = psLimits ? psLimits : &sDefaultLimits;
+    ulMaxTransfers = ( psLimits->ulMaxTransfers > 0 ) ? psLimits->ulMaxTransfers : FEED_FETCH_DEFAULT_TRANSFERS;
+    ulMaxTransfers = ( ulMaxTransfers < ulCount ) ? ulMaxTransfers : ulCount;
+    if( ulCount == 0 )
+        return NO_ERROR;
+
+    pasFetches = calloc( ulCount, sizeof( RSS_FEED_FETCH ) );
+    paulRunning = calloc( ulMaxTransfers, sizeof( uint32_t ) );
+    psMulti = curl_multi_init();
+    if( !pasFetches || !paulRunning || !psMulti )
+    {
+        eRet = NO_MEMORY;
+    }
+    for( uint32_t x = 0; !ISERROR( eRet ) && x < ulCount; x++ )
+    {
+        if( !pasRequests[x].pszURL )
+        {
+            eRet = INVALID_ARG;
+        }
+        else if( psLimits->ulMaxPerHost > 0 )
+        {
+            pasFetches[x].pszHost = feedHost( pasRequests[x].pszURL );
+        }
+    }
+
+    while( !ISERROR( eRet ) && ( ulRunning > 0 || ulFirstPending < ulCount ) )
+    {
+        CURLMsg * psMessage = _null_;
+        int iRunning = 0;
+        int iLeft = 0;
+
+        // Starts the next requests whose host isn't already at its limit
+        for( uint32_t x = ulFirstPending; !ISERROR( eRet ) && ulRunning < ulMaxTransfers && x < ulCount; x++ )
+        {
+            RSS_FEED_FETCH * psFetch = &pasFetches[x];
+
+            if( psFetch->bStarted || ( psFetch->pszHost &&
+                feedHostTransfers( pasFetches, paulRunning, ulRunning, psFetch->pszHost ) >= psLimits->ulMaxPerHost ) )
+                continue;
+
+            psFetch->bStarted = true;
+            psFetch->sTransfer.psCurl = sessionAcquire( psSession );
+            if( !psFetch->sTransfer.psCurl )
+            {
+                DBG_PRINTF( "Download of [%s] failed, no curl handle", pasRequests[x].pszURL );
+                eRet = pfnOnDone( x, NETWORK_ERROR, &psFetch->sBuffer, pvUserData );
+                continue;
+            }
+            transferSetup( &psFetch->sTransfer, pasRequests[x].pszURL, pasRequests[x].psValidators, writeStreamToBuffer, &psFetch->sBuffer );
+            curl_easy_setopt( psFetch->sTransfer.psCurl, CURLOPT_PRIVATE, psFetch );
+            if( psLimits->ulTimeoutMs > 0 )
+            {
+                curl_easy_setopt( psFetch->sTransfer.psCurl, CURLOPT_TIMEOUT_MS, ( long )psLimits->ulTimeoutMs );
+            }
+            curl_multi_add_handle( psMulti, psFetch->sTransfer.psCurl );
+            paulRunning[ulRunning++] = x;
+        }
+        for( ; ulFirstPending < ulCount && pasFetches[ulFirstPending].bStarted; ulFirstPending++ );
+
+        curl_multi_perform( psMulti, &iRunning );
+
+        // Every finished transfer is handed over as soon as it is done
+        while( ( psMessage = curl_multi_info_read( psMulti, &iLeft ) ) )
+        {
+            RSS_FEED_FETCH * psFetch = _null_;
+            ERROR_CODE eResult = NO_ERROR;
+            uint32_t ulRequest = 0;
+
+            if( psMessage->msg != CURLMSG_DONE )
+                continue;
+
+            curl_easy_getinfo( psMessage->easy_handle, CURLINFO_PRIVATE, ( char ** )&psFetch );
+            ulRequest = ( uint32_t )( psFetch - pasFetches );
+            for( uint32_t x = 0; x < ulRunning; x++ )
+            {
+                if( paulRunning[x] == ulRequest )
+                {
+                    paulRunning[x] = paulRunning[--ulRunning];
+                    break;
+                }
+            }
+
+            curl_multi_remove_handle( psMulti, psMessage->easy_handle );
+            eResult = transferFinish( &psFetch->sTransfer, psSession, psMessage->data.result );
+            if( ISERROR( eResult ) )
+            {
+                FeedBuffer_Free( &psFetch->sBuffer );
+            }
+            if( !ISERROR( eRet ) )
+            {
+                eRet = pfnOnDone( ulRequest, eResult, &psFetch->sBuffer, pvUserData );
+            }
+            FeedBuffer_Free( &psFetch->sBuffer );
+        }
+
+        if( !ISERROR( eRet ) && ulRunning > 0 )
+        {
+            curl_multi_poll( psMulti, _null_, 0, FEED_FETCH_POLL_MS, _null_ );
+        }
+    }
+
+    // Transfers still running when pfnOnDone stopped the fetch
+    for( uint32_t x = 0; x < ulRunning; x++ )
+    {
+        RSS_FEED_FETCH * psFetch = &pasFetches[paulRunning[x]];
+
+        curl_multi_remove_handle( psMulti, psFetch->sTransfer.psCurl );
+        transferFinish( &psFetch->sTransfer, psSession, CURLE_ABORTED_BY_CALLBACK );
+        FeedBuffer_Free( &psFetch->sBuffer );
+    }
+    for( uint32_t x = 0; pasFetches && x < ulCount; x++ )
+    {
+        free( pasFetches[x].pszHost );
+    }
+    curl_multi_cleanup( psMulti );
+    free( paulRunning );
+    free( pasFetches );
+
+    return eRet;
+}
+
+ERROR_CODE FeedBuffer_Append( FEED_BUFFER * psBuffer, const char * pcData, size_t ulSize )
+{
+    RETURN_ON_NULL( psBuffer );
+    RETURN_ON_NULL( pcData );
+
+    // Keep room for a NULL terminator so the buffer can also be used as a string
+    if( psBuffer->ulSize + ulSize + 1 > psBuffer->ulCapacity )
+    {
+        size_t ulCapacity = psBuffer->ulCapacity ? psBuffer->ulCapacity : FEED_BUFFER_INITIAL_SIZE;
+        char * pcNewData = _null_;
+
+        while( ulCapacity < psBuffer->ulSize + ulSize + 1 )
+        {
+            ulCapacity *= 2;
+        }
+
+        pcNewData = realloc( psBuffer->pcData, ulCapacity );
+        UTIL_ASSERT( pcNewData, NO_MEMORY );
+
+        psBuffer->pcData = pcNewData;
+        psBuffer->ulCapacity = ulCapacity;
+    }
+
+    memcpy( psBuffer->pcData + psBuffer->ulSize, pcData, ulSize );
+    psBuffer->ulSize += ulSize;
+    psBuffer->pcData[psBuffer->ulSize] = '\0';
+
+    return NO_ERROR;
+}
+
+void FeedBuffer_Free( FEED_BUFFER * psBuffer )
+{
+    if( psBuffer )
+    {
+        free( psBuffer->pcData );
+        memset( psBuffer, 0, sizeof( FEED_BUFFER ) );
+    }
+}
+
+static void * archiveThread( void * pvArchive )
+{
+    FEED_ARCHIVE * psArchive = ( FEED_ARCHIVE * )pvArchive;
+    FILE * psFile = fopen( psArchive->szFileName, "w" );
+
+    psArchive->eResult = FILE_ERROR;
+    if( psFile )
+    {
+        if( fwrite( psArchive->psBuffer->pcData, 1, psArchive->psBuffer->ulSize, psFile ) == psArchive->psBuffer->ulSize )
+        {
+            psArchive->eResult = NO_ERROR;
+        }
+        if( fclose( psFile ) != 0 )
+        {
+            psArchive->eResult = FILE_ERROR;
+        }
+    }
+
+    return _null_;
+}
+
+ERROR_CODE FeedArchive_Start( FEED_ARCHIVE * psArchive, const FEED_BUFFER * psBuffer, const char * pszFilename )
+{
+    RETURN_ON_NULL( psArchive );
+    RETURN_ON_NULL( psBuffer );
+    RETURN_ON_NULL( pszFilename );
+    UTIL_ASSERT( ( strlen( pszFilename ) > 0 ), INVALID_ARG );
+
+    memset( psArchive, 0, sizeof( FEED_ARCHIVE ) );
+    snprintf( psArchive->szFileName, sizeof( psArchive->szFileName ), "%s", pszFilename );
+    psArchive->psBuffer = psBuffer;
+
+    if( pthread_create( &psArchive->sThread, _null_, archiveThread, psArchive ) != 0 )
+    {
+        // Couldn't get a thread, archive synchronously instead
+        archiveThread( psArchive );
+        return psArchive->eResult;
+    }
+    psArchive->bStarted = true;
 
     return NO_ERROR;
 }
+
+ERROR_CODE FeedArchive_Wait( FEED_ARCHIVE * psArchive )
+{
+    RETURN_ON_NULL( psArchive );
+
+    if( psArchive->bStarted )
+    {
+        pthread_join( psArchive->sThread, _null_ );
+        psArchive->bStarted = false;
+    }
+
+    return psArchive->eResult;
+}
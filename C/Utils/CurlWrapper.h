@@ -6,14 +6,213 @@
 #ifndef CURL_WRAPPER_H
 #define CURL_WRAPPER_H
 
+#include <stdbool.h>
+#include <pthread.h>
+#include <curl/curl.h>
 #include "Utils.h"
 
+// Longest ETag kept, a longer one is ignored
+#define FEED_ETAG_SIZE ( 128 + 1 )
+// Idle easy handles a session keeps for the next downloads
+#define CURL_SESSION_MAX_HANDLES ( 4 )
+// Transfers DownloadFeeds runs at once unless told otherwise
+#define FEED_FETCH_DEFAULT_TRANSFERS ( 16 )
+
+/* 
+    Downloads made through the same session share curl's DNS cache, connections & TLS sessions,
+    so fetching a host again skips the lookup, the TCP & the TLS handshakes
+    Initialise it with CurlSession_Init, it mustn't be moved or copied afterwards
+    Several threads can download through the same session at once
+ */
+typedef struct
+{
+    CURLSH * psShare;
+    // A lock per kind of data in the share, indexed by curl_lock_data
+    pthread_mutex_t asShareLocks[CURL_LOCK_DATA_LAST];
+    // Easy handles left by finished downloads, guarded by sPoolLock
+    CURL * apsHandles[CURL_SESSION_MAX_HANDLES];
+    uint32_t ulHandles;
+    pthread_mutex_t sPoolLock;
+} CURL_SESSION;
+
+/* 
+    Growable buffer holding a downloaded file
+    pcData is always NULL terminated, ulSize doesn't include the terminator
+ */
+typedef struct
+{
+    char * pcData;
+    size_t ulSize;
+    size_t ulCapacity;
+} FEED_BUFFER;
+
+/* 
+    Called with every chunk of a download as soon as it arrives
+    @param pcChunk[IN]: Next bytes of the file, not NULL terminated
+    @param ulSize[IN]: Size of the chunk
+    @param pvUserData[IN]: As passed to DownloadFeedStream
+    @return NO_ERROR: Keep on downloading, any other value aborts the transfer
+ */
+typedef ERROR_CODE ( *FEED_CHUNK_CALLBACK )( const char * pcChunk, size_t ulSize, void * pvUserData );
+
+/* 
+    Validators of the last download of a URL, sent back to the server so that it only sends
+    the file again if it has changed. A zeroed FEED_VALIDATORS downloads the file unconditionally
+ */
+typedef struct
+{
+    // ETag header, sent as If-None-Match. Empty if the server didn't send one
+    char szETag[FEED_ETAG_SIZE];
+    // Last-Modified header, sent as If-Modified-Since. 0 if the server didn't send one
+    time_t tLastModified;
+} FEED_VALIDATORS;
+
+/* 
+    A feed to be fetched by DownloadFeeds
+ */
+typedef struct
+{
+    const char * pszURL;
+    // Optional, validators of the last download. Updated once the feed is downloaded
+    FEED_VALIDATORS * psValidators;
+} FEED_REQUEST;
+
+/* 
+    Limits of DownloadFeeds, a zeroed FEED_FETCH_LIMITS uses the defaults
+ */
+typedef struct
+{
+    // Transfers running at once, 0 for FEED_FETCH_DEFAULT_TRANSFERS
+    uint32_t ulMaxTransfers;
+    // Transfers running at once against the same host, 0 for no limit
+    uint32_t ulMaxPerHost;
+    // Longest a single transfer may take in milliseconds, 0 for no limit
+    uint32_t ulTimeoutMs;
+} FEED_FETCH_LIMITS;
+
+/* 
+    Called by DownloadFeeds as soon as a feed is downloaded, on the thread which called DownloadFeeds
+    @param ulRequest[IN]: Index of the feed's FEED_REQUEST
+    @param eResult[IN]: As returned by DownloadFeedToBuffer for the feed
+    @param psBuffer[IN/OUT]: Downloaded feed, empty unless eResult is NO_ERROR. It is freed once this
+                             returns, the callback can keep it by moving it out & zeroing psBuffer
+    @param pvUserData[IN]: As passed to DownloadFeeds
+    @return NO_ERROR: Carry on, any other value stops the fetch & is returned by DownloadFeeds
+ */
+typedef ERROR_CODE ( *FEED_DONE_CALLBACK )( uint32_t ulRequest, ERROR_CODE eResult, FEED_BUFFER * psBuffer, void * pvUserData );
+
+/* 
+    Asynchronous write of a FEED_BUFFER onto the disk
+    Started with FeedArchive_Start, has to be finished with FeedArchive_Wait
+ */
+typedef struct
+{
+    char szFileName[MAX_FILENAME_LEN + 1];
+    const FEED_BUFFER * psBuffer;
+    pthread_t sThread;
+    bool bStarted;
+    ERROR_CODE eResult;
+} FEED_ARCHIVE;
+
+/* 
+    Starts a session, curl itself is only initialised by the first session of the process
+    @param psSession[OUT]: Session
+    @return NO_ERROR: Success
+    @return NETWORK_ERROR: Curl couldn't be initialised
+ */
+ERROR_CODE CurlSession_Init( CURL_SESSION * psSession );
+
+/* 
+    Closes the session's connections & frees it, no download may still be using it
+    @param psSession[IN/OUT]: Session, can be zeroed
+ */
+void CurlSession_Free( CURL_SESSION * psSession );
+
 /* 
     Curl Wrapper to download a URL 
+    @param psSession[IN]: Optional, session the download goes through. NULL uses a session of its own
     @param pszUrl[IN]: URL CURL calls & downloads
     @param pszFilename[IN]: Filename to used for downloaded file
     @return NO_ERROR: Success
  */
-ERROR_CODE DownloadFeedFile( const char * pszURL, const char *pszFilename );
+ERROR_CODE DownloadFeedFile( CURL_SESSION * psSession, const char * pszURL, const char *pszFilename );
+
+/* 
+    Curl Wrapper to download a URL into memory
+    @param psSession[IN]: Optional, session the download goes through. NULL uses a session of its own
+    @param pszUrl[IN]: URL CURL calls & downloads
+    @param psValidators[IN/OUT]: Optional, validators of the last download. Updated once the file is downloaded
+    @param psBuffer[OUT]: Downloaded file, free with FeedBuffer_Free
+    @return NO_ERROR: Success
+    @return NOT_MODIFIED: File hasn't changed since psValidators were received, psBuffer is left empty
+    @return NETWORK_ERROR: Download failed, psBuffer is left empty
+ */
+ERROR_CODE DownloadFeedToBuffer( CURL_SESSION * psSession, const char * pszURL, FEED_VALIDATORS * psValidators, FEED_BUFFER * psBuffer );
+
+/* 
+    Curl Wrapper to download a URL & hand every chunk over as it arrives
+    Lets the caller parse the file while the rest of it is still being downloaded
+    @param psSession[IN]: Optional, session the download goes through. NULL uses a session of its own
+    @param pszUrl[IN]: URL CURL calls & downloads
+    @param psValidators[IN/OUT]: Optional, validators of the last download. Updated once the file is downloaded
+    @param pfnOnChunk[IN]: Called for every chunk received
+    @param pvUserData[IN]: Passed on to pfnOnChunk
+    @return NO_ERROR: Success
+    @return NOT_MODIFIED: File hasn't changed since psValidators were received, pfnOnChunk isn't called
+    @return NETWORK_ERROR: Download failed
+    @return Other: Error returned by pfnOnChunk, the download is aborted
+ */
+ERROR_CODE DownloadFeedStream( CURL_SESSION * psSession, const char * pszURL, FEED_VALIDATORS * psValidators, FEED_CHUNK_CALLBACK pfnOnChunk, void * pvUserData );
+
+/* 
+    Downloads several feeds at once & hands each of them over as soon as it is downloaded,
+    so fetching them takes about as long as the slowest one rather than all of them together
+    Feeds are started in order, one whose host is at its limit waits for the host's next free slot
+    @param psSession[IN]: Session the downloads go through
+    @param pasRequests[IN/OUT]: Feeds to be downloaded
+    @param ulCount[IN]: Number of feeds
+    @param psLimits[IN]: Optional, limits of the fetch. NULL uses the defaults
+    @param pfnOnDone[IN]: Called once for every feed, in the order they finish downloading
+    @param pvUserData[IN]: Passed on to pfnOnDone
+    @return NO_ERROR: Every feed was handed to pfnOnDone, whether it could be downloaded or not
+    @return INVALID_ARG: A feed has no URL, nothing is downloaded
+    @return NO_MEMORY: Fetch couldn't be set up, nothing is downloaded
+    @return Other: Error returned by pfnOnDone, the downloads still running are aborted
+ */
+ERROR_CODE DownloadFeeds( CURL_SESSION * psSession, const FEED_REQUEST * pasRequests, uint32_t ulCount, const FEED_FETCH_LIMITS * psLimits, FEED_DONE_CALLBACK pfnOnDone, void * pvUserData );
+
+/* 
+    Appends data to a buffer, growing it as required
+    @param psBuffer[IN/OUT]: Buffer, has to be zeroed before the first call
+    @param pcData[IN]: Data to be appended
+    @param ulSize[IN]: Size of the data
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Buffer couldn't be grown, its content is left untouched
+ */
+ERROR_CODE FeedBuffer_Append( FEED_BUFFER * psBuffer, const char * pcData, size_t ulSize );
+
+/* 
+    Frees a buffer filled by DownloadFeedToBuffer
+    @param psBuffer[IN]: Buffer to be freed
+ */
+void FeedBuffer_Free( FEED_BUFFER * psBuffer );
+
+/* 
+    Starts writing a downloaded buffer into a file on a background thread
+    psBuffer mustn't be modified or freed until FeedArchive_Wait returns
+    @param psArchive[OUT]: Archive state
+    @param psBuffer[IN]: Buffer to be written
+    @param pszFilename[IN]: Filename of the archive
+    @return NO_ERROR: Archive started
+ */
+ERROR_CODE FeedArchive_Start( FEED_ARCHIVE * psArchive, const FEED_BUFFER * psBuffer, const char * pszFilename );
+
+/* 
+    Waits for an archive started by FeedArchive_Start to be written
+    @param psArchive[IN]: Archive state
+    @return NO_ERROR: File written
+    @return FILE_ERROR: File couldn't be written
+ */
+ERROR_CODE FeedArchive_Wait( FEED_ARCHIVE * psArchive );
 
 #endif
@@ -0,0 +1,183 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include "HashIndex.h"
+
+// Defines
+#define HASH_INDEX_INITIAL_CAPACITY ( 64 )
+#define FNV_OFFSET_BASIS            ( 0xcbf29ce484222325ULL )
+#define FNV_PRIME                   ( 0x100000001b3ULL )
+
+// Static Functions
+static uint64_t hashIndexSlotHash( uint64_t ullHash );
+static ERROR_CODE hashIndexGrow( HASH_INDEX * psIndex );
+
+/*
+    0 marks an empty slot, so it is never stored
+ */
+static uint64_t hashIndexSlotHash( uint64_t ullHash )
+{
+   return ( ullHash == 0 ) ? 1 : ullHash;
+}
+
+static ERROR_CODE hashIndexGrow( HASH_INDEX * psIndex )
+{
+   HASH_INDEX sGrown = { 0, };
+
+   sGrown.ulCapacity = psIndex->ulCapacity ? psIndex->ulCapacity * 2 : HASH_INDEX_INITIAL_CAPACITY;
+   UTIL_ASSERT( sGrown.ulCapacity, NO_MEMORY );
+   sGrown.paullHashes = calloc( sGrown.ulCapacity, sizeof( uint64_t ) );
+   sGrown.paulValues = calloc( sGrown.ulCapacity, sizeof( uint32_t ) );
+   if( !sGrown.paullHashes || !sGrown.paulValues )
+   {
+      HashIndex_Free( &sGrown );
+      return NO_MEMORY;
+   }
+
+   for( uint32_t ulSlot = 0; ulSlot < psIndex->ulCapacity; ulSlot++ )
+   {
+      if( psIndex->paullHashes[ulSlot] != 0 )
+      {
+         // Can't fail, there is enough room
+         HashIndex_Insert( &sGrown, psIndex->paullHashes[ulSlot], psIndex->paulValues[ulSlot] );
+      }
+   }
+
+   HashIndex_Free( psIndex );
+   *psIndex = sGrown;
+
+   return NO_ERROR;
+}
+
+uint64_t HashIndex_HashString( const char * pszString )
+{
+   uint64_t ullHash = FNV_OFFSET_BASIS;
+
+   for( ; pszString && *pszString; pszString++ )
+   {
+      ullHash ^= ( uint8_t )*pszString;
+      ullHash *= FNV_PRIME;
+   }
+
+   return ullHash;
+}
+
+ERROR_CODE HashIndex_Insert( HASH_INDEX * psIndex, uint64_t ullHash, uint32_t ulValue )
+{
+   uint32_t ulSlot = 0;
+
+   RETURN_ON_NULL( psIndex );
+
+   // Kept at most 3/4 full so that probe sequences stay short
+   if( ( psIndex->ulCount + 1 ) * 4 > psIndex->ulCapacity * 3 )
+   {
+      RETURN_ON_FAIL( hashIndexGrow( psIndex ) );
+   }
+
+   ullHash = hashIndexSlotHash( ullHash );
+   ulSlot = ( uint32_t )ullHash & ( psIndex->ulCapacity - 1 );
+   while( psIndex->paullHashes[ulSlot] != 0 )
+   {
+      ulSlot = ( ulSlot + 1 ) & ( psIndex->ulCapacity - 1 );
+   }
+
+   psIndex->paullHashes[ulSlot] = ullHash;
+   psIndex->paulValues[ulSlot] = ulValue;
+   psIndex->ulCount++;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE HashIndex_Find( const HASH_INDEX * psIndex, uint64_t ullHash, HASH_INDEX_MATCH pfnMatch, const void * pvKey, uint32_t * pulValue )
+{
+   uint32_t ulSlot = 0;
+
+   RETURN_ON_NULL( psIndex );
+   RETURN_ON_NULL( pfnMatch );
+   RETURN_ON_NULL( pulValue );
+
+   if( psIndex->ulCount == 0 )
+      return NOT_FOUND;
+
+   ullHash = hashIndexSlotHash( ullHash );
+   ulSlot = ( uint32_t )ullHash & ( psIndex->ulCapacity - 1 );
+   // Linear probing, the first empty slot ends the search
+   while( psIndex->paullHashes[ulSlot] != 0 )
+   {
+      if( psIndex->paullHashes[ulSlot] == ullHash && pfnMatch( psIndex->paulValues[ulSlot], pvKey ) )
+      {
+         *pulValue = psIndex->paulValues[ulSlot];
+         return NO_ERROR;
+      }
+      ulSlot = ( ulSlot + 1 ) & ( psIndex->ulCapacity - 1 );
+   }
+
+   return NOT_FOUND;
+}
+
+ERROR_CODE HashIndex_Load( HASH_INDEX * psIndex, const uint64_t * paullHashes, const uint32_t * paulValues, uint32_t ulCapacity )
+{
+   HASH_INDEX sLoaded = { 0, };
+
+   RETURN_ON_NULL( psIndex );
+   UTIL_ASSERT( ( ( ulCapacity & ( ulCapacity - 1 ) ) == 0 ), INVALID_ARG );
+   UTIL_ASSERT( ( ulCapacity == 0 || ( paullHashes && paulValues ) ), INVALID_ARG );
+
+   for( uint32_t ulSlot = 0; ulSlot < ulCapacity; ulSlot++ )
+   {
+      sLoaded.ulCount += ( paullHashes[ulSlot] != 0 );
+   }
+   // Same limit as HashIndex_Insert, a full index would never end a probe sequence
+   UTIL_ASSERT( ( ( uint64_t )sLoaded.ulCount * 4 <= ( uint64_t )ulCapacity * 3 ), INVALID_ARG );
+
+   if( ulCapacity == 0 )
+   {
+      HashIndex_Clear( psIndex );
+      return NO_ERROR;
+   }
+
+   if( psIndex->ulCapacity == ulCapacity )
+   {
+      sLoaded.paullHashes = psIndex->paullHashes;
+      sLoaded.paulValues = psIndex->paulValues;
+   }
+   else
+   {
+      sLoaded.paullHashes = malloc( ulCapacity * sizeof( uint64_t ) );
+      sLoaded.paulValues = malloc( ulCapacity * sizeof( uint32_t ) );
+      if( !sLoaded.paullHashes || !sLoaded.paulValues )
+      {
+         HashIndex_Free( &sLoaded );
+         return NO_MEMORY;
+      }
+      HashIndex_Free( psIndex );
+   }
+
+   memcpy( sLoaded.paullHashes, paullHashes, ulCapacity * sizeof( uint64_t ) );
+   memcpy( sLoaded.paulValues, paulValues, ulCapacity * sizeof( uint32_t ) );
+   sLoaded.ulCapacity = ulCapacity;
+   *psIndex = sLoaded;
+
+   return NO_ERROR;
+}
+
+void HashIndex_Clear( HASH_INDEX * psIndex )
+{
+   if( psIndex && psIndex->paullHashes )
+   {
+      memset( psIndex->paullHashes, 0, psIndex->ulCapacity * sizeof( uint64_t ) );
+      psIndex->ulCount = 0;
+   }
+}
+
+void HashIndex_Free( HASH_INDEX * psIndex )
+{
+   if( psIndex )
+   {
+      free( psIndex->paullHashes );
+      free( psIndex->paulValues );
+      memset( psIndex, 0, sizeof( HASH_INDEX ) );
+   }
+}
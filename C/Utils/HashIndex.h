@@ -0,0 +1,91 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stdbool.h>
+#include "Utils.h"
+
+/*
+    Open addressing hash index, maps a 64 bit hash onto a caller defined 32 bit value
+    e.g. the position of a record in an array. Only the hashes are stored, so lookups
+    are confirmed against the caller's own records with a HASH_INDEX_MATCH callback
+    A zeroed HASH_INDEX is a valid, empty index
+ */
+typedef struct
+{
+    // 0 marks an empty slot
+    uint64_t * paullHashes;
+    uint32_t * paulValues;
+    // Always a power of 2
+    uint32_t ulCapacity;
+    uint32_t ulCount;
+} HASH_INDEX;
+
+/*
+    Confirms that a value found in the index is the one being looked for
+    @param ulValue[IN]: Value stored with a matching hash
+    @param pvKey[IN]: Key passed to HashIndex_Find
+    @return true: ulValue is the one being looked for
+ */
+typedef bool ( *HASH_INDEX_MATCH )( uint32_t ulValue, const void * pvKey );
+
+/*
+    64 bit FNV-1a hash of a string
+    @param pszString[IN]: NULL terminated string
+    @return Hash of the string
+ */
+uint64_t HashIndex_HashString( const char * pszString );
+
+/*
+    Adds a value to the index, the index grows as required
+    The same hash can be added more than once
+    @param psIndex[IN/OUT]: Index
+    @param ullHash[IN]: Hash of the value's key
+    @param ulValue[IN]: Value to be stored
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Index couldn't be grown, it is left as it was
+ */
+ERROR_CODE HashIndex_Insert( HASH_INDEX * psIndex, uint64_t ullHash, uint32_t ulValue );
+
+/*
+    Looks up a value in the index
+    @param psIndex[IN]: Index
+    @param ullHash[IN]: Hash of the key
+    @param pfnMatch[IN]: Called for every value stored with the same hash until it returns true
+    @param pvKey[IN]: Passed on to pfnMatch
+    @param pulValue[OUT]: Value found
+    @return NO_ERROR: Value found
+    @return NOT_FOUND: No value matches the key
+ */
+ERROR_CODE HashIndex_Find( const HASH_INDEX * psIndex, uint64_t ullHash, HASH_INDEX_MATCH pfnMatch, const void * pvKey, uint32_t * pulValue );
+
+/*
+    Replaces the index with the slots of another one, e.g. an index saved in a file
+    The slots are copied as they are, nothing is hashed again
+    @param psIndex[IN/OUT]: Index
+    @param paullHashes[IN]: Hashes of every slot, 0 for an empty slot
+    @param paulValues[IN]: Values of every slot
+    @param ulCapacity[IN]: Number of slots, 0 or a power of 2
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Slots aren't those of a HASH_INDEX, e.g. too full, the index is left as it was
+    @return NO_MEMORY: Index couldn't be allocated, the index is left as it was
+ */
+ERROR_CODE HashIndex_Load( HASH_INDEX * psIndex, const uint64_t * paullHashes, const uint32_t * paulValues, uint32_t ulCapacity );
+
+/*
+    Removes every value from the index, the memory is kept for reuse
+    @param psIndex[IN/OUT]: Index
+ */
+void HashIndex_Clear( HASH_INDEX * psIndex );
+
+/*
+    Frees the index, it is left empty & can be reused
+    @param psIndex[IN/OUT]: Index
+ */
+void HashIndex_Free( HASH_INDEX * psIndex );
+
+#endif
@@ -0,0 +1,354 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Journal.h"
+
+// Defines
+#define JOURNAL_FNV_OFFSET ( 2166136261u )
+#define JOURNAL_FNV_PRIME  ( 16777619u )
+
+// Typedefs
+/*
+    Written in front of every record
+ */
+typedef struct
+{
+    uint32_t ulSequence;
+    uint32_t ulType;
+    uint32_t ulSize;
+    // Covers the fields above & the record
+    uint32_t ulChecksum;
+} JOURNAL_HEADER;
+
+// Static Functions
+static uint32_t journalChecksum( const JOURNAL_HEADER * psHeader, const void * pvData );
+static int journalRead( int iFd, void * pvBuffer, uint32_t ulSize );
+static ERROR_CODE journalScan( int iFd, JOURNAL_CALLBACK pfnRecord, void * pvUserData, uint64_t * pullValidSize );
+static ERROR_CODE journalWrite( JOURNAL * psJournal, const void * pvBuffer, size_t ulLength );
+
+/*
+    32 bit FNV-1a, enough to tell a torn or garbled record apart
+ */
+static uint32_t journalChecksum( const JOURNAL_HEADER * psHeader, const void * pvData )
+{
+   const uint32_t aulFields[] = { psHeader->ulSequence, psHeader->ulType, psHeader->ulSize };
+   const uint8_t * pucBytes = ( const uint8_t * )aulFields;
+   uint32_t ulHash = JOURNAL_FNV_OFFSET;
+
+   for( uint32_t ulCount = 0; ulCount < sizeof( aulFields ); ulCount++ )
+   {
+      ulHash = ( ulHash ^ pucBytes[ulCount] ) * JOURNAL_FNV_PRIME;
+   }
+
+   pucBytes = ( const uint8_t * )pvData;
+   for( uint32_t ulCount = 0; ulCount < psHeader->ulSize; ulCount++ )
+   {
+      ulHash = ( ulHash ^ pucBytes[ulCount] ) * JOURNAL_FNV_PRIME;
+   }
+
+   return ulHash;
+}
+
+/*
+    Reads exactly ulSize bytes
+    @return 1 if they were read, 0 if the file ended before, -1 on error
+ */
+static int journalRead( int iFd, void * pvBuffer, uint32_t ulSize )
+{
+   uint32_t ulRead = 0;
+
+   while( ulRead < ulSize )
+   {
+      ssize_t lRet = read( iFd, pvBuffer + ulRead, ulSize - ulRead );
+
+      if( lRet < 0 && errno == EINTR )
+         continue;
+      if( lRet < 0 )
+         return -1;
+      if( lRet == 0 )
+         return 0;
+      ulRead += ( uint32_t )lRet;
+   }
+
+   return 1;
+}
+
+/*
+    Reads records from the current position until the end of the file or the first torn record
+ */
+static ERROR_CODE journalScan( int iFd, JOURNAL_CALLBACK pfnRecord, void * pvUserData, uint64_t * pullValidSize )
+{
+   uint8_t aucData[JOURNAL_MAX_RECORD];
+   JOURNAL_HEADER sHeader = { 0, };
+   int iRet = 0;
+
+   *pullValidSize = 0;
+   while( ( iRet = journalRead( iFd, &sHeader, sizeof( sHeader ) ) ) == 1 )
+   {
+      if( sHeader.ulSize > sizeof( aucData ) )
+         break;
+
+      iRet = journalRead( iFd, aucData, sHeader.ulSize );
+      if( iRet != 1 || journalChecksum( &sHeader, aucData ) != sHeader.ulChecksum )
+         break;
+
+      if( pfnRecord )
+      {
+         RETURN_ON_FAIL( pfnRecord( sHeader.ulSequence, sHeader.ulType, aucData, sHeader.ulSize, pvUserData ) );
+      }
+      *pullValidSize += sizeof( sHeader ) + sHeader.ulSize;
+   }
+
+   return ( iRet < 0 ) ? FILE_ERROR : NO_ERROR;
+}
+
+ERROR_CODE Journal_Open( JOURNAL * psJournal, const char * pszFileName )
+{
+   uint64_t ullSize = 0;
+   ERROR_CODE eRet = NO_ERROR;
+   int iFd = -1;
+
+   RETURN_ON_NULL( psJournal );
+   RETURN_ON_NULL( pszFileName );
+   memset( psJournal, 0, sizeof( JOURNAL ) );
+
+   iFd = open( pszFileName, O_RDWR | O_CREAT, 0644 );
+   UTIL_ASSERT( ( iFd >= 0 ), FILE_ERROR );
+
+   // A torn record at the end would hide every record appended after it
+   eRet = journalScan( iFd, _null_, _null_, &ullSize );
+   if( !ISERROR( eRet ) && ( ftruncate( iFd, ( off_t )ullSize ) != 0 || lseek( iFd, ( off_t )ullSize, SEEK_SET ) < 0 ) )
+   {
+      eRet = FILE_ERROR;
+   }
+   if( !ISERROR( eRet ) )
+   {
+      psJournal->pszFileName = strdup( pszFileName );
+      eRet = psJournal->pszFileName ? NO_ERROR : NO_MEMORY;
+   }
+   if( ISERROR( eRet ) )
+   {
+      close( iFd );
+      return eRet;
+   }
+
+   psJournal->iFd = iFd;
+   psJournal->ullSize = ullSize;
+   psJournal->bOpen = true;
+
+   return NO_ERROR;
+}
+
+/*
+    Writes records put together by the caller & flushes them to the disk, nothing is kept on failure
+ */
+static ERROR_CODE journalWrite( JOURNAL * psJournal, const void * pvBuffer, size_t ulLength )
+{
+   size_t ulWritten = 0;
+
+   while( ulWritten < ulLength )
+   {
+      ssize_t lRet = write( psJournal->iFd, pvBuffer + ulWritten, ulLength - ulWritten );
+
+      if( lRet < 0 && errno == EINTR )
+         continue;
+      if( lRet <= 0 )
+         break;
+      ulWritten += ( size_t )lRet;
+   }
+
+   if( ulWritten < ulLength || fdatasync( psJournal->iFd ) != 0 )
+   {
+      // Whatever made it to the file is cut off again
+      if( ftruncate( psJournal->iFd, ( off_t )psJournal->ullSize ) != 0 )
+      {
+         DBG_PRINTF( "Couldn't drop a partial record from [%s]", psJournal->pszFileName );
+      }
+      lseek( psJournal->iFd, ( off_t )psJournal->ullSize, SEEK_SET );
+      return FILE_ERROR;
+   }
+   psJournal->ullSize += ulLength;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE Journal_Append( JOURNAL * psJournal, uint32_t ulSequence, uint32_t ulType, const void * pvData, uint32_t ulSize )
+{
+   uint8_t aucRecord[sizeof( JOURNAL_HEADER ) + JOURNAL_MAX_RECORD];
+   JOURNAL_HEADER sHeader = { ulSequence, ulType, ulSize, 0 };
+
+   RETURN_ON_NULL( psJournal );
+   UTIL_ASSERT( psJournal->bOpen, INVALID_ARG );
+   UTIL_ASSERT( ( pvData || ulSize == 0 ), INVALID_ARG );
+   UTIL_ASSERT( ( ulSize <= JOURNAL_MAX_RECORD ), INVALID_ARG );
+
+   // Header & record go out in a single write
+   sHeader.ulChecksum = journalChecksum( &sHeader, pvData );
+   memcpy( aucRecord, &sHeader, sizeof( sHeader ) );
+   if( ulSize > 0 )
+   {
+      memcpy( aucRecord + sizeof( sHeader ), pvData, ulSize );
+   }
+
+   return journalWrite( psJournal, aucRecord, sizeof( sHeader ) + ulSize );
+}
+
+ERROR_CODE Journal_AppendRecords( JOURNAL * psJournal, uint32_t ulFirstSequence, uint32_t ulType, const void * pvRecords, uint32_t ulRecordSize, uint32_t ulCount )
+{
+   const size_t ulStride = sizeof( JOURNAL_HEADER ) + ulRecordSize;
+   ERROR_CODE eRet = NO_ERROR;
+   uint8_t * pucBuffer = _null_;
+
+   RETURN_ON_NULL( psJournal );
+   UTIL_ASSERT( psJournal->bOpen, INVALID_ARG );
+   UTIL_ASSERT( ( pvRecords || ulRecordSize == 0 || ulCount == 0 ), INVALID_ARG );
+   UTIL_ASSERT( ( ulRecordSize <= JOURNAL_MAX_RECORD ), INVALID_ARG );
+   UTIL_ASSERT( ( ulCount <= SIZE_MAX / ulStride ), NO_MEMORY );
+
+   if( ulCount == 0 )
+      return NO_ERROR;
+
+   pucBuffer = malloc( ulStride * ulCount );
+   UTIL_ASSERT( pucBuffer, NO_MEMORY );
+
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      const void * pvRecord = pvRecords + ( size_t )x * ulRecordSize;
+      JOURNAL_HEADER sHeader = { ulFirstSequence + x, ulType, ulRecordSize, 0 };
+
+      sHeader.ulChecksum = journalChecksum( &sHeader, pvRecord );
+      memcpy( pucBuffer + x * ulStride, &sHeader, sizeof( sHeader ) );
+      if( ulRecordSize > 0 )
+      {
+         memcpy( pucBuffer + x * ulStride + sizeof( sHeader ), pvRecord, ulRecordSize );
+      }
+   }
+
+   eRet = journalWrite( psJournal, pucBuffer, ulStride * ulCount );
+   free( pucBuffer );
+
+   return eRet;
+}
+
+ERROR_CODE Journal_AppendBatch( JOURNAL * psJournal, uint32_t ulFirstSequence, const JOURNAL_RECORD * pasRecords, uint32_t ulCount )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   uint8_t * pucBuffer = _null_;
+   size_t ulLength = 0;
+   size_t ulOffset = 0;
+
+   RETURN_ON_NULL( psJournal );
+   UTIL_ASSERT( psJournal->bOpen, INVALID_ARG );
+   UTIL_ASSERT( ( pasRecords || ulCount == 0 ), INVALID_ARG );
+
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      UTIL_ASSERT( ( pasRecords[x].ulSize <= JOURNAL_MAX_RECORD ), INVALID_ARG );
+      UTIL_ASSERT( ( pasRecords[x].pvData || pasRecords[x].ulSize == 0 ), INVALID_ARG );
+      ulLength += sizeof( JOURNAL_HEADER ) + pasRecords[x].ulSize;
+   }
+   if( ulCount == 0 )
+      return NO_ERROR;
+
+   pucBuffer = malloc( ulLength );
+   UTIL_ASSERT( pucBuffer, NO_MEMORY );
+
+   for( uint32_t x = 0; x < ulCount; x++ )
+   {
+      JOURNAL_HEADER sHeader = { ulFirstSequence + x, pasRecords[x].ulType, pasRecords[x].ulSize, 0 };
+
+      sHeader.ulChecksum = journalChecksum( &sHeader, pasRecords[x].pvData );
+      memcpy( pucBuffer + ulOffset, &sHeader, sizeof( sHeader ) );
+      ulOffset += sizeof( sHeader );
+      if( sHeader.ulSize > 0 )
+      {
+         memcpy( pucBuffer + ulOffset, pasRecords[x].pvData, sHeader.ulSize );
+         ulOffset += sHeader.ulSize;
+      }
+   }
+
+   eRet = journalWrite( psJournal, pucBuffer, ulLength );
+   free( pucBuffer );
+
+   return eRet;
+}
+
+ERROR_CODE Journal_Replay( const char * pszFileName, JOURNAL_CALLBACK pfnRecord, void * pvUserData )
+{
+   uint64_t ullSize = 0;
+   ERROR_CODE eRet = NO_ERROR;
+   int iFd = -1;
+
+   RETURN_ON_NULL( pszFileName );
+   RETURN_ON_NULL( pfnRecord );
+
+   iFd = open( pszFileName, O_RDONLY );
+   if( iFd < 0 )
+   {
+      return ( errno == ENOENT ) ? NO_ERROR : FILE_ERROR;
+   }
+
+   eRet = journalScan( iFd, pfnRecord, pvUserData, &ullSize );
+   close( iFd );
+
+   return eRet;
+}
+
+ERROR_CODE Journal_Rotate( JOURNAL * psJournal, const char * pszRotatedName )
+{
+   char * pszFileName = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( psJournal );
+   RETURN_ON_NULL( pszRotatedName );
+   UTIL_ASSERT( psJournal->bOpen, INVALID_ARG );
+
+   // The name outlives the journal being closed
+   pszFileName = psJournal->pszFileName;
+   psJournal->pszFileName = _null_;
+   Journal_Close( psJournal );
+
+   if( rename( pszFileName, pszRotatedName ) != 0 )
+   {
+      eRet = FILE_ERROR;
+   }
+   // Either a new, empty journal or the old one if the rename failed
+   if( ISERROR( Journal_Open( psJournal, pszFileName ) ) )
+   {
+      eRet = FILE_ERROR;
+   }
+   free( pszFileName );
+
+   return eRet;
+}
+
+ERROR_CODE Journal_Truncate( JOURNAL * psJournal )
+{
+   RETURN_ON_NULL( psJournal );
+   UTIL_ASSERT( psJournal->bOpen, INVALID_ARG );
+
+   UTIL_ASSERT( ( ftruncate( psJournal->iFd, 0 ) == 0 ), FILE_ERROR );
+   UTIL_ASSERT( ( lseek( psJournal->iFd, 0, SEEK_SET ) == 0 ), FILE_ERROR );
+   psJournal->ullSize = 0;
+   UTIL_ASSERT( ( fdatasync( psJournal->iFd ) == 0 ), FILE_ERROR );
+
+   return NO_ERROR;
+}
+
+void Journal_Close( JOURNAL * psJournal )
+{
+   if( psJournal )
+   {
+      if( psJournal->bOpen )
+      {
+         close( psJournal->iFd );
+      }
+      free( psJournal->pszFileName );
+      memset( psJournal, 0, sizeof( JOURNAL ) );
+   }
+}
@@ -0,0 +1,139 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include "Utils.h"
+
+// Largest record a journal accepts
+#define JOURNAL_MAX_RECORD ( 4096 )
+
+/*
+    Append-only file of small records, e.g. the changes made to a file since it was last written
+    Every record carries a caller defined sequence number & type, and is checksummed so that
+    a record torn by a crash is dropped instead of being replayed
+    A zeroed JOURNAL is closed
+ */
+typedef struct
+{
+    char * pszFileName;
+    int iFd;
+    bool bOpen;
+    // Bytes of valid records in the file
+    uint64_t ullSize;
+} JOURNAL;
+
+/*
+    A record of Journal_AppendBatch
+ */
+typedef struct
+{
+    uint32_t ulType;
+    const void * pvData;
+    uint32_t ulSize;
+} JOURNAL_RECORD;
+
+/*
+    Called for every valid record of a journal, in the order they were appended
+    @param ulSequence[IN]: Sequence number the record was appended with
+    @param ulType[IN]: Type the record was appended with
+    @param pvData[IN]: Record, only valid during the call
+    @param ulSize[IN]: Size of the record
+    @param pvUserData[IN]: As passed to Journal_Replay
+    @return NO_ERROR: Carry on, any other value stops the replay & is returned
+ */
+typedef ERROR_CODE ( *JOURNAL_CALLBACK )( uint32_t ulSequence, uint32_t ulType, const void * pvData, uint32_t ulSize, void * pvUserData );
+
+/*
+    Opens a journal for appending, the file is created if it doesn't exist
+    Anything after the last valid record, i.e. a record torn by a crash, is cut off
+    @param psJournal[OUT]: Journal
+    @param pszFileName[IN]: File of the journal
+    @return NO_ERROR: Success
+    @return FILE_ERROR: File couldn't be opened
+ */
+ERROR_CODE Journal_Open( JOURNAL * psJournal, const char * pszFileName );
+
+/*
+    Appends a record, it is on the disk when this returns
+    @param psJournal[IN/OUT]: Open journal
+    @param ulSequence[IN]: Sequence number, e.g. to tell which records are already in a snapshot
+    @param ulType[IN]: Type of the record
+    @param pvData[IN]: Record
+    @param ulSize[IN]: Size of the record, up to JOURNAL_MAX_RECORD
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Journal isn't open or the record is too large
+    @return FILE_ERROR: Record couldn't be written, the journal is left as it was
+ */
+ERROR_CODE Journal_Append( JOURNAL * psJournal, uint32_t ulSequence, uint32_t ulType, const void * pvData, uint32_t ulSize );
+
+/*
+    Appends records of the same type & size with a single write & a single flush to the disk
+    A crash can keep the first records & drop the rest, every record is replayed on its own
+    @param psJournal[IN/OUT]: Open journal
+    @param ulFirstSequence[IN]: Sequence number of the first record, the next ones go up by one
+    @param ulType[IN]: Type of every record
+    @param pvRecords[IN]: Records, one after the other
+    @param ulRecordSize[IN]: Size of a record, up to JOURNAL_MAX_RECORD
+    @param ulCount[IN]: Number of records
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Journal isn't open or the records are too large
+    @return NO_MEMORY: Records couldn't be put together
+    @return FILE_ERROR: Records couldn't be written, the journal is left as it was
+ */
+ERROR_CODE Journal_AppendRecords( JOURNAL * psJournal, uint32_t ulFirstSequence, uint32_t ulType, const void * pvRecords, uint32_t ulRecordSize, uint32_t ulCount );
+
+/*
+    Appends records of any type & size with a single write & a single flush to the disk
+    A crash can keep the first records & drop the rest, every record is replayed on its own
+    @param psJournal[IN/OUT]: Open journal
+    @param ulFirstSequence[IN]: Sequence number of the first record, the next ones go up by one
+    @param pasRecords[IN]: Records, in the order they are appended
+    @param ulCount[IN]: Number of records
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Journal isn't open or a record is too large
+    @return NO_MEMORY: Records couldn't be put together
+    @return FILE_ERROR: Records couldn't be written, the journal is left as it was
+ */
+ERROR_CODE Journal_AppendBatch( JOURNAL * psJournal, uint32_t ulFirstSequence, const JOURNAL_RECORD * pasRecords, uint32_t ulCount );
+
+/*
+    Calls pfnRecord for every valid record of a journal file, the replay stops at the first torn record
+    @param pszFileName[IN]: File of the journal, a missing file is an empty journal
+    @param pfnRecord[IN]: Called for every record
+    @param pvUserData[IN]: Passed on to pfnRecord
+    @return NO_ERROR: Success
+    @return FILE_ERROR: File couldn't be read
+    @return Any error returned by pfnRecord
+ */
+ERROR_CODE Journal_Replay( const char * pszFileName, JOURNAL_CALLBACK pfnRecord, void * pvUserData );
+
+/*
+    Moves the journal's records to another file & carries on with an empty journal
+    e.g. while the records moved away are being folded into a snapshot
+    @param psJournal[IN/OUT]: Open journal
+    @param pszRotatedName[IN]: File the records are moved to, it is replaced if it exists
+    @return NO_ERROR: Success
+    @return FILE_ERROR: Journal couldn't be rotated, it is closed if it couldn't be reopened
+ */
+ERROR_CODE Journal_Rotate( JOURNAL * psJournal, const char * pszRotatedName );
+
+/*
+    Drops every record, e.g. once they are all in a snapshot
+    @param psJournal[IN/OUT]: Open journal
+    @return NO_ERROR: Success
+    @return FILE_ERROR: File couldn't be truncated
+ */
+ERROR_CODE Journal_Truncate( JOURNAL * psJournal );
+
+/*
+    Closes a journal, the file is kept
+    @param psJournal[IN/OUT]: Journal, can be closed already
+ */
+void Journal_Close( JOURNAL * psJournal );
+
+#endif
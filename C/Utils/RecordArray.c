@@ -0,0 +1,161 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include "RecordArray.h"
+
+// Defines
+#define RECORD_ARRAY_INITIAL_CAPACITY ( 16 )
+
+// Static Functions
+static void * recordArraySlot( const RECORD_ARRAY * psArray, uint32_t ulIndex );
+
+/*
+    Address of a record, ulIndex can go up to the capacity
+ */
+static void * recordArraySlot( const RECORD_ARRAY * psArray, uint32_t ulIndex )
+{
+   // ulHead & ulIndex are both below the capacity, a single wrap is enough
+   uint32_t ulSlot = psArray->ulHead + ulIndex;
+
+   if( ulSlot >= psArray->ulCapacity )
+   {
+      ulSlot -= psArray->ulCapacity;
+   }
+
+   return psArray->pvRecords + ( ( size_t )ulSlot * psArray->ulRecordSize );
+}
+
+ERROR_CODE RecordArray_Reserve( RECORD_ARRAY * psArray, uint32_t ulCapacity )
+{
+   uint32_t ulNewCapacity = 0;
+   void * pvRecords = _null_;
+
+   RETURN_ON_NULL( psArray );
+   UTIL_ASSERT( psArray->ulRecordSize, INVALID_ARG );
+
+   if( ulCapacity <= psArray->ulCapacity )
+      return NO_ERROR;
+
+   ulNewCapacity = psArray->ulCapacity ? psArray->ulCapacity : RECORD_ARRAY_INITIAL_CAPACITY;
+   while( ulNewCapacity < ulCapacity )
+   {
+      // Stop doubling before it wraps around
+      ulNewCapacity = ( ulNewCapacity > UINT32_MAX / 2 ) ? ulCapacity : ulNewCapacity * 2;
+   }
+   UTIL_ASSERT( ( ( size_t )ulNewCapacity <= SIZE_MAX / psArray->ulRecordSize ), NO_MEMORY );
+
+   pvRecords = realloc( psArray->pvRecords, ( size_t )ulNewCapacity * psArray->ulRecordSize );
+   UTIL_ASSERT( pvRecords, NO_MEMORY );
+
+   // Records wrapped around the end of the old block are moved to the end of the new one
+   if( psArray->ulHead + psArray->ulCount > psArray->ulCapacity )
+   {
+      uint32_t ulWrapped = psArray->ulCapacity - psArray->ulHead;
+
+      memmove( pvRecords + ( ( size_t )( ulNewCapacity - ulWrapped ) * psArray->ulRecordSize ), 
+               pvRecords + ( ( size_t )psArray->ulHead * psArray->ulRecordSize ),
+               ( size_t )ulWrapped * psArray->ulRecordSize );
+      psArray->ulHead = ulNewCapacity - ulWrapped;
+   }
+
+   psArray->pvRecords = pvRecords;
+   psArray->ulCapacity = ulNewCapacity;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE RecordArray_Append( RECORD_ARRAY * psArray, const void * pvRecord, void ** ppvRecord )
+{
+   void * pvNew = _null_;
+
+   RETURN_ON_NULL( psArray );
+   UTIL_ASSERT( ( psArray->ulCount < UINT32_MAX ), NO_MEMORY );
+   RETURN_ON_FAIL( RecordArray_Reserve( psArray, psArray->ulCount + 1 ) );
+
+   pvNew = recordArraySlot( psArray, psArray->ulCount );
+   if( pvRecord )
+   {
+      memcpy( pvNew, pvRecord, psArray->ulRecordSize );
+   }
+   else
+   {
+      memset( pvNew, 0, psArray->ulRecordSize );
+   }
+   psArray->ulCount++;
+
+   if( ppvRecord )
+   {
+      *ppvRecord = pvNew;
+   }
+
+   return NO_ERROR;
+}
+
+ERROR_CODE RecordArray_Prepend( RECORD_ARRAY * psArray, const void * pvRecord )
+{
+   RETURN_ON_NULL( psArray );
+   RETURN_ON_NULL( pvRecord );
+   UTIL_ASSERT( ( psArray->ulCount < UINT32_MAX ), NO_MEMORY );
+   RETURN_ON_FAIL( RecordArray_Reserve( psArray, psArray->ulCount + 1 ) );
+
+   psArray->ulHead = ( psArray->ulHead == 0 ) ? psArray->ulCapacity - 1 : psArray->ulHead - 1;
+   memcpy( recordArraySlot( psArray, 0 ), pvRecord, psArray->ulRecordSize );
+   psArray->ulCount++;
+
+   return NO_ERROR;
+}
+
+void * RecordArray_Get( const RECORD_ARRAY * psArray, uint32_t ulIndex )
+{
+   if( psArray == _null_ || ulIndex >= psArray->ulCount )
+      return _null_;
+
+   return recordArraySlot( psArray, ulIndex );
+}
+
+ERROR_CODE RecordArray_Linearize( RECORD_ARRAY * psArray, void ** ppvRecords )
+{
+   RETURN_ON_NULL( psArray );
+   RETURN_ON_NULL( ppvRecords );
+
+   if( psArray->ulHead + psArray->ulCount > psArray->ulCapacity )
+   {
+      const size_t ulCapacitySize = ( size_t )psArray->ulCapacity * psArray->ulRecordSize;
+      const size_t ulWrappedSize = ( size_t )( psArray->ulCapacity - psArray->ulHead ) * psArray->ulRecordSize;
+      void * pvRecords = malloc( ulCapacitySize );
+
+      UTIL_ASSERT( pvRecords, NO_MEMORY );
+      memcpy( pvRecords, recordArraySlot( psArray, 0 ), ulWrappedSize );
+      memcpy( pvRecords + ulWrappedSize, psArray->pvRecords, ( size_t )psArray->ulCount * psArray->ulRecordSize - ulWrappedSize );
+      free( psArray->pvRecords );
+      psArray->pvRecords = pvRecords;
+      psArray->ulHead = 0;
+   }
+
+   *ppvRecords = ( psArray->ulCount > 0 ) ? recordArraySlot( psArray, 0 ) : _null_;
+
+   return NO_ERROR;
+}
+
+void RecordArray_Clear( RECORD_ARRAY * psArray )
+{
+   if( psArray )
+   {
+      psArray->ulCount = 0;
+      psArray->ulHead = 0;
+   }
+}
+
+void RecordArray_Free( RECORD_ARRAY * psArray )
+{
+   if( psArray )
+   {
+      free( psArray->pvRecords );
+      psArray->pvRecords = _null_;
+      psArray->ulCount = 0;
+      psArray->ulCapacity = 0;
+      psArray->ulHead = 0;
+   }
+}
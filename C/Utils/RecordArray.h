@@ -0,0 +1,86 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef RECORD_ARRAY_H
+#define RECORD_ARRAY_H
+
+#include "Utils.h"
+
+/*
+    Growable array of fixed size records, held in a single block of memory used as a ring buffer
+    Records can be added at either end in amortised O(1), the block grows geometrically
+    Records are only addressed through their index, they aren't contiguous in memory
+    ulRecordSize has to be set before the first record is added, the rest starts zeroed
+ */
+typedef struct
+{
+    void * pvRecords;
+    uint32_t ulRecordSize;
+    uint32_t ulCount;
+    uint32_t ulCapacity;
+    // Position of record 0 in pvRecords
+    uint32_t ulHead;
+} RECORD_ARRAY;
+
+/*
+    Makes sure the array can hold a number of records without growing
+    @param psArray[IN/OUT]: Array
+    @param ulCapacity[IN]: Number of records
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Array couldn't be grown, it is left as it was
+ */
+ERROR_CODE RecordArray_Reserve( RECORD_ARRAY * psArray, uint32_t ulCapacity );
+
+/*
+    Adds a record at the end of the array
+    @param psArray[IN/OUT]: Array
+    @param pvRecord[IN]: Record to be copied, NULL adds a zeroed record
+    @param ppvRecord[OUT]: Optional, the record in the array. Only valid until the array grows
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Array couldn't be grown
+ */
+ERROR_CODE RecordArray_Append( RECORD_ARRAY * psArray, const void * pvRecord, void ** ppvRecord );
+
+/*
+    Adds a record at index 0, the index of every other record goes up by one
+    Nothing is moved, the head of the ring buffer goes back by one record
+    @param psArray[IN/OUT]: Array
+    @param pvRecord[IN]: Record to be copied
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Array couldn't be grown
+ */
+ERROR_CODE RecordArray_Prepend( RECORD_ARRAY * psArray, const void * pvRecord );
+
+/*
+    Gets a record
+    @param psArray[IN]: Array
+    @param ulIndex[IN]: Index of the record
+    @return Record or NULL if ulIndex is out of range
+ */
+void * RecordArray_Get( const RECORD_ARRAY * psArray, uint32_t ulIndex );
+
+/*
+    Makes the records contiguous, index 0 first, e.g. to pass them on as a plain array
+    Nothing is moved if the array was only appended to since it was cleared
+    @param psArray[IN/OUT]: Array
+    @param ppvRecords[OUT]: First record, valid until the array is changed. NULL if the array is empty
+    @return NO_ERROR: Success
+    @return NO_MEMORY: Records couldn't be moved, the array is left as it was
+ */
+ERROR_CODE RecordArray_Linearize( RECORD_ARRAY * psArray, void ** ppvRecords );
+
+/*
+    Removes every record, the memory is kept for reuse
+    @param psArray[IN/OUT]: Array
+ */
+void RecordArray_Clear( RECORD_ARRAY * psArray );
+
+/*
+    Frees the memory of the array, ulRecordSize is kept so the array can be reused
+    @param psArray[IN/OUT]: Array
+ */
+void RecordArray_Free( RECORD_ARRAY * psArray );
+
+#endif
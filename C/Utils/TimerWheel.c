@@ -0,0 +1,166 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#include "TimerWheel.h"
+
+// Static Functions
+static void timerWheelLink( TIMER_WHEEL * psWheel, TIMER * psTimer );
+static void timerWheelUnlink( TIMER_WHEEL * psWheel, TIMER * psTimer );
+static TIMER * timerWheelDue( const TIMER_WHEEL * psWheel, uint64_t ullTick );
+
+/*
+    Appends a timer to its slot, timers of the same tick expire in the order they were scheduled
+ */
+static void timerWheelLink( TIMER_WHEEL * psWheel, TIMER * psTimer )
+{
+   const uint32_t ulSlot = ( uint32_t )( psTimer->ullExpiry % TIMER_WHEEL_SLOTS );
+
+   psTimer->psNext = _null_;
+   psTimer->psPrev = psWheel->apsTails[ulSlot];
+   if( psTimer->psPrev )
+   {
+      psTimer->psPrev->psNext = psTimer;
+   }
+   else
+   {
+      psWheel->apsHeads[ulSlot] = psTimer;
+   }
+   psWheel->apsTails[ulSlot] = psTimer;
+   psTimer->bScheduled = true;
+   psWheel->ulTimers++;
+}
+
+static void timerWheelUnlink( TIMER_WHEEL * psWheel, TIMER * psTimer )
+{
+   const uint32_t ulSlot = ( uint32_t )( psTimer->ullExpiry % TIMER_WHEEL_SLOTS );
+
+   if( psTimer->psPrev )
+   {
+      psTimer->psPrev->psNext = psTimer->psNext;
+   }
+   else
+   {
+      psWheel->apsHeads[ulSlot] = psTimer->psNext;
+   }
+   if( psTimer->psNext )
+   {
+      psTimer->psNext->psPrev = psTimer->psPrev;
+   }
+   else
+   {
+      psWheel->apsTails[ulSlot] = psTimer->psPrev;
+   }
+   psTimer->psPrev = _null_;
+   psTimer->psNext = _null_;
+   psTimer->bScheduled = false;
+   psWheel->ulTimers--;
+}
+
+/*
+    First timer of a tick's slot which is due by that tick, the slot also holds timers of later turns
+ */
+static TIMER * timerWheelDue( const TIMER_WHEEL * psWheel, uint64_t ullTick )
+{
+   TIMER * psTimer = psWheel->apsHeads[ullTick % TIMER_WHEEL_SLOTS];
+
+   while( psTimer && psTimer->ullExpiry > ullTick )
+   {
+      psTimer = psTimer->psNext;
+   }
+
+   return psTimer;
+}
+
+ERROR_CODE TimerWheel_Init( TIMER_WHEEL * psWheel, time_t tNow, uint32_t ulTickSeconds )
+{
+   RETURN_ON_NULL( psWheel );
+   UTIL_ASSERT( ( ulTickSeconds > 0 ), INVALID_ARG );
+
+   memset( psWheel, 0, sizeof( TIMER_WHEEL ) );
+   psWheel->ulTickSeconds = ulTickSeconds;
+   psWheel->ullTick = ( uint64_t )tNow / ulTickSeconds;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE TimerWheel_Schedule( TIMER_WHEEL * psWheel, TIMER * psTimer, time_t tWhen, TIMER_CALLBACK pfnCallback, void * pvUserData )
+{
+   uint64_t ullExpiry = 0;
+
+   RETURN_ON_NULL( psWheel );
+   RETURN_ON_NULL( psTimer );
+   RETURN_ON_NULL( pfnCallback );
+
+   TimerWheel_Cancel( psWheel, psTimer );
+
+   // Rounded up so that a timer never expires early
+   ullExpiry = ( ( uint64_t )( tWhen > 0 ? tWhen : 0 ) + psWheel->ulTickSeconds - 1 ) / psWheel->ulTickSeconds;
+   psTimer->ullExpiry = ( ullExpiry > psWheel->ullTick ) ? ullExpiry : psWheel->ullTick;
+   psTimer->pfnCallback = pfnCallback;
+   psTimer->pvUserData = pvUserData;
+   timerWheelLink( psWheel, psTimer );
+
+   return NO_ERROR;
+}
+
+void TimerWheel_Cancel( TIMER_WHEEL * psWheel, TIMER * psTimer )
+{
+   if( psWheel && psTimer && psTimer->bScheduled )
+   {
+      timerWheelUnlink( psWheel, psTimer );
+   }
+}
+
+uint32_t TimerWheel_Advance( TIMER_WHEEL * psWheel, time_t tNow )
+{
+   uint64_t ullTarget = 0;
+   uint32_t ulExpired = 0;
+
+   if( !psWheel || tNow < 0 )
+      return 0;
+
+   ullTarget = ( uint64_t )tNow / psWheel->ulTickSeconds;
+   for( ; psWheel->ullTick <= ullTarget; psWheel->ullTick++ )
+   {
+      TIMER * psTimer = _null_;
+
+      // Nothing to look at until the next timer's tick
+      if( psWheel->ulTimers == 0 )
+      {
+         psWheel->ullTick = ullTarget;
+         continue;
+      }
+
+      // The slot is looked at again after every callback, which may have changed it
+      while( ( psTimer = timerWheelDue( psWheel, psWheel->ullTick ) ) )
+      {
+         timerWheelUnlink( psWheel, psTimer );
+         psTimer->pfnCallback( psWheel, psTimer, psTimer->pvUserData );
+         ulExpired++;
+      }
+   }
+
+   return ulExpired;
+}
+
+ERROR_CODE TimerWheel_NextExpiry( const TIMER_WHEEL * psWheel, time_t * ptWhen )
+{
+   uint64_t ullEarliest = UINT64_MAX;
+
+   RETURN_ON_NULL( psWheel );
+   RETURN_ON_NULL( ptWhen );
+   UTIL_ASSERT( ( psWheel->ulTimers > 0 ), NOT_FOUND );
+
+   for( uint32_t x = 0; x < TIMER_WHEEL_SLOTS; x++ )
+   {
+      for( const TIMER * psTimer = psWheel->apsHeads[x]; psTimer; psTimer = psTimer->psNext )
+      {
+         ullEarliest = ( psTimer->ullExpiry < ullEarliest ) ? psTimer->ullExpiry : ullEarliest;
+      }
+   }
+   *ptWhen = ( time_t )( ullEarliest * psWheel->ulTickSeconds );
+
+   return NO_ERROR;
+}
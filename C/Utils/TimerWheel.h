@@ -0,0 +1,104 @@
+/*
+    Author: Mayur Wadhwani
+    Created: Feb 2020
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "Utils.h"
+
+// Slots of a wheel, timers further away than a full turn wait for their turn in their slot
+#define TIMER_WHEEL_SLOTS ( 64 )
+
+typedef struct TIMER TIMER;
+typedef struct TIMER_WHEEL TIMER_WHEEL;
+
+/*
+    Called when a timer expires, the timer isn't scheduled anymore & can be scheduled again
+    @param psWheel[IN/OUT]: Wheel the timer was scheduled on
+    @param psTimer[IN/OUT]: Timer which expired
+    @param pvUserData[IN]: As passed to TimerWheel_Schedule
+ */
+typedef void ( *TIMER_CALLBACK )( TIMER_WHEEL * psWheel, TIMER * psTimer, void * pvUserData );
+
+/*
+    Timer owned by the caller, it mustn't move or be freed while it is scheduled
+    A zeroed TIMER isn't scheduled, its fields are internal
+ */
+struct TIMER
+{
+    TIMER * psPrev;
+    TIMER * psNext;
+    // Tick the timer expires at
+    uint64_t ullExpiry;
+    TIMER_CALLBACK pfnCallback;
+    void * pvUserData;
+    bool bScheduled;
+};
+
+/*
+    Hashed timer wheel, every timer sits in the slot of its expiry tick so that scheduling,
+    cancelling & expiring a timer doesn't depend on the number of timers
+    Timers expire on the tick after their time, never before it
+    Initialise it with TimerWheel_Init
+ */
+struct TIMER_WHEEL
+{
+    // Timers of every slot, in the order they were scheduled
+    TIMER * apsHeads[TIMER_WHEEL_SLOTS];
+    TIMER * apsTails[TIMER_WHEEL_SLOTS];
+    // Next tick to be looked at, the ones before it have expired
+    uint64_t ullTick;
+    uint32_t ulTickSeconds;
+    uint32_t ulTimers;
+};
+
+/*
+    Sets up an empty wheel
+    @param psWheel[OUT]: Wheel
+    @param tNow[IN]: Current time
+    @param ulTickSeconds[IN]: Length of a tick, i.e. how late a timer can expire
+    @return NO_ERROR: Success
+    @return INVALID_ARG: Tick is 0
+ */
+ERROR_CODE TimerWheel_Init( TIMER_WHEEL * psWheel, time_t tNow, uint32_t ulTickSeconds );
+
+/*
+    Schedules a timer, a timer which is already scheduled is moved
+    @param psWheel[IN/OUT]: Wheel
+    @param psTimer[IN/OUT]: Timer, zeroed or scheduled on this wheel
+    @param tWhen[IN]: Time the timer expires at, a time already past expires as soon as the wheel is advanced
+    @param pfnCallback[IN]: Called when the timer expires
+    @param pvUserData[IN]: Passed on to pfnCallback
+    @return NO_ERROR: Success
+ */
+ERROR_CODE TimerWheel_Schedule( TIMER_WHEEL * psWheel, TIMER * psTimer, time_t tWhen, TIMER_CALLBACK pfnCallback, void * pvUserData );
+
+/*
+    Stops a timer from expiring
+    @param psWheel[IN/OUT]: Wheel
+    @param psTimer[IN/OUT]: Timer, nothing is done if it isn't scheduled
+ */
+void TimerWheel_Cancel( TIMER_WHEEL * psWheel, TIMER * psTimer );
+
+/*
+    Expires every timer due by tNow, earliest first. Callbacks can schedule & cancel timers
+    @param psWheel[IN/OUT]: Wheel
+    @param tNow[IN]: Current time
+    @return Number of timers which expired
+ */
+uint32_t TimerWheel_Advance( TIMER_WHEEL * psWheel, time_t tNow );
+
+/*
+    Gets the time the next timer expires at, e.g. to sleep until then
+    @param psWheel[IN]: Wheel
+    @param ptWhen[OUT]: Time of the earliest timer, rounded up to its tick
+    @return NO_ERROR: Success
+    @return NOT_FOUND: No timer is scheduled
+ */
+ERROR_CODE TimerWheel_NextExpiry( const TIMER_WHEEL * psWheel, time_t * ptWhen );
+
+#endif
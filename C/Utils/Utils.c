@@ -4,11 +4,20 @@
 */
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
 #include <time.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <strings.h>
 #include "Utils.h"
 
+#define TEMP_FILE_SUFFIX ( ".tmp" )
+
+static FILE_SYNC_POLICY s_eSyncPolicy = FILE_SYNC_FILE;
+
 ERROR_CODE Strcpy_safe( char* pszDest, const char* pszSrc, uint32_t ulBufferSize )
 {
    uint32_t ulCopySize = 0;
@@ -50,6 +59,229 @@ ERROR_CODE GenerateFileName(char* pszFileName, uint32_t ulBufferSize)
     return NO_ERROR;
 }
 
+// Days between 1970-01-01 & a date of the proleptic Gregorian calendar
+static int64_t daysFromCivil( int64_t llYear, uint32_t ulMonth, uint32_t ulDay )
+{
+   const int64_t llEra = ( llYear - ( ulMonth <= 2 ) ) / 400 - ( ( llYear - ( ulMonth <= 2 ) ) < 0 );
+   const int64_t llYearOfEra = llYear - ( ulMonth <= 2 ) - llEra * 400;
+   const int64_t llDayOfYear = ( 153 * ( ulMonth > 2 ? ulMonth - 3 : ulMonth + 9 ) + 2 ) / 5 + ulDay - 1;
+   const int64_t llDayOfEra = llYearOfEra * 365 + llYearOfEra / 4 - llYearOfEra / 100 + llDayOfYear;
+
+   return llEra * 146097 + llDayOfEra - 719468;
+}
+
+ERROR_CODE ParseRfc822Date( const char *pszDate, time_t *ptTime )
+{
+   static const char *apszMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+   static const struct { const char *pszZone; int32_t lOffset; } asZones[] =
+   {
+      { "GMT", 0 }, { "UT", 0 }, { "UTC", 0 }, { "Z", 0 },
+      { "EST", -500 }, { "EDT", -400 }, { "CST", -600 }, { "CDT", -500 },
+      { "MST", -700 }, { "MDT", -600 }, { "PST", -800 }, { "PDT", -700 }
+   };
+   char szMonth[3 + 1] = { 0, }, szZone[5 + 1] = { 0, };
+   uint32_t ulDay = 0, ulMonth = 0, ulHour = 0, ulMinute = 0, ulSecond = 0;
+   int32_t lYear = 0, lOffset = 0;
+   int iRead = 0;
+   const char *pszComma = _null_;
+
+   RETURN_ON_NULL( pszDate );
+   RETURN_ON_NULL( ptTime );
+
+   // The day of the week is only there for humans
+   pszComma = strchr( pszDate, ',' );
+   pszDate = pszComma ? pszComma + 1 : pszDate;
+
+   UTIL_ASSERT( ( sscanf( pszDate, " %u %3s %d %u:%u%n", &ulDay, szMonth, &lYear, &ulHour, &ulMinute, &iRead ) == 5 ), INVALID_ARG );
+   pszDate += iRead;
+   if( *pszDate == ':' )
+   {
+      UTIL_ASSERT( ( sscanf( pszDate, ":%u%n", &ulSecond, &iRead ) == 1 ), INVALID_ARG );
+      pszDate += iRead;
+   }
+
+   for( ulMonth = 0; ulMonth < ARRAY_COUNT( apszMonths ) && strcasecmp( szMonth, apszMonths[ulMonth] ) != 0; ulMonth++ );
+   UTIL_ASSERT( ( ulMonth < ARRAY_COUNT( apszMonths ) ), INVALID_ARG );
+   UTIL_ASSERT( ( ulDay >= 1 && ulDay <= 31 && ulHour < 24 && ulMinute < 60 && ulSecond <= 60 ), INVALID_ARG );
+
+   // Two digit years, see RFC-2822 4.3
+   if( lYear < 50 )
+   {
+      lYear += 2000;
+   }
+   else if( lYear < 1000 )
+   {
+      lYear += 1900;
+   }
+
+   // A missing zone is taken as UTC
+   if( sscanf( pszDate, " %5s", szZone ) == 1 )
+   {
+      if( szZone[0] == '+' || szZone[0] == '-' )
+      {
+         lOffset = atol( szZone + 1 );
+         UTIL_ASSERT( ( strlen( szZone ) == 5 && lOffset % 100 < 60 ), INVALID_ARG );
+         lOffset = ( szZone[0] == '-' ) ? -lOffset : lOffset;
+      }
+      else
+      {
+         uint32_t ulZone = 0;
+
+         for( ulZone = 0; ulZone < ARRAY_COUNT( asZones ) && strcasecmp( szZone, asZones[ulZone].pszZone ) != 0; ulZone++ );
+         UTIL_ASSERT( ( ulZone < ARRAY_COUNT( asZones ) ), INVALID_ARG );
+         lOffset = asZones[ulZone].lOffset;
+      }
+   }
+
+   *ptTime = ( time_t )( daysFromCivil( lYear, ulMonth + 1, ulDay ) * 86400 +
+                         ulHour * 3600 + ulMinute * 60 + ulSecond -
+                         ( lOffset / 100 ) * 3600 - ( lOffset % 100 ) * 60 );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE FormatRfc822Date( time_t tTime, char *pszDate, uint32_t ulBufferSize )
+{
+   static const char *apszDays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+   static const char *apszMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+   struct tm sTime = { 0, };
+
+   RETURN_ON_NULL( pszDate );
+   UTIL_ASSERT( ( ulBufferSize >= RFC822_DATE_SIZE ), INVALID_ARG );
+   UTIL_ASSERT( gmtime_r( &tTime, &sTime ), INVALID_ARG );
+
+   // Not strftime, the names mustn't depend on the locale
+   snprintf( pszDate, ulBufferSize, "%s, %02d %s %04d %02d:%02d:%02d +0000", 
+             apszDays[sTime.tm_wday], sTime.tm_mday, apszMonths[sTime.tm_mon], sTime.tm_year + 1900,
+             sTime.tm_hour, sTime.tm_min, sTime.tm_sec );
+
+   return NO_ERROR;
+}
+
+void SetFileSyncPolicy( FILE_SYNC_POLICY ePolicy )
+{
+   s_eSyncPolicy = ePolicy;
+}
+
+/* 
+    Flushes the directory holding a file, so that a rename in it is on the disk
+ */
+static ERROR_CODE SyncDirectory( const char *pszFileName )
+{
+   const char *pszSlash = strrchr( pszFileName, '/' );
+   char *pszDirectory = _null_;
+   int iFd = -1;
+
+   if( pszSlash == _null_ )
+   {
+      iFd = open( ".", O_RDONLY );
+   }
+   else
+   {
+      pszDirectory = strndup( pszFileName, ( pszSlash == pszFileName ) ? 1 : ( size_t )( pszSlash - pszFileName ) );
+      UTIL_ASSERT( pszDirectory, NO_MEMORY );
+      iFd = open( pszDirectory, O_RDONLY );
+      free( pszDirectory );
+   }
+   UTIL_ASSERT( ( iFd >= 0 ), FILE_ERROR );
+
+   if( fsync( iFd ) != 0 )
+   {
+      close( iFd );
+      return FILE_ERROR;
+   }
+   close( iFd );
+
+   return NO_ERROR;
+}
+
+ERROR_CODE AtomicFile_Open( ATOMIC_FILE *psFile, const char *pszFileName )
+{
+   size_t ulNameSize = 0;
+
+   RETURN_ON_NULL( psFile );
+   RETURN_ON_NULL( pszFileName );
+
+   // The old file is only replaced once the new one is complete
+   ulNameSize = strlen( pszFileName ) + sizeof( TEMP_FILE_SUFFIX );
+   psFile->pszTempName = malloc( ulNameSize );
+   UTIL_ASSERT( psFile->pszTempName, NO_MEMORY );
+   snprintf( psFile->pszTempName, ulNameSize, "%s%s", pszFileName, TEMP_FILE_SUFFIX );
+   psFile->pszFileName = pszFileName;
+
+   psFile->iFd = open( psFile->pszTempName, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+   if( psFile->iFd < 0 )
+   {
+      DBG_PRINTF( "Couldn't create [%s]", psFile->pszTempName );
+      free( psFile->pszTempName );
+      psFile->pszTempName = _null_;
+      return FILE_ERROR;
+   }
+
+   return NO_ERROR;
+}
+
+ERROR_CODE AtomicFile_Close( ATOMIC_FILE *psFile, ERROR_CODE eResult )
+{
+   ERROR_CODE eRet = eResult;
+
+   RETURN_ON_NULL( psFile );
+   RETURN_ON_NULL( psFile->pszTempName );
+
+   if( !ISERROR( eRet ) && s_eSyncPolicy != FILE_SYNC_NONE && fsync( psFile->iFd ) != 0 )
+   {
+      eRet = FILE_ERROR;
+   }
+   if( close( psFile->iFd ) != 0 && !ISERROR( eRet ) )
+   {
+      eRet = FILE_ERROR;
+   }
+   if( !ISERROR( eRet ) && rename( psFile->pszTempName, psFile->pszFileName ) != 0 )
+   {
+      eRet = FILE_ERROR;
+   }
+   if( ISERROR( eRet ) )
+   {
+      DBG_PRINTF( "Couldn't write [%s], the old file is kept", psFile->pszFileName );
+      unlink( psFile->pszTempName );
+   }
+   free( psFile->pszTempName );
+   psFile->pszTempName = _null_;
+   psFile->iFd = -1;
+
+   if( !ISERROR( eRet ) && s_eSyncPolicy == FILE_SYNC_FULL )
+   {
+      eRet = SyncDirectory( psFile->pszFileName );
+   }
+
+   return eRet;
+}
+
+ERROR_CODE WriteFileAtomic( const char *pszFileName, const void *pvData, size_t ulSize )
+{
+   ATOMIC_FILE sFile = { 0, };
+   ERROR_CODE eRet = NO_ERROR;
+   size_t ulWritten = 0;
+
+   RETURN_ON_NULL( pszFileName );
+   UTIL_ASSERT( ( pvData || ulSize == 0 ), INVALID_ARG );
+   eRet = AtomicFile_Open( &sFile, pszFileName );
+   RETURN_ON_FAIL( eRet );
+
+   while( ulWritten < ulSize )
+   {
+      ssize_t lRet = write( sFile.iFd, pvData + ulWritten, ulSize - ulWritten );
+
+      if( lRet < 0 && errno == EINTR )
+         continue;
+      if( lRet <= 0 )
+         break;
+      ulWritten += ( size_t )lRet;
+   }
+
+   return AtomicFile_Close( &sFile, ( ulWritten < ulSize ) ? FILE_ERROR : NO_ERROR );
+}
+
 void Dbg_printf( const char *pszFunc, int iLine, char *pszFormat, ... )
 {
    char szBuffer[4096 + 1] = { 0, };
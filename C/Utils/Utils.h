@@ -10,8 +10,11 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 
 #define MAX_FILENAME_LEN 16
+// "Tue, 10 Mar 2020 13:00:00 +0000" & the NULL terminator
+#define RFC822_DATE_SIZE 32
 
 /* 
     ERROR CODES to be used internally
@@ -25,6 +28,10 @@ typedef enum
     NOT_FOUND,                  // Missing
     TEST_FAILED,                // Test failed
     OVERFLOW,                   // Array or structure full, need to expand
+    NO_MEMORY,                  // Memory allocation failed
+    NETWORK_ERROR,              // Download failed
+    STOPPED,                    // Stopped early on purpose, the rest of the input wasn't needed
+    NOT_MODIFIED,               // Download skipped, the file hasn't changed since it was last downloaded
 } ERROR_CODE;
 
 #define _null_ 0
@@ -69,6 +76,31 @@ typedef enum
 
 #define ARRAY_COUNT(x) sizeof(x) / sizeof(x[0])
 
+/* 
+    How far a file replaced through AtomicFile_Open/AtomicFile_Close goes to survive a crash or a power loss
+    A file is always written to "<name>.tmp" first & renamed over the old one, so a crash in the
+    middle of a write leaves either the old or the new file, never a truncated one
+ */
+typedef enum
+{
+    // Rename only, the new file can be lost on a power loss until the OS writes it out
+    FILE_SYNC_NONE,
+    // The file is flushed to the disk before it is renamed, the default
+    FILE_SYNC_FILE,
+    // Same as FILE_SYNC_FILE, the directory is flushed after the rename as well
+    FILE_SYNC_FULL
+} FILE_SYNC_POLICY;
+
+/* 
+    File being replaced, the new contents are written to iFd
+ */
+typedef struct
+{
+    const char *pszFileName;
+    char *pszTempName;
+    int iFd;
+} ATOMIC_FILE;
+
 /* 
     Safe Strcpy function to prevent buffer overflow
     @param[OUT] pszDest: Destination buffer pointer
@@ -89,6 +121,72 @@ ERROR_CODE Strcpy_safe(char *pszDest, const char *pszSrc, uint32_t ulBufferSize)
  */
 ERROR_CODE GenerateFileName(char *pszFileName, uint32_t ulBufferSize);
 
+/* 
+    Converts an RFC-822 date, as used by RSS feeds, to a UTC timestamp
+    Eg: "Tue, 10 Mar 2020 18:30:00 +0530". The day of the week & the seconds are optional
+    @param[IN]  pszDate: Date to be converted
+    @param[OUT] ptTime:  Seconds since the epoch
+
+    @return: NO_ERROR: Success
+    @return: INVALID_ARG: If args are invalid or the date can't be parsed
+ */
+ERROR_CODE ParseRfc822Date(const char *pszDate, time_t *ptTime);
+
+/* 
+    Formats a UTC timestamp as an RFC-822 date, Eg: "Tue, 10 Mar 2020 13:00:00 +0000"
+    @param[IN]  tTime: Seconds since the epoch
+    @param[OUT] pszDate: Formatted date
+    @param[IN]  ulBufferSize: Size of pszDate, RFC822_DATE_SIZE is enough
+
+    @return: NO_ERROR: Success
+    @return: INVALID_ARG: If args are invalid or the buffer is too small
+ */
+ERROR_CODE FormatRfc822Date(time_t tTime, char *pszDate, uint32_t ulBufferSize);
+
+/* 
+    Sets the sync policy of every following AtomicFile_Close & WriteFileAtomic
+    @param[IN] ePolicy: New policy
+ */
+void SetFileSyncPolicy(FILE_SYNC_POLICY ePolicy);
+
+/* 
+    Starts replacing a file, the new contents are written to psFile->iFd until AtomicFile_Close
+    @param[OUT] psFile: File being replaced
+    @param[IN] pszFileName: File to be replaced, kept until AtomicFile_Close
+
+    @return: NO_ERROR: Success
+    @return: INVALID_ARG: If args are invalid
+    @return: NO_MEMORY: Allocation failed
+    @return: FILE_ERROR: The temp file couldn't be created
+ */
+ERROR_CODE AtomicFile_Open(ATOMIC_FILE *psFile, const char *pszFileName);
+
+/* 
+    Replaces the file with the contents written so far, following the sync policy. On an error the
+    contents are dropped & the old file is kept
+    @param[IN] psFile: File opened with AtomicFile_Open
+    @param[IN] eResult: Result of writing the contents, the file is only replaced on NO_ERROR
+
+    @return: NO_ERROR: Success
+    @return: INVALID_ARG: If args are invalid
+    @return: FILE_ERROR: File couldn't be written, the old one is kept
+    @return: eResult: When eResult is an error
+ */
+ERROR_CODE AtomicFile_Close(ATOMIC_FILE *psFile, ERROR_CODE eResult);
+
+/* 
+    Replaces a file with a buffer through AtomicFile_Open/AtomicFile_Close, so the file is either
+    the old one or the new one after a crash
+    @param[IN] pszFileName: File to be replaced
+    @param[IN] pvData: Contents of the file
+    @param[IN] ulSize: Size of pvData
+
+    @return: NO_ERROR: Success
+    @return: INVALID_ARG: If args are invalid
+    @return: FILE_ERROR: File couldn't be written, the old one is kept
+ */
+ERROR_CODE WriteFileAtomic(const char *pszFileName, const void *pvData, size_t ulSize);
+
 /* 
     NOT TO BE CALLED DIRECTLY. USE DBG_PRINTF() macro
     Prints internal Debug 
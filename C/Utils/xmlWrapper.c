@@ -3,443 +3,1757 @@
     Created: January 2020
 */
 
-#include <libxml/xpath.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libxml/parser.h>
+#include <libxml/SAX2.h>
+#include <libxml/xmlreader.h>
+#include <libxml/hash.h>
 #include <libxml/xmlstring.h>
 #include <libxml/encoding.h>
 #include <libxml/xmlwriter.h>
+#include <libxml/xmlIO.h>
 #include "xmlWrapper.h"
 
 // Defines
 #define XML_DEBUG ( 0 )
+#define XML_NO_CONTEXT ( -1 )
+#define XML_NO_RULE ( -1 )
+#define XML_CONTEXT_STACK_INCREMENT ( 16 )
+// Longest text kept for a numeric or date element, longer text can't be a valid value
+#define XML_CAPTURE_TEXT_SIZE ( 64 )
+// Entities are left unexpanded so a feed can't pull in local files through an external entity
+#if LIBXML_VERSION >= 21300
+#define XML_READER_OPTIONS ( XML_PARSE_NOBLANKS | XML_PARSE_NONET | XML_PARSE_NO_XXE )
+#else
+#define XML_READER_OPTIONS ( XML_PARSE_NOBLANKS | XML_PARSE_NONET )
+#endif
 
+/* 
+    XML_TABLE, XML_SUB_ARRAY or XML_SUB_DYNAMIC_ARRAY item, i.e. an element whose children are looked up
+ */
+typedef struct
+{
+   XML_TYPES eType;
+   // Offset of the table/array in the output structure
+   uint32_t ulMemberOffset;
+   // Only applicable for arrays, size of a single element of the array
+   uint32_t ulRecordSize;
+   // Only applicable for XML_SUB_ARRAY, number of elements in the array
+   uint32_t ulArraySize;
+} XML_SCHEMA_CONTEXT;
+
+/* 
+    Action taken when an element with a matching name opens
+ */
+typedef struct
+{
+   // Context the element has to be a direct child of, XML_NO_CONTEXT matches anywhere in the document
+   int32_t lParent;
+   // Context opened by this element, XML_NO_CONTEXT if the element's text is copied instead
+   int32_t lContext;
+   // Offset of the string in the output structure, relative to the array element for arrays
+   uint32_t ulMemberOffset;
+   uint32_t ulBufferSize;
+   // Next rule for the same element name or XML_NO_RULE
+   int32_t lNext;
+   // Only applicable when the text is copied, type of the output variable
+   XML_TYPES eType;
+} XML_SCHEMA_RULE;
+
+struct XML_SCHEMA
+{
+   // Element name -> first XML_SCHEMA_RULE for that name
+   xmlHashTablePtr pNames;
+   XML_SCHEMA_RULE *pasRules;
+   uint32_t ulRuleCount;
+   XML_SCHEMA_CONTEXT *pasContexts;
+   uint32_t ulContextCount;
+};
+
+/* 
+    State of a single streaming parse
+    The document is read forward once, every element is matched against the schema
+    as it opens and its text is copied straight into the output structure
+ */
+typedef struct
+{
+   const XML_SCHEMA *psSchema;
+   void *pvOutputStruct;
+   // Current element depth, 0 is outside of the root element
+   uint32_t ulDepth;
+   // Context opened at each depth or XML_NO_CONTEXT
+   int32_t *palContext;
+   uint32_t ulContextSize;
+   // Per context, number of array elements opened so far. The last one is the record being filled
+   uint32_t *paulRecordCount;
+   // Element whose text is currently being copied, NULL when not capturing
+   char *pszCapture;
+   uint32_t ulCaptureSize;
+   uint32_t ulCaptureLength;
+   uint32_t ulCaptureDepth;
+   // Output variable of the captured element. Strings are copied straight into it,
+   // other types are collected in szCaptureText & converted when the element closes
+   void *pvCaptureTarget;
+   XML_TYPES eCaptureType;
+   char szCaptureText[XML_CAPTURE_TEXT_SIZE];
+   // Optional, called every time an array element is complete
+   XML_RECORD_CALLBACK pfnOnRecord;
+   void *pvUserData;
+} XML_PARSE_STATE;
+
+struct XML_PUSH_PARSER
+{
+   XML_PARSE_STATE sState;
+   xmlParserCtxtPtr pCtxt;
+   // First error raised from within a SAX callback, the parser is stopped when it is set
+   ERROR_CODE eError;
+};
 
 // Static Functions
-static ERROR_CODE xmlWrapperExtractChildString( const xmlDocPtr pDoc, const XML_ITEM *psItem, void *pvOutputStruct, const xmlChar *pszPrefix, const xmlXPathContextPtr pContext );
-static xmlXPathObjectPtr xmlWrapperExtractNodeSetPtr( const xmlDocPtr pDoc, const char *pszPrefix, const char *pszElementName, const xmlXPathContextPtr pContext );
+static ERROR_CODE xmlWrapperAddRule( XML_SCHEMA *psSchema, const char *pszElementName, const XML_SCHEMA_RULE *psRule );
+static bool xmlWrapperIsArray( XML_TYPES eType );
+static bool xmlWrapperIsValidField( const XML_ITEM *psItem );
+static ERROR_CODE xmlWrapperStateInit( XML_PARSE_STATE *psState, const XML_SCHEMA *psSchema, void *pvOutputStruct );
+static void *xmlWrapperRecord( const XML_PARSE_STATE *psState, int32_t lContext, uint32_t ulRecord );
+static ERROR_CODE xmlWrapperNewRecord( XML_PARSE_STATE *psState, int32_t lContext, bool *pbSkipped );
+static void xmlWrapperStateFree( XML_PARSE_STATE *psState );
+static ERROR_CODE xmlWrapperOnStartElement( XML_PARSE_STATE *psState, const xmlChar *pszName );
+static void xmlWrapperOnText( XML_PARSE_STATE *psState, const xmlChar *pszText, uint32_t ulLength );
+static void xmlWrapperConvertCapture( XML_PARSE_STATE *psState );
+static ERROR_CODE xmlWrapperOnEndElement( XML_PARSE_STATE *psState );
+static void xmlWrapperSaxStartElement( void *pvCtx, const xmlChar *pszName, const xmlChar **ppszAttributes );
+static void xmlWrapperSaxEndElement( void *pvCtx, const xmlChar *pszName );
+static void xmlWrapperSaxCharacters( void *pvCtx, const xmlChar *pszText, int iLength );
+static void xmlWrapperSaxCheckError( XML_PUSH_PARSER *psParser, ERROR_CODE eRet );
+static ERROR_CODE xmlWrapperParseReader( xmlTextReaderPtr pReader, XML_PARSE_STATE *psState );
+static ERROR_CODE xmlWrapperParseOpenedReader( xmlTextReaderPtr pReader, const XML_SCHEMA *psSchema, void *pvOutputStruct );
+static bool xmlWrapperIsEmptyRecord( const XML_ITEM *psArray, const void *pvRecord );
+static uint32_t xmlWrapperUsedRecords( const XML_ITEM *psArray, const void *pvArray );
+static int xmlWrapperWriteField( xmlTextWriterPtr pWriter, const XML_ITEM *psField, const void *pvField );
+static ERROR_CODE xmlWrapperWriteDocument( xmlTextWriterPtr pWriter, const XML_ITEM *pasItems, uint32_t ulArraySize, const void *pvInputStruct );
 
 ////////////////////////////////////////////////////////////////
 
-static xmlXPathObjectPtr xmlWrapperExtractNodeSetPtr( const xmlDocPtr pDoc, const char *pszPrefix, const char *pszElementName, const xmlXPathContextPtr pContext )
+static bool xmlWrapperIsArray( XML_TYPES eType )
 {
-   xmlChar szKey[32+1] = { 0, };
+   return ( eType == XML_SUB_ARRAY || eType == XML_SUB_DYNAMIC_ARRAY );
+}
 
-   if( !pDoc || !pszElementName || !pszPrefix || !pContext )
-      return _null_;
-      
-   xmlStrPrintf( szKey, sizeof( szKey ), "%s/%s", pszPrefix, pszElementName );
-   
-   return xmlXPathEvalExpression( szKey, pContext );
+/* 
+    Child items whose text is copied, the output variable has to be able to hold the type
+ */
+static bool xmlWrapperIsValidField( const XML_ITEM *psItem )
+{
+   switch( psItem->eType )
+   {
+      case XML_CHILD_STRING: return ( psItem->ulBufferSize != 0 );
+      case XML_CHILD_U32:    return ( psItem->ulBufferSize == sizeof( uint32_t ) );
+      case XML_CHILD_TIME:   return ( psItem->ulBufferSize == sizeof( time_t ) );
+      default:               return false;
+   }
 }
 
-static ERROR_CODE xmlWrapperExtractChildString( const xmlDocPtr pDoc, const XML_ITEM *psItem, void *pvOutputStruct, const xmlChar *pszPrefix, const xmlXPathContextPtr pContext )
+static ERROR_CODE xmlWrapperAddRule( XML_SCHEMA *psSchema, const char *pszElementName, const XML_SCHEMA_RULE *psRule )
 {
-   RETURN_ON_NULL( pDoc );
-   RETURN_ON_NULL( psItem );
-   RETURN_ON_NULL( pvOutputStruct );
-   RETURN_ON_NULL( pszPrefix );
-   RETURN_ON_NULL( pContext );
+   XML_SCHEMA_RULE *psNew = &psSchema->pasRules[psSchema->ulRuleCount];
+   XML_SCHEMA_RULE *psFirst = _null_;
+
+   RETURN_ON_NULL( pszElementName );
 
-   xmlXPathObjectPtr pXpathObject = xmlWrapperExtractNodeSetPtr( pDoc, pszPrefix, psItem->pszElementName, pContext );
-   if( _null_ == pXpathObject || xmlXPathNodeSetIsEmpty( pXpathObject->nodesetval ) )
+   *psNew = *psRule;
+   psNew->lNext = XML_NO_RULE;
+
+   psFirst = xmlHashLookup( psSchema->pNames, BAD_CAST pszElementName );
+   if( psFirst == _null_ )
    {
-#if XML_DEBUG
-      DBG_PRINTF( "Not found" );
-#endif
-      memset( ( pvOutputStruct + psItem->ulMemberOffset ), 0, psItem->ulBufferSize );
+      UTIL_ASSERT( ( xmlHashAddEntry( psSchema->pNames, BAD_CAST pszElementName, psNew ) == 0 ), NO_MEMORY );
    }
-   else 
+   else
    {
-      xmlNodeSetPtr nodeset = pXpathObject->nodesetval;
-      for ( int i=0; i < nodeset->nodeNr; i++) 
+      // Rules are kept in XML_ITEM order
+      while( psFirst->lNext != XML_NO_RULE )
       {
-         xmlChar *pData = xmlNodeListGetString( pDoc, nodeset->nodeTab[i]->xmlChildrenNode, 1 );
-#if XML_DEBUG
-         DBG_PRINTF( "String found: [%s]", pData );
-#endif
-         Strcpy_safe( ( pvOutputStruct + psItem->ulMemberOffset ), pData, psItem->ulBufferSize );
-         xmlFree( pData );
-      } 
+         psFirst = &psSchema->pasRules[psFirst->lNext];
+      }
+      psFirst->lNext = ( int32_t )psSchema->ulRuleCount;
    }
-   xmlXPathFreeObject( pXpathObject );
+   psSchema->ulRuleCount++;
 
    return NO_ERROR;
 }
 
-ERROR_CODE xmlWrapperParseFile( const char *pszFileName, const XML_ITEM *pasItems, uint32_t ulArraySize, void *pvOutputStruct )
+ERROR_CODE xmlWrapperCompileSchema( const XML_ITEM *pasItems, uint32_t ulArraySize, XML_SCHEMA **ppsSchema )
 {
-   xmlDocPtr pDoc = _null_;
-   xmlNodePtr pNode = _null_;
-   xmlXPathContextPtr pContext = _null_ ;
+   ERROR_CODE eRet = NO_ERROR;
+   XML_SCHEMA *psSchema = _null_;
+   uint32_t ulRuleCount = 0, ulContextCount = 0;
 
-   RETURN_ON_NULL( pszFileName );
    RETURN_ON_NULL( pasItems );
-   RETURN_ON_NULL( pvOutputStruct );
+   RETURN_ON_NULL( ppsSchema );
    UTIL_ASSERT( ulArraySize != 0, INVALID_ARG );
+   *ppsSchema = _null_;
 
-   // Not sure what it does exactly, but adding it anyway
-   xmlKeepBlanksDefault(0);
-
-   pDoc = xmlParseFile( pszFileName );
-   if( !pDoc )
+   for( uint32_t ulCount = 0; ulCount < ulArraySize; ulCount++ )
    {
-      DBG_PRINTF( "File Couldn't be opened" );
-      return FILE_ERROR;
+      switch( pasItems[ulCount].eType )
+      {
+         case XML_CHILD_STRING: 
+         case XML_CHILD_U32:
+         case XML_CHILD_TIME:
+            UTIL_ASSERT( xmlWrapperIsValidField( &pasItems[ulCount] ), INVALID_ARG );
+            ulRuleCount++; 
+            break;
+
+         case XML_SUB_ARRAY:
+            UTIL_ASSERT( pasItems[ulCount].ulArraySize != 0, INVALID_ARG );
+            // fall through
+         case XML_SUB_DYNAMIC_ARRAY:
+            UTIL_ASSERT( pasItems[ulCount].ulBufferSize != 0, INVALID_ARG );
+            // fall through
+         case XML_TABLE:
+            RETURN_ON_NULL( pasItems[ulCount].pavSubItem );
+            UTIL_ASSERT( pasItems[ulCount].ulArrayElements != 0, INVALID_ARG );
+            for( uint32_t ulIndex = 0; ulIndex < pasItems[ulCount].ulArrayElements; ulIndex++ )
+            {
+               UTIL_ASSERT( xmlWrapperIsValidField( &( ( const XML_ITEM * )pasItems[ulCount].pavSubItem )[ulIndex] ), INVALID_ARG );
+            }
+            ulRuleCount += 1 + pasItems[ulCount].ulArrayElements;
+            ulContextCount++;
+            break;
+
+         default: DBG_PRINTF( "Unknown type or hasn't been implemented yet = [%d]", pasItems[ulCount].eType ); break;
+      }
    }
 
-   pContext = xmlXPathNewContext( pDoc );
-   if( _null_ == pContext )
+   psSchema = calloc( 1, sizeof( XML_SCHEMA ) );
+   UTIL_ASSERT( psSchema, NO_MEMORY );
+   psSchema->pNames = xmlHashCreate( ulRuleCount );
+   psSchema->pasRules = calloc( ulRuleCount + 1, sizeof( XML_SCHEMA_RULE ) );
+   psSchema->pasContexts = calloc( ulContextCount + 1, sizeof( XML_SCHEMA_CONTEXT ) );
+   if( !psSchema->pNames || !psSchema->pasRules || !psSchema->pasContexts )
    {
-      DBG_PRINTF( "XPathContext couldn't be inialized" );
+      xmlWrapperFreeSchema( psSchema );
+      return NO_MEMORY;
    }
-   else
+
+   for( uint32_t ulCount = 0; ulCount < ulArraySize && !ISERROR( eRet ); ulCount++ )
    {
-      /* code */
-      uint32_t ulCount = 0;
-      
-      while( ulCount < ulArraySize )
+      const XML_ITEM *psItem = &pasItems[ulCount];
+      XML_SCHEMA_RULE sRule = { XML_NO_CONTEXT, XML_NO_CONTEXT, psItem->ulMemberOffset, psItem->ulBufferSize, XML_NO_RULE, psItem->eType };
+
+      switch( psItem->eType )
       {
-         switch( pasItems[ulCount].eType )
+         case XML_CHILD_STRING: 
+         case XML_CHILD_U32:
+         case XML_CHILD_TIME:
+            eRet = xmlWrapperAddRule( psSchema, psItem->pszElementName, &sRule );
+            break;
+
+         case XML_TABLE:
+         case XML_SUB_ARRAY:
+         case XML_SUB_DYNAMIC_ARRAY:
          {
-            case XML_CHILD_STRING: 
-               RETURN_ON_FAIL( xmlWrapperExtractChildString( pDoc, &pasItems[ulCount], pvOutputStruct, "/", pContext ) );
-               break;
+            const XML_ITEM *pasTable = ( const XML_ITEM * )psItem->pavSubItem;
+            XML_SCHEMA_CONTEXT *psContext = &psSchema->pasContexts[psSchema->ulContextCount];
 
-            case XML_TABLE:
+            psContext->eType = psItem->eType;
+            psContext->ulMemberOffset = psItem->ulMemberOffset;
+            if( psItem->eType == XML_SUB_ARRAY )
             {
-               XML_ITEM *pasTable = ( XML_ITEM * )pasItems[ulCount].pavSubItem;
-               uint32_t ulIndex = 0, ulOffset = sizeof( XML_ITEM );
-               xmlChar szPrefix[32+1] = { 0, };
+               psContext->ulArraySize = psItem->ulArraySize;
+               psContext->ulRecordSize = psItem->ulBufferSize / psItem->ulArraySize;
+            }
+            else if( psItem->eType == XML_SUB_DYNAMIC_ARRAY )
+            {
+               psContext->ulRecordSize = psItem->ulBufferSize;
+            }
+
+            sRule.lContext = ( int32_t )psSchema->ulContextCount;
+            eRet = xmlWrapperAddRule( psSchema, psItem->pszElementName, &sRule );
 
-               RETURN_ON_NULL( pasTable );
-               UTIL_ASSERT( pasItems[ulCount].ulArrayElements != 0, INVALID_ARG );
+            for( uint32_t ulIndex = 0; ulIndex < psItem->ulArrayElements && !ISERROR( eRet ); ulIndex++ )
+            {
+               XML_SCHEMA_RULE sField = { ( int32_t )psSchema->ulContextCount, XML_NO_CONTEXT, pasTable[ulIndex].ulMemberOffset, pasTable[ulIndex].ulBufferSize, XML_NO_RULE, pasTable[ulIndex].eType };
 
-               while( ulIndex < pasItems[ulCount].ulArrayElements )
+               if( psItem->eType == XML_TABLE )
                {
-                  memset( szPrefix, 0, sizeof( szPrefix ) );
-                  xmlStrPrintf( szPrefix, sizeof( szPrefix ), "//%s", pasItems[ulCount].pszElementName );
-                  RETURN_ON_FAIL( xmlWrapperExtractChildString( pDoc, &pasTable[ulIndex], ( pvOutputStruct + pasItems[ulCount].ulMemberOffset ), szPrefix, pContext ) ); 
-                  ulIndex++;
+                  sField.ulMemberOffset += psItem->ulMemberOffset;
                }
+               eRet = xmlWrapperAddRule( psSchema, pasTable[ulIndex].pszElementName, &sField );
             }
-            break;
+            psSchema->ulContextCount++;
+         }
+         break;
 
-            case XML_SUB_ARRAY: 
-            {
-               // Not going to verify if all of the elements are from the same parent
-               XML_ITEM *pasTable = ( XML_ITEM * )pasItems[ulCount].pavSubItem;
-               uint32_t ulIndex = 0;
-               xmlChar szPrefix[32+1] = { 0, };
-               uint32_t ulSingleIndexSize = pasItems[ulCount].ulBufferSize / pasItems[ulCount].ulArraySize;
+         default: break;
+      }
+   }
 
-               RETURN_ON_NULL( pasTable );
-               UTIL_ASSERT( pasItems[ulCount].ulArrayElements != 0, INVALID_ARG );
+   if( ISERROR( eRet ) )
+   {
+      xmlWrapperFreeSchema( psSchema );
+      return eRet;
+   }
 
-               while( ulIndex < pasItems[ulCount].ulArrayElements )
-               {
-                  uint32_t ulInternalIndex = 0;
+   *ppsSchema = psSchema;
 
-                  memset( szPrefix, 0, sizeof( szPrefix ) );
+   return NO_ERROR;
+}
 
-                  xmlStrPrintf( szPrefix, sizeof( szPrefix ), "//%s", pasItems[ulCount].pszElementName );
-                  // Get xmlXPathObjectPtr
-                  xmlXPathObjectPtr pXpathObject = xmlWrapperExtractNodeSetPtr( pDoc, szPrefix, pasTable[ulIndex].pszElementName, pContext );
+void xmlWrapperFreeSchema( XML_SCHEMA *psSchema )
+{
+   if( psSchema == _null_ )
+      return;
 
-                  if( _null_ == pXpathObject || xmlXPathNodeSetIsEmpty( pXpathObject->nodesetval ) )
-                  {
-#if XML_DEBUG
-                     DBG_PRINTF( "Not found" );
-#endif
-                  }
-                  else
-                  {
-                     xmlNodeSetPtr nodeset = pXpathObject->nodesetval;
+   if( psSchema->pNames )
+   {
+      xmlHashFree( psSchema->pNames, _null_ );
+   }
+   free( psSchema->pasRules );
+   free( psSchema->pasContexts );
+   free( psSchema );
+}
 
-                     for ( int i=0; i < nodeset->nodeNr && i < pasItems[ulCount].ulArraySize; i++) 
-                     {
-                        xmlChar *pData = xmlNodeListGetString( pDoc, nodeset->nodeTab[i]->xmlChildrenNode, 1 );
-                        uint32_t ulOffset = pasItems[ulCount].ulMemberOffset + pasTable[ulIndex].ulMemberOffset + ( ulSingleIndexSize * i );
-                        if( _null_ != pData )
-                        {
-#if XML_DEBUG
-                           DBG_PRINTF( "String found: [%s]", pData );
-#endif
-                           Strcpy_safe( 
-                           ( pvOutputStruct + ulOffset ), 
-                           pData, 
-                           pasTable[ulIndex].ulBufferSize );
-                           xmlFree( pData );
-                        }
-                     }
-                  }
-                  
-                  ulIndex++;
-               }
-            }
-            break;
+static ERROR_CODE xmlWrapperStateInit( XML_PARSE_STATE *psState, const XML_SCHEMA *psSchema, void *pvOutputStruct )
+{
+   RETURN_ON_NULL( psState );
+   memset( psState, 0, sizeof( XML_PARSE_STATE ) );
 
-            default: DBG_PRINTF( "Unknown type or hasn't been implemented yet = [%d]", pasItems[ulCount].eType ); break;
-         }
-         ulCount++;
+   for( uint32_t ulCount = 0; ulCount < psSchema->ulRuleCount; ulCount++ )
+   {
+      const XML_SCHEMA_RULE *psRule = &psSchema->pasRules[ulCount];
+
+      // Fields which aren't found in the document are returned empty or 0, arrays are left as they are
+      if( psRule->lContext == XML_NO_CONTEXT && 
+          ( psRule->lParent == XML_NO_CONTEXT || psSchema->pasContexts[psRule->lParent].eType == XML_TABLE ) )
+      {
+         memset( ( pvOutputStruct + psRule->ulMemberOffset ), 0, psRule->ulBufferSize );
+      }
+   }
+
+   // Dynamic arrays only hold what this parse finds, their memory is reused
+   for( uint32_t ulCount = 0; ulCount < psSchema->ulContextCount; ulCount++ )
+   {
+      const XML_SCHEMA_CONTEXT *psContext = &psSchema->pasContexts[ulCount];
+
+      if( psContext->eType == XML_SUB_DYNAMIC_ARRAY )
+      {
+         RECORD_ARRAY *psArray = pvOutputStruct + psContext->ulMemberOffset;
+
+         UTIL_ASSERT( ( psArray->ulRecordSize == 0 || psArray->ulRecordSize == psContext->ulRecordSize ), INVALID_ARG );
+         psArray->ulRecordSize = psContext->ulRecordSize;
+         RecordArray_Clear( psArray );
       }
    }
-   
-   xmlFreeDoc( pDoc );
-   xmlCleanupParser();
+
+   psState->psSchema = psSchema;
+   psState->pvOutputStruct = pvOutputStruct;
+   psState->paulRecordCount = calloc( psSchema->ulContextCount + 1, sizeof( uint32_t ) );
+   UTIL_ASSERT( psState->paulRecordCount, NO_MEMORY );
 
    return NO_ERROR;
 }
 
-#define MY_ENCODING     "UTF-8"
-ERROR_CODE xmlWrapperWriteFile( const char *pszFileName, const XML_ITEM *pasItems, uint32_t ulArraySize, const void *pvInputStruct )
+static void xmlWrapperStateFree( XML_PARSE_STATE *psState )
 {
-   int iRet = 0;
-   xmlTextWriterPtr pWriter = _null_;
-   uint32_t ulCount = 0;
+   free( psState->palContext );
+   free( psState->paulRecordCount );
+   memset( psState, 0, sizeof( XML_PARSE_STATE ) );
+}
 
-   RETURN_ON_NULL( pszFileName );
-   RETURN_ON_NULL( pasItems );
-   RETURN_ON_NULL( pvInputStruct );
-   UTIL_ASSERT( ulArraySize != 0, INVALID_ARG );
+static void *xmlWrapperRecord( const XML_PARSE_STATE *psState, int32_t lContext, uint32_t ulRecord )
+{
+   const XML_SCHEMA_CONTEXT *psContext = &psState->psSchema->pasContexts[lContext];
+
+   if( psContext->eType == XML_SUB_DYNAMIC_ARRAY )
+   {
+      return RecordArray_Get( psState->pvOutputStruct + psContext->ulMemberOffset, ulRecord );
+   }
 
+   return psState->pvOutputStruct + psContext->ulMemberOffset + ( psContext->ulRecordSize * ulRecord );
+}
 
-   /* Create a new XmlWriter for uri, with no compression. */
-   pWriter = xmlNewTextWriterFilename(pszFileName, 0);
-   if (pWriter == NULL) {
-      DBG_PRINTF("Error creating the xml pWriter = [%d]", iRet );
-      return TEST_FAILED;
+/* 
+    Every array element starts a new, empty record. Elements past the size of an XML_SUB_ARRAY are skipped
+ */
+static ERROR_CODE xmlWrapperNewRecord( XML_PARSE_STATE *psState, int32_t lContext, bool *pbSkipped )
+{
+   const XML_SCHEMA_CONTEXT *psContext = &psState->psSchema->pasContexts[lContext];
+   uint32_t ulRecord = psState->paulRecordCount[lContext];
+
+   *pbSkipped = false;
+   if( psContext->eType == XML_SUB_DYNAMIC_ARRAY )
+   {
+      RECORD_ARRAY *psArray = psState->pvOutputStruct + psContext->ulMemberOffset;
+      void *pvOpenRecord = ( ulRecord > 0 ) ? RecordArray_Get( psArray, ulRecord - 1 ) : _null_;
+      bool bCaptureInRecord = ( pvOpenRecord && psState->pvCaptureTarget >= pvOpenRecord && 
+                                psState->pvCaptureTarget < pvOpenRecord + psContext->ulRecordSize );
+      size_t ulCaptureOffset = bCaptureInRecord ? ( size_t )( psState->pvCaptureTarget - pvOpenRecord ) : 0;
+
+      RETURN_ON_FAIL( RecordArray_Append( psArray, _null_, _null_ ) );
+      // The array may have moved underneath a field being captured, e.g. an element nested in a field
+      if( bCaptureInRecord )
+      {
+         psState->pvCaptureTarget = RecordArray_Get( psArray, ulRecord - 1 ) + ulCaptureOffset;
+         if( psState->eCaptureType == XML_CHILD_STRING )
+         {
+            psState->pszCapture = psState->pvCaptureTarget;
+         }
+      }
+   }
+   else if( ulRecord < psContext->ulArraySize )
+   {
+      memset( xmlWrapperRecord( psState, lContext, ulRecord ), 0, psContext->ulRecordSize );
    }
+   else
+   {
+      *pbSkipped = true;
+   }
+   psState->paulRecordCount[lContext]++;
 
-   iRet = xmlTextWriterStartDocument(pWriter, NULL, MY_ENCODING, NULL);
-   if (iRet < 0) {
-      DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterStartDocument" );
-      return TEST_FAILED;
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlWrapperOnStartElement( XML_PARSE_STATE *psState, const xmlChar *pszName )
+{
+   const XML_SCHEMA *psSchema = psState->psSchema;
+   const XML_SCHEMA_RULE *psRule = _null_;
+   int32_t lParent = XML_NO_CONTEXT;
+   int32_t lContext = XML_NO_CONTEXT;
+
+   if( psState->ulDepth > 0 )
+   {
+      lParent = psState->palContext[psState->ulDepth - 1];
    }
 
-   // Parent element
-   iRet = xmlTextWriterStartElement(
-      pWriter, 
-      BAD_CAST "root" );
-   if (iRet < 0) {
-      DBG_PRINTF("testXmlwriterFilename: Error at xmlTextWriterStartElement");
-      return TEST_FAILED;
+   if( psState->ulDepth >= psState->ulContextSize )
+   {
+      int32_t *palContext = realloc( psState->palContext, ( psState->ulContextSize + XML_CONTEXT_STACK_INCREMENT ) * sizeof( int32_t ) );
+
+      UTIL_ASSERT( palContext, NO_MEMORY );
+      psState->palContext = palContext;
+      psState->ulContextSize += XML_CONTEXT_STACK_INCREMENT;
    }
 
+   // Most elements of a feed aren't in the schema, that only costs a single hash lookup
+   psRule = xmlHashLookup( psSchema->pNames, pszName );
 
-   while( ulCount < ulArraySize )
+   for( ; psRule != _null_; psRule = ( psRule->lNext == XML_NO_RULE ) ? _null_ : &psSchema->pasRules[psRule->lNext] )
    {
-      switch (pasItems[ulCount].eType)
+      if( psRule->lContext != XML_NO_CONTEXT )
       {
-      case XML_CHILD_STRING:
-         /* Write an element named "CUSTOMER_ID" as child of HEADER. */
-         iRet = xmlTextWriterWriteFormatElement(
-            pWriter, 
-            BAD_CAST pasItems[ulCount].pszElementName,
-            "%s", 
-            ( const char * )( pvInputStruct + pasItems[ulCount].ulMemberOffset ) );
-         if (iRet < 0) 
-         {
-            DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterWriteFormatElement" );
-            return TEST_FAILED;
-         }
-         break;
-      case XML_TABLE:
-         {
-            iRet = xmlTextWriterStartElement( pWriter, BAD_CAST pasItems[ulCount].pszElementName );
-            if( iRet >= 0 )
-            {
-               XML_ITEM *pasSubTable = ( XML_ITEM * )pasItems[ulCount].pavSubItem;
-               
-
-               for( uint32_t ulTableCount = 0; ulTableCount < pasItems[ulCount].ulArrayElements; ulTableCount++ )
-               {
-                  uint32_t ulOffset = pasItems[ulCount].ulMemberOffset + pasSubTable[ulTableCount].ulMemberOffset;
+         bool bSkipped = false;
 
-                  iRet = xmlTextWriterWriteFormatElement(
-                  pWriter, 
-                  BAD_CAST pasSubTable[ulTableCount].pszElementName,
-                  "%s", 
-                  ( const char * )( pvInputStruct + ulOffset ) );
-                  if (iRet < 0) 
-                  {
-                     DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterWriteFormatElement" );
-                     return TEST_FAILED;
-                  }
-               }
-               iRet = xmlTextWriterEndElement( pWriter );
-            }
-            else
+         lContext = psRule->lContext;
+         if( xmlWrapperIsArray( psSchema->pasContexts[lContext].eType ) )
+         {
+            RETURN_ON_FAIL( xmlWrapperNewRecord( psState, lContext, &bSkipped ) );
+            if( bSkipped )
             {
-               DBG_PRINTF( "Error Creating Node [%d]", iRet );
-               return TEST_FAILED;
+               lContext = XML_NO_CONTEXT;
             }
          }
-         break;
+      }
+      // Only direct text of the captured element is copied, nested elements are skipped
+      else if( psState->pszCapture == _null_ && ( psRule->lParent == XML_NO_CONTEXT || psRule->lParent == lParent ) )
+      {
+         const XML_SCHEMA_CONTEXT *psParent = ( psRule->lParent == XML_NO_CONTEXT ) ? _null_ : &psSchema->pasContexts[psRule->lParent];
 
-      case XML_SUB_ARRAY:
+         if( psParent && xmlWrapperIsArray( psParent->eType ) )
          {
-            for( uint32_t ulArrayIndex = 0; ulArrayIndex < pasItems[ulCount].ulArraySize; ulArrayIndex++ )
-            {
-               iRet = xmlTextWriterStartElement( pWriter, BAD_CAST pasItems[ulCount].pszElementName );
-               if( iRet >= 0 )
-               {
-                  XML_ITEM *pasTable = ( XML_ITEM * )pasItems[ulCount].pavSubItem;
-                  uint32_t ulStructOffset = pasItems[ulCount].ulMemberOffset;
-                  for( uint32_t ulIndex = 0; ulIndex < pasItems[ulCount].ulArrayElements; ulIndex++ )
-                  {
-                     uint32_t ulOffset = ulStructOffset + pasTable[ulIndex].ulMemberOffset + ( pasItems[ulCount].ulBufferSize / pasItems[ulCount].ulArraySize * ulArrayIndex );
+            // Sub items are resolved relative to the array element they are in, a missing one stays empty
+            uint32_t ulRecord = psState->paulRecordCount[lParent] - 1;
 
-                     iRet = xmlTextWriterWriteFormatElement(
-                     pWriter, 
-                     BAD_CAST pasTable[ulIndex].pszElementName,
-                     "%s", 
-                     ( const char * )( pvInputStruct + ulOffset ) );
-                     if (iRet < 0) 
-                     {
-                        DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterWriteFormatElement" );
-                        return TEST_FAILED;
-                     }
-                  }
-                  iRet = xmlTextWriterEndElement( pWriter );
-               }
-               else
-               {
-                  DBG_PRINTF( "Unable to create element [%d]", iRet );
-                  return TEST_FAILED;
-               }
-            }
+            psState->pvCaptureTarget = xmlWrapperRecord( psState, lParent, ulRecord ) + psRule->ulMemberOffset;
          }
-         break;
-#if 0
-
-    iRet = xmlTextWriterStartElement(pWriter, BAD_CAST "HEADER");
-    if (iRet < 0) {
-        DBG_PRINTF
-            ("testXmlwriterFilename: Error at xmlTextWriterStartElement");
-        return FAILED;
-    }
-
-    /* Close the element named HEADER. */
-    iRet = xmlTextWriterEndElement(pWriter);
-    if (iRet < 0) {
-        DBG_PRINTF
-            ("testXmlwriterFilename: Error at xmlTextWriterEndElement");
-        return FAILED;
-    }
-
-#endif
+         else
+         {
+            psState->pvCaptureTarget = psState->pvOutputStruct + psRule->ulMemberOffset;
+         }
+         memset( psState->pvCaptureTarget, 0, psRule->ulBufferSize );
 
-      default:
-         DBG_PRINTF( "Unknown element [%d], ignoring the element" );
-         break;
+         psState->eCaptureType = psRule->eType;
+         if( psRule->eType == XML_CHILD_STRING )
+         {
+            psState->pszCapture = psState->pvCaptureTarget;
+            psState->ulCaptureSize = psRule->ulBufferSize;
+         }
+         else
+         {
+            psState->pszCapture = psState->szCaptureText;
+            psState->ulCaptureSize = sizeof( psState->szCaptureText );
+         }
+         psState->ulCaptureLength = 0;
+         psState->ulCaptureDepth = psState->ulDepth;
+         memset( psState->pszCapture, 0, psState->ulCaptureSize );
       }
-      ulCount++;
    }
 
-    iRet = xmlTextWriterEndDocument(pWriter);
-    if (iRet < 0) {
-        DBG_PRINTF
-            ("testXmlwriterFilename: Error at xmlTextWriterEndDocument");
-        return TEST_FAILED;
-    }
-
-    xmlFreeTextWriter(pWriter);
+   psState->palContext[psState->ulDepth] = lContext;
+   psState->ulDepth++;
 
    return NO_ERROR;
 }
 
-//////////////////////////////////////////////////////////////////
+static void xmlWrapperOnText( XML_PARSE_STATE *psState, const xmlChar *pszText, uint32_t ulLength )
+{
+   uint32_t ulSpaceLeft = 0;
 
-static uint32_t s_ulTestCount = 0;
+   if( psState->pszCapture == _null_ || psState->ulDepth != psState->ulCaptureDepth + 1 || pszText == _null_ )
+      return;
+
+   // Same truncation as Strcpy_safe, the buffer is always left NULL terminated
+   ulSpaceLeft = psState->ulCaptureSize - 1 - psState->ulCaptureLength;
+   if( ulLength > ulSpaceLeft )
+   {
 #if XML_DEBUG
-#define PRINTF_TEST(string) ( DBG_PRINTF( "----- %s | Test Count: %u -----", string, s_ulTestCount++ ) ) 
-#else
-#define PRINTF_TEST(string) ( s_ulTestCount++ )
+      DBG_PRINTF( "Destination size is %u, truncating", psState->ulCaptureSize );
 #endif
+      ulLength = ulSpaceLeft;
+   }
 
-static ERROR_CODE xmlTestSanityTest( const char *pszFileName )
-{
-   typedef struct{} EMPTY_STRUCT;
-   XML_ITEM asTest[2] = { 0, };
-   EMPTY_STRUCT sTest;
-
-   PRINTF_TEST( "Sanity Tests" );
-   RETURN_ON_FAIL( xmlWrapperParseFile( _null_, _null_, _null_, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, _null_, _null_, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, &asTest[2], 0, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, &asTest[2], 2, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( xmlWrapperParseFile( "temp.xml", &asTest[2], 2, &sTest ) == FILE_ERROR ? NO_ERROR : TEST_FAILED );
-
-   return NO_ERROR;
+   memcpy( psState->pszCapture + psState->ulCaptureLength, pszText, ulLength );
+   psState->ulCaptureLength += ulLength;
 }
 
-static ERROR_CODE xmlTestBasicSingleLayer( const char *pszFileName )
+/* 
+    Stores the text of a numeric or date element, invalid text leaves the output variable at 0
+ */
+static void xmlWrapperConvertCapture( XML_PARSE_STATE *psState )
 {
-   typedef struct
+   const char *pszText = psState->szCaptureText;
+
+   while( isspace( ( unsigned char )*pszText ) )
    {
-      char szTo[8+1];
-      char szFrom[8+1];
+      pszText++;
+   }
+
+   if( psState->eCaptureType == XML_CHILD_U32 && isdigit( ( unsigned char )*pszText ) )
+   {
+      char *pszEnd = _null_;
+      unsigned long long ullValue = strtoull( pszText, &pszEnd, 10 );
+
+      while( isspace( ( unsigned char )*pszEnd ) )
+      {
+         pszEnd++;
+      }
+      if( *pszEnd == '\0' && ullValue <= UINT32_MAX )
+      {
+         *( uint32_t * )psState->pvCaptureTarget = ( uint32_t )ullValue;
+      }
+   }
+   else if( psState->eCaptureType == XML_CHILD_TIME )
+   {
+      time_t tTime = 0;
+
+      if( !ISERROR( ParseRfc822Date( pszText, &tTime ) ) )
+      {
+         *( time_t * )psState->pvCaptureTarget = tTime;
+      }
+   }
+}
+
+static ERROR_CODE xmlWrapperOnEndElement( XML_PARSE_STATE *psState )
+{
+   int32_t lContext = XML_NO_CONTEXT;
+
+   if( psState->ulDepth == 0 )
+      return NO_ERROR;
+
+   psState->ulDepth--;
+
+   if( psState->pszCapture != _null_ && psState->ulDepth == psState->ulCaptureDepth )
+   {
+#if XML_DEBUG
+      DBG_PRINTF( "String found: [%s]", psState->pszCapture );
+#endif
+      if( psState->eCaptureType != XML_CHILD_STRING )
+      {
+         xmlWrapperConvertCapture( psState );
+      }
+      psState->pszCapture = _null_;
+      psState->pvCaptureTarget = _null_;
+   }
+
+   lContext = psState->palContext[psState->ulDepth];
+   if( psState->pfnOnRecord && lContext != XML_NO_CONTEXT && xmlWrapperIsArray( psState->psSchema->pasContexts[lContext].eType ) )
+   {
+      // Skipped elements past the array size don't open a context, so the record is always in range
+      uint32_t ulRecord = psState->paulRecordCount[lContext] - 1;
+
+      return psState->pfnOnRecord( xmlWrapperRecord( psState, lContext, ulRecord ), ulRecord, psState->pvUserData );
+   }
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlWrapperParseReader( xmlTextReaderPtr pReader, XML_PARSE_STATE *psState )
+{
+   int iRet = 0;
+
+   while( ( iRet = xmlTextReaderRead( pReader ) ) == 1 )
+   {
+      switch( xmlTextReaderNodeType( pReader ) )
+      {
+         case XML_READER_TYPE_ELEMENT:
+            RETURN_ON_FAIL( xmlWrapperOnStartElement( psState, xmlTextReaderConstName( pReader ) ) );
+            // <tag/> doesn't generate an end element
+            if( xmlTextReaderIsEmptyElement( pReader ) )
+            {
+               RETURN_ON_FAIL( xmlWrapperOnEndElement( psState ) );
+            }
+            break;
+
+         case XML_READER_TYPE_TEXT:
+         case XML_READER_TYPE_CDATA:
+         case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+         {
+            const xmlChar *pszText = xmlTextReaderConstValue( pReader );
+
+            xmlWrapperOnText( psState, pszText, pszText ? xmlStrlen( pszText ) : 0 );
+         }
+         break;
+
+         case XML_READER_TYPE_END_ELEMENT:
+            RETURN_ON_FAIL( xmlWrapperOnEndElement( psState ) );
+            break;
+
+         default: break;
+      }
+   }
+
+   if( iRet < 0 )
+   {
+      DBG_PRINTF( "File couldn't be parsed" );
+      return FILE_ERROR;
+   }
+
+   return NO_ERROR;
+}
+
+/* 
+    Streams a document that has already been opened through the schema
+    The reader is always freed
+ */
+static ERROR_CODE xmlWrapperParseOpenedReader( xmlTextReaderPtr pReader, const XML_SCHEMA *psSchema, void *pvOutputStruct )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   XML_PARSE_STATE sState = { 0, };
+
+   eRet = xmlWrapperStateInit( &sState, psSchema, pvOutputStruct );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = xmlWrapperParseReader( pReader, &sState );
+   }
+
+   xmlWrapperStateFree( &sState );
+   xmlFreeTextReader( pReader );
+
+   return eRet;
+}
+
+ERROR_CODE xmlWrapperParseFileWithSchema( const char *pszFileName, const XML_SCHEMA *psSchema, void *pvOutputStruct )
+{
+   xmlTextReaderPtr pReader = _null_;
+
+   RETURN_ON_NULL( pszFileName );
+   RETURN_ON_NULL( psSchema );
+   RETURN_ON_NULL( pvOutputStruct );
+
+   pReader = xmlReaderForFile( pszFileName, _null_, XML_READER_OPTIONS );
+   if( !pReader )
+   {
+      DBG_PRINTF( "File Couldn't be opened" );
+      return FILE_ERROR;
+   }
+
+   return xmlWrapperParseOpenedReader( pReader, psSchema, pvOutputStruct );
+}
+
+ERROR_CODE xmlWrapperParseFile( const char *pszFileName, const XML_ITEM *pasItems, uint32_t ulArraySize, void *pvOutputStruct )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   xmlTextReaderPtr pReader = _null_;
+   XML_SCHEMA *psSchema = _null_;
+
+   RETURN_ON_NULL( pszFileName );
+   RETURN_ON_NULL( pasItems );
+   RETURN_ON_NULL( pvOutputStruct );
+   UTIL_ASSERT( ulArraySize != 0, INVALID_ARG );
+
+   pReader = xmlReaderForFile( pszFileName, _null_, XML_READER_OPTIONS );
+   if( !pReader )
+   {
+      DBG_PRINTF( "File Couldn't be opened" );
+      return FILE_ERROR;
+   }
+
+   // One-off parse, callers parsing the same items repeatedly should keep a compiled schema
+   eRet = xmlWrapperCompileSchema( pasItems, ulArraySize, &psSchema );
+   if( ISERROR( eRet ) )
+   {
+      xmlFreeTextReader( pReader );
+      return eRet;
+   }
+
+   eRet = xmlWrapperParseOpenedReader( pReader, psSchema, pvOutputStruct );
+   xmlWrapperFreeSchema( psSchema );
+
+   return eRet;
+}
+
+ERROR_CODE xmlWrapperParseMemoryWithSchema( const char *pcBuffer, size_t ulSize, const XML_SCHEMA *psSchema, void *pvOutputStruct )
+{
+   xmlTextReaderPtr pReader = _null_;
+
+   RETURN_ON_NULL( pcBuffer );
+   RETURN_ON_NULL( psSchema );
+   RETURN_ON_NULL( pvOutputStruct );
+   UTIL_ASSERT( ( ulSize != 0 && ulSize <= INT32_MAX ), INVALID_ARG );
+
+   pReader = xmlReaderForMemory( pcBuffer, ( int )ulSize, _null_, _null_, XML_READER_OPTIONS );
+   if( !pReader )
+   {
+      DBG_PRINTF( "Buffer Couldn't be opened" );
+      return FILE_ERROR;
+   }
+
+   return xmlWrapperParseOpenedReader( pReader, psSchema, pvOutputStruct );
+}
+
+ERROR_CODE xmlWrapperParseMemory( const char *pcBuffer, size_t ulSize, const XML_ITEM *pasItems, uint32_t ulArraySize, void *pvOutputStruct )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   XML_SCHEMA *psSchema = _null_;
+
+   RETURN_ON_NULL( pcBuffer );
+   RETURN_ON_NULL( pasItems );
+   RETURN_ON_NULL( pvOutputStruct );
+   UTIL_ASSERT( ulArraySize != 0, INVALID_ARG );
+
+   RETURN_ON_FAIL( xmlWrapperCompileSchema( pasItems, ulArraySize, &psSchema ) );
+   eRet = xmlWrapperParseMemoryWithSchema( pcBuffer, ulSize, psSchema, pvOutputStruct );
+   xmlWrapperFreeSchema( psSchema );
+
+   return eRet;
+}
+
+/* 
+    Keeps the first error raised by the schema, the rest of the document is ignored
+ */
+static void xmlWrapperSaxCheckError( XML_PUSH_PARSER *psParser, ERROR_CODE eRet )
+{
+   if( ISERROR( eRet ) && !ISERROR( psParser->eError ) )
+   {
+      psParser->eError = eRet;
+      xmlStopParser( psParser->pCtxt );
+   }
+}
+
+static void xmlWrapperSaxStartElement( void *pvCtx, const xmlChar *pszName, const xmlChar **ppszAttributes )
+{
+   XML_PUSH_PARSER *psParser = ( XML_PUSH_PARSER * )( ( xmlParserCtxtPtr )pvCtx )->_private;
+
+   ( void )ppszAttributes;
+   if( !ISERROR( psParser->eError ) )
+   {
+      xmlWrapperSaxCheckError( psParser, xmlWrapperOnStartElement( &psParser->sState, pszName ) );
+   }
+}
+
+static void xmlWrapperSaxEndElement( void *pvCtx, const xmlChar *pszName )
+{
+   XML_PUSH_PARSER *psParser = ( XML_PUSH_PARSER * )( ( xmlParserCtxtPtr )pvCtx )->_private;
+
+   ( void )pszName;
+   if( !ISERROR( psParser->eError ) )
+   {
+      xmlWrapperSaxCheckError( psParser, xmlWrapperOnEndElement( &psParser->sState ) );
+   }
+}
+
+static void xmlWrapperSaxCharacters( void *pvCtx, const xmlChar *pszText, int iLength )
+{
+   XML_PUSH_PARSER *psParser = ( XML_PUSH_PARSER * )( ( xmlParserCtxtPtr )pvCtx )->_private;
+
+   if( !ISERROR( psParser->eError ) && iLength > 0 )
+   {
+      xmlWrapperOnText( &psParser->sState, pszText, ( uint32_t )iLength );
+   }
+}
+
+ERROR_CODE xmlWrapperPushStart( const XML_SCHEMA *psSchema, void *pvOutputStruct, XML_RECORD_CALLBACK pfnOnRecord, void *pvUserData, XML_PUSH_PARSER **ppsParser )
+{
+   xmlSAXHandler sHandler;
+   XML_PUSH_PARSER *psParser = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( psSchema );
+   RETURN_ON_NULL( pvOutputStruct );
+   RETURN_ON_NULL( ppsParser );
+   *ppsParser = _null_;
+
+   psParser = calloc( 1, sizeof( XML_PUSH_PARSER ) );
+   UTIL_ASSERT( psParser, NO_MEMORY );
+
+   eRet = xmlWrapperStateInit( &psParser->sState, psSchema, pvOutputStruct );
+   if( ISERROR( eRet ) )
+   {
+      xmlWrapperPushFree( psParser );
+      return eRet;
+   }
+   psParser->sState.pfnOnRecord = pfnOnRecord;
+   psParser->sState.pvUserData = pvUserData;
+
+   // SAX1 defaults keep the DTD and entity declarations working, element names are reported qualified
+   // exactly like xmlTextReaderConstName
+   xmlSAXVersion( &sHandler, 1 );
+   sHandler.startElement = xmlWrapperSaxStartElement;
+   sHandler.endElement = xmlWrapperSaxEndElement;
+   sHandler.characters = xmlWrapperSaxCharacters;
+   sHandler.cdataBlock = xmlWrapperSaxCharacters;
+   // An internal entity's text already comes through characters, external ones are never loaded
+   sHandler.reference = _null_;
+
+   // The encoding is detected from the first chunk, the default handlers need the context as their user data
+   psParser->pCtxt = xmlCreatePushParserCtxt( &sHandler, _null_, _null_, 0, _null_ );
+   if( !psParser->pCtxt )
+   {
+      xmlWrapperPushFree( psParser );
+      return NO_MEMORY;
+   }
+   psParser->pCtxt->_private = psParser;
+   xmlCtxtUseOptions( psParser->pCtxt, XML_READER_OPTIONS );
+
+   *ppsParser = psParser;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE xmlWrapperPushChunk( XML_PUSH_PARSER *psParser, const char *pcChunk, size_t ulSize )
+{
+   RETURN_ON_NULL( psParser );
+   RETURN_ON_NULL( pcChunk );
+   RETURN_ON_FAIL( psParser->eError );
+
+   // Chunks larger than an int are handed over in pieces
+   while( ulSize > 0 )
+   {
+      int iLength = ( ulSize > INT32_MAX ) ? INT32_MAX : ( int )ulSize;
+
+      if( xmlParseChunk( psParser->pCtxt, pcChunk, iLength, 0 ) != 0 )
+      {
+         RETURN_ON_FAIL( psParser->eError );
+         DBG_PRINTF( "Chunk couldn't be parsed" );
+         psParser->eError = FILE_ERROR;
+         return FILE_ERROR;
+      }
+      RETURN_ON_FAIL( psParser->eError );
+
+      pcChunk += iLength;
+      ulSize -= iLength;
+   }
+
+   return NO_ERROR;
+}
+
+ERROR_CODE xmlWrapperPushFinish( XML_PUSH_PARSER *psParser )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   RETURN_ON_NULL( psParser );
+
+   eRet = psParser->eError;
+   if( !ISERROR( eRet ) )
+   {
+      // An empty or truncated document is caught here
+      if( xmlParseChunk( psParser->pCtxt, _null_, 0, 1 ) != 0 || !psParser->pCtxt->wellFormed )
+      {
+         DBG_PRINTF( "Document couldn't be parsed" );
+         eRet = ISERROR( psParser->eError ) ? psParser->eError : FILE_ERROR;
+      }
+   }
+
+   xmlWrapperPushFree( psParser );
+
+   return eRet;
+}
+
+void xmlWrapperPushFree( XML_PUSH_PARSER *psParser )
+{
+   if( psParser == _null_ )
+      return;
+
+   if( psParser->pCtxt )
+   {
+      // Holds the DTD built by the default handlers
+      if( psParser->pCtxt->myDoc )
+      {
+         xmlFreeDoc( psParser->pCtxt->myDoc );
+      }
+      xmlFreeParserCtxt( psParser->pCtxt );
+   }
+   xmlWrapperStateFree( &psParser->sState );
+   free( psParser );
+}
+
+#define MY_ENCODING     "UTF-8"
+
+/* 
+    A record is empty when none of its sub items holds anything, i.e. it was never filled
+ */
+static bool xmlWrapperIsEmptyRecord( const XML_ITEM *psArray, const void *pvRecord )
+{
+   const XML_ITEM *pasTable = ( const XML_ITEM * )psArray->pavSubItem;
+
+   for( uint32_t ulIndex = 0; ulIndex < psArray->ulArrayElements; ulIndex++ )
+   {
+      const void *pvField = pvRecord + pasTable[ulIndex].ulMemberOffset;
+
+      switch( pasTable[ulIndex].eType )
+      {
+         case XML_CHILD_U32:  if( *( const uint32_t * )pvField != 0 ) return false; break;
+         case XML_CHILD_TIME: if( *( const time_t * )pvField != 0 ) return false; break;
+         default:             if( *( const char * )pvField != '\0' ) return false; break;
+      }
+   }
+
+   return true;
+}
+
+/* 
+    Number of records of an XML_SUB_ARRAY up to the last one which isn't empty
+ */
+static uint32_t xmlWrapperUsedRecords( const XML_ITEM *psArray, const void *pvArray )
+{
+   const uint32_t ulRecordSize = psArray->ulBufferSize / psArray->ulArraySize;
+   uint32_t ulRecords = psArray->ulArraySize;
+
+   while( ulRecords > 0 && xmlWrapperIsEmptyRecord( psArray, pvArray + ( ( size_t )ulRecordSize * ( ulRecords - 1 ) ) ) )
+   {
+      ulRecords--;
+   }
+
+   return ulRecords;
+}
+
+/* 
+    Writes a child item, converting it back to text
+    The text is handed over as it is, there is no format string to go through
+ */
+static int xmlWrapperWriteField( xmlTextWriterPtr pWriter, const XML_ITEM *psField, const void *pvField )
+{
+   char szText[RFC822_DATE_SIZE] = { 0, };
+   const char *pszText = szText;
+
+   switch( psField->eType )
+   {
+      case XML_CHILD_U32:
+         snprintf( szText, sizeof( szText ), "%u", *( const uint32_t * )pvField );
+         break;
+
+      case XML_CHILD_TIME:
+         if( *( const time_t * )pvField != 0 && ISERROR( FormatRfc822Date( *( const time_t * )pvField, szText, sizeof( szText ) ) ) )
+         {
+            szText[0] = '\0';
+         }
+         break;
+
+      default:
+         pszText = ( const char * )pvField;
+         break;
+   }
+
+   return xmlTextWriterWriteElement( pWriter, BAD_CAST psField->pszElementName, BAD_CAST pszText );
+}
+
+ERROR_CODE xmlWrapperWriteFile( const char *pszFileName, const XML_ITEM *pasItems, uint32_t ulArraySize, const void *pvInputStruct )
+{
+   ERROR_CODE eRet = NO_ERROR;
+   xmlTextWriterPtr pWriter = _null_;
+   xmlOutputBufferPtr pBuffer = _null_;
+   ATOMIC_FILE sFile = { 0, };
+
+   RETURN_ON_NULL( pszFileName );
+   RETURN_ON_NULL( pasItems );
+   RETURN_ON_NULL( pvInputStruct );
+   UTIL_ASSERT( ulArraySize != 0, INVALID_ARG );
+
+   eRet = AtomicFile_Open( &sFile, pszFileName );
+   RETURN_ON_FAIL( eRet );
+
+   // The buffer doesn't own the descriptor, it is still open to be synced once the writer is freed
+   pBuffer = xmlOutputBufferCreateFd( sFile.iFd, _null_ );
+   pWriter = pBuffer ? xmlNewTextWriter( pBuffer ) : _null_;
+   if( pWriter == _null_ )
+   {
+      DBG_PRINTF( "Error creating the xml writer" );
+      xmlOutputBufferClose( pBuffer );
+      eRet = NO_MEMORY;
+   }
+   else
+   {
+      // The document reports a failed write as a failed test, to the caller the file couldn't be written
+      eRet = xmlWrapperWriteDocument( pWriter, pasItems, ulArraySize, pvInputStruct );
+      if( ISERROR( eRet ) || xmlTextWriterFlush( pWriter ) < 0 )
+      {
+         eRet = FILE_ERROR;
+      }
+      xmlFreeTextWriter( pWriter );
+   }
+
+   return AtomicFile_Close( &sFile, eRet );
+}
+
+/* 
+    Writes the whole document, the writer is freed by the caller
+ */
+static ERROR_CODE xmlWrapperWriteDocument( xmlTextWriterPtr pWriter, const XML_ITEM *pasItems, uint32_t ulArraySize, const void *pvInputStruct )
+{
+   int iRet = 0;
+   uint32_t ulCount = 0;
+
+   iRet = xmlTextWriterStartDocument(pWriter, NULL, MY_ENCODING, NULL);
+   if (iRet < 0) {
+      DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterStartDocument" );
+      return TEST_FAILED;
+   }
+
+   // Parent element
+   iRet = xmlTextWriterStartElement(
+      pWriter, 
+      BAD_CAST "root" );
+   if (iRet < 0) {
+      DBG_PRINTF("testXmlwriterFilename: Error at xmlTextWriterStartElement");
+      return TEST_FAILED;
+   }
+
+
+   while( ulCount < ulArraySize )
+   {
+      switch (pasItems[ulCount].eType)
+      {
+      case XML_CHILD_STRING:
+      case XML_CHILD_U32:
+      case XML_CHILD_TIME:
+         /* Write an element named "CUSTOMER_ID" as child of HEADER. */
+         iRet = xmlWrapperWriteField( pWriter, &pasItems[ulCount], pvInputStruct + pasItems[ulCount].ulMemberOffset );
+         if (iRet < 0) 
+         {
+            DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterWriteFormatElement" );
+            return TEST_FAILED;
+         }
+         break;
+      case XML_TABLE:
+         {
+            iRet = xmlTextWriterStartElement( pWriter, BAD_CAST pasItems[ulCount].pszElementName );
+            if( iRet >= 0 )
+            {
+               XML_ITEM *pasSubTable = ( XML_ITEM * )pasItems[ulCount].pavSubItem;
+               
+
+               for( uint32_t ulTableCount = 0; ulTableCount < pasItems[ulCount].ulArrayElements; ulTableCount++ )
+               {
+                  uint32_t ulOffset = pasItems[ulCount].ulMemberOffset + pasSubTable[ulTableCount].ulMemberOffset;
+
+                  iRet = xmlWrapperWriteField( pWriter, &pasSubTable[ulTableCount], pvInputStruct + ulOffset );
+                  if (iRet < 0) 
+                  {
+                     DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterWriteFormatElement" );
+                     return TEST_FAILED;
+                  }
+               }
+               iRet = xmlTextWriterEndElement( pWriter );
+            }
+            else
+            {
+               DBG_PRINTF( "Error Creating Node [%d]", iRet );
+               return TEST_FAILED;
+            }
+         }
+         break;
+
+      case XML_SUB_ARRAY:
+      case XML_SUB_DYNAMIC_ARRAY:
+         {
+            // Dynamic arrays only write the records they hold, fixed ones stop after the last record in use
+            const RECORD_ARRAY *psArray = ( pasItems[ulCount].eType == XML_SUB_DYNAMIC_ARRAY ) ? pvInputStruct + pasItems[ulCount].ulMemberOffset : _null_;
+            uint32_t ulRecords = psArray ? psArray->ulCount : xmlWrapperUsedRecords( &pasItems[ulCount], pvInputStruct + pasItems[ulCount].ulMemberOffset );
+
+            for( uint32_t ulArrayIndex = 0; ulArrayIndex < ulRecords; ulArrayIndex++ )
+            {
+               iRet = xmlTextWriterStartElement( pWriter, BAD_CAST pasItems[ulCount].pszElementName );
+               if( iRet >= 0 )
+               {
+                  XML_ITEM *pasTable = ( XML_ITEM * )pasItems[ulCount].pavSubItem;
+                  const void *pvRecord = psArray ? RecordArray_Get( psArray, ulArrayIndex ) : 
+                                         pvInputStruct + pasItems[ulCount].ulMemberOffset + ( pasItems[ulCount].ulBufferSize / pasItems[ulCount].ulArraySize * ulArrayIndex );
+
+                  for( uint32_t ulIndex = 0; ulIndex < pasItems[ulCount].ulArrayElements; ulIndex++ )
+                  {
+                     iRet = xmlWrapperWriteField( pWriter, &pasTable[ulIndex], pvRecord + pasTable[ulIndex].ulMemberOffset );
+                     if (iRet < 0) 
+                     {
+                        DBG_PRINTF( "testXmlwriterFilename: Error at xmlTextWriterWriteFormatElement" );
+                        return TEST_FAILED;
+                     }
+                  }
+                  iRet = xmlTextWriterEndElement( pWriter );
+               }
+               else
+               {
+                  DBG_PRINTF( "Unable to create element [%d]", iRet );
+                  return TEST_FAILED;
+               }
+            }
+         }
+         break;
+#if 0
+
+    iRet = xmlTextWriterStartElement(pWriter, BAD_CAST "HEADER");
+    if (iRet < 0) {
+        DBG_PRINTF
+            ("testXmlwriterFilename: Error at xmlTextWriterStartElement");
+        return FAILED;
+    }
+
+    /* Close the element named HEADER. */
+    iRet = xmlTextWriterEndElement(pWriter);
+    if (iRet < 0) {
+        DBG_PRINTF
+            ("testXmlwriterFilename: Error at xmlTextWriterEndElement");
+        return FAILED;
+    }
+
+#endif
+
+      default:
+         DBG_PRINTF( "Unknown element [%d], ignoring the element" );
+         break;
+      }
+      ulCount++;
+   }
+
+    iRet = xmlTextWriterEndDocument(pWriter);
+    if (iRet < 0) {
+        DBG_PRINTF
+            ("testXmlwriterFilename: Error at xmlTextWriterEndDocument");
+        return TEST_FAILED;
+    }
+
+   return NO_ERROR;
+}
+
+//////////////////////////////////////////////////////////////////
+
+static uint32_t s_ulTestCount = 0;
+#if XML_DEBUG
+#define PRINTF_TEST(string) ( DBG_PRINTF( "----- %s | Test Count: %u -----", string, s_ulTestCount++ ) ) 
+#else
+#define PRINTF_TEST(string) ( s_ulTestCount++ )
+#endif
+
+static ERROR_CODE xmlTestSanityTest( const char *pszFileName )
+{
+   typedef struct{} EMPTY_STRUCT;
+   XML_ITEM asTest[2] = { 0, };
+   EMPTY_STRUCT sTest;
+
+   PRINTF_TEST( "Sanity Tests" );
+   RETURN_ON_FAIL( xmlWrapperParseFile( _null_, _null_, _null_, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, _null_, _null_, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, &asTest[2], 0, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, &asTest[2], 2, _null_ ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( xmlWrapperParseFile( "temp.xml", &asTest[2], 2, &sTest ) == FILE_ERROR ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestBasicSingleLayer( const char *pszFileName )
+{
+   typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
+      char szHeading[16+1];
+      char szBody[64+1];
+   } BASIC_FILE;
+   BASIC_FILE sBasicFile = { 0, };
+   const XML_ITEM asItems[] =
+   {
+      XML_STR( "to", BASIC_FILE, szTo ),
+      XML_STR( "from", BASIC_FILE, szFrom ),
+      XML_STR( "heading", BASIC_FILE, szHeading ),
+      XML_STR( "body", BASIC_FILE, szBody )
+   };
+#define TO        "Tove"
+#define FROM      "Jani"
+#define HEADING   "Reminder"
+#define BODY      "Don't forget me this weekend!"
+   const char *pszFileData = 
+      "<note>"
+      "<to>" TO "</to>"
+      "<from>" FROM "</from>"
+      "<heading>" HEADING "</heading>"
+      "<body>" BODY "</body>"
+      "</note>";
+   FILE *pFile = _null_;
+   uint32_t ulBytesWritten = 0;
+
+   PRINTF_TEST( "Basic single layer file" );
+   pFile = fopen( pszFileName, "w" );
+   if( pFile == _null_ )
+   {
+      DBG_PRINTF( "Couldn't write to file" );
+   }
+   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fclose( pFile );
+   if( ulBytesWritten != strlen( pszFileData ) )
+   {
+      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+   }
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
+#if XML_DEBUG
+   DBG_PRINTF( "Items   = " );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.szBody );
+#endif
+   RETURN_ON_FAIL( strcmp( sBasicFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+
+#undef TO       
+#undef FROM     
+#undef HEADING  
+#undef BODY     
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestOutOfOrderSingleLayer( const char *pszFileName )
+{
+   
+   typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
+      char szHeading[16+1];
+      char szBody[64+1];
+   } BASIC_FILE;
+   BASIC_FILE sBasicFile = { 0, };
+   const XML_ITEM asItems[] =
+   {
+      XML_STR( "to", BASIC_FILE, szTo ),
+      XML_STR( "from", BASIC_FILE, szFrom ),
+      XML_STR( "heading", BASIC_FILE, szHeading ),
+      XML_STR( "body", BASIC_FILE, szBody )
+   };
+#define TO        "Tove"
+#define FROM      "Jani"
+#define HEADING   "Reminder"
+#define BODY      "Don't forget me this weekend!"
+   const char *pszFileData = 
+      "<note>"
+      "<from>" FROM "</from>"
+      "<to>" TO "</to>"
+      "<body>" BODY "</body>"
+      "<heading>" HEADING "</heading>"
+      "</note>";
+   FILE *pFile = _null_;
+   uint32_t ulBytesWritten = 0;
+
+   PRINTF_TEST( "Same sample file but out of order" );
+   pFile = fopen( pszFileName, "w" );
+   if( pFile == _null_ )
+   {
+      DBG_PRINTF( "Couldn't write to file" );
+   }
+   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fclose( pFile );
+   if( ulBytesWritten != strlen( pszFileData ) )
+   {
+      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+   }
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
+#if XML_DEBUG
+   DBG_PRINTF( "Items   = " );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.szBody );
+#endif
+   RETURN_ON_FAIL( strcmp( sBasicFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+
+#undef TO        
+#undef FROM      
+#undef HEADING   
+#undef BODY      
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestSimpleSubTable( const char *pszFileName )
+{
+   typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
+      char szHeading[16+1];
+      char szBody[64+1];
+   } BASIC_FILE;
+   typedef struct 
+   {
+      BASIC_FILE sFile;
+   } WRAPPER_FILE;
+   WRAPPER_FILE sBasicFile = { 0, };
+   const XML_ITEM asNote[] =
+   {
+      XML_STR( "to", BASIC_FILE, szTo ),
+      XML_STR( "from", BASIC_FILE, szFrom ),
+      XML_STR( "heading", BASIC_FILE, szHeading ),
+      XML_STR( "body", BASIC_FILE, szBody )
+   };
+   const XML_ITEM asItems[] = 
+   {
+      XML_SUB_TABLE( "note", WRAPPER_FILE, sFile, asNote, ARRAY_COUNT( asNote ) )
+   };
+#define TO        "Tove"
+#define FROM      "Jani"
+#define HEADING   "Reminder"
+#define BODY      "Don't forget me this weekend!"
+   const char *pszFileData = 
+      "<root>"
+         "<note>"
+            "<to>" TO "</to>"
+            "<from>" FROM "</from>"
+            "<heading>" HEADING "</heading>"
+            "<body>" BODY "</body>"
+         "</note>"
+      "</root>";
+   FILE *pFile = _null_;
+   uint32_t ulBytesWritten = 0;
+
+   PRINTF_TEST( "Embedded subtable" );
+   pFile = fopen( pszFileName, "w" );
+   if( pFile == _null_ )
+   {
+      DBG_PRINTF( "Couldn't write to file" );
+   }
+   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fclose( pFile );
+   if( ulBytesWritten != strlen( pszFileData ) )
+   {
+      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+   }
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
+#if XML_DEBUG
+   DBG_PRINTF( "Items   = " );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.sFile.szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.sFile.szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.sFile.szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.sFile.szBody );
+#endif
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+
+#undef TO        
+#undef FROM      
+#undef HEADING   
+#undef BODY      
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestSubTableWithSiblingChild( const char *pszFileName )
+{
+   typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
+      char szHeading[16+1];
+      char szBody[64+1];
+   } BASIC_FILE;
+   typedef struct 
+   {
+      char szDetails[16+1];
+      BASIC_FILE sFile;
+   } WRAPPER_FILE;
+   WRAPPER_FILE sBasicFile = { 0, };
+   const XML_ITEM asNote[] =
+   {
+      XML_STR( "to", BASIC_FILE, szTo ),
+      XML_STR( "from", BASIC_FILE, szFrom ),
+      XML_STR( "heading", BASIC_FILE, szHeading ),
+      XML_STR( "body", BASIC_FILE, szBody )
+   };
+   const XML_ITEM asItems[] = 
+   {
+      XML_STR( "details", WRAPPER_FILE, szDetails ),
+      XML_SUB_TABLE( "note", WRAPPER_FILE, sFile, asNote, ARRAY_COUNT( asNote ) )
+   };
+#define DETAILS   "Details"
+#define TO        "Tove"
+#define FROM      "Jani"
+#define HEADING   "Reminder"
+#define BODY      "Don't forget me this weekend!"
+   const char *pszFileData = 
+      "<root>"
+         "<details>" DETAILS "</details>"
+         "<note>"
+            "<to>" TO "</to>"
+            "<from>" FROM "</from>"
+            "<heading>" HEADING "</heading>"
+            "<body>" BODY "</body>"
+         "</note>"
+      "</root>";
+   FILE *pFile = _null_;
+   uint32_t ulBytesWritten = 0;
+
+   PRINTF_TEST( "Subtable & extra child" );
+   pFile = fopen( pszFileName, "w" );
+   if( pFile == _null_ )
+   {
+      DBG_PRINTF( "Couldn't write to file" );
+   }
+   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fclose( pFile );
+   if( ulBytesWritten != strlen( pszFileData ) )
+   {
+      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+   }
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
+#if XML_DEBUG
+   DBG_PRINTF( "Items   = " );
+   DBG_PRINTF( "Details = [%s]", sBasicFile.szDetails );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.sFile.szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.sFile.szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.sFile.szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.sFile.szBody );
+#endif
+   RETURN_ON_FAIL( strcmp( sBasicFile.szDetails, DETAILS ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+
+#undef DETAILS
+#undef TO        
+#undef FROM      
+#undef HEADING   
+#undef BODY      
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestSimpleArray( const char *pszFileName )
+{
+    typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
       char szHeading[16+1];
       char szBody[64+1];
    } BASIC_FILE;
-   BASIC_FILE sBasicFile = { 0, };
-   const XML_ITEM asItems[] =
+   const XML_ITEM asItem[] =
+   {
+      XML_STR( "to", BASIC_FILE, szTo ),
+      XML_STR( "from", BASIC_FILE, szFrom ),
+      XML_STR( "heading", BASIC_FILE, szHeading ),
+      XML_STR( "body", BASIC_FILE, szBody )
+   };
+
+   typedef struct
+   {
+      BASIC_FILE asFile[10];
+   } WRAPPER_FILE;
+   WRAPPER_FILE sBasicFile = { 0, };
+
+   const XML_ITEM asItems[] = 
+   {
+      XML_ARRAY( "note", WRAPPER_FILE, asFile, asItem, ARRAY_COUNT( asItem ), ARRAY_COUNT( sBasicFile.asFile ) )
+   };
+
+#define TO        "Tove"
+#define FROM      "Jani"
+#define HEADING   "Reminder"
+#define REHEADING "Re: Reminder"
+#define BODY      "Don't forget me this weekend!"
+#define RESPONSE  "I will not!"
+   const char *pszFileData = 
+      "<root>"
+         "<note>"
+            "<to>" TO "</to>"
+            "<from>" FROM "</from>"
+            "<heading>" HEADING "</heading>"
+            "<body>" BODY "</body>"
+         "</note>"
+         "<note>"
+            "<to>" FROM "</to>"
+            "<from>" TO "</from>"
+            "<heading>" REHEADING "</heading>"
+            "<body>" RESPONSE "</body>"
+         "</note>"
+      "</root>";
+   FILE *pFile = _null_;
+   uint32_t ulBytesWritten = 0;
+
+   PRINTF_TEST( "Simple Array test" );
+
+   pFile = fopen( pszFileName, "w" );
+   if( pFile == _null_ )
+   {
+      DBG_PRINTF( "Couldn't write to file" );
+   }
+   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fclose( pFile );
+   if( ulBytesWritten != strlen( pszFileData ) )
+   {
+      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+   }
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
+#if XML_DEBUG
+   DBG_PRINTF( "Items   = " );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[0].szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[0].szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[0].szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[0].szBody );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[1].szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[1].szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[1].szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[1].szBody );
+#endif
+
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szTo, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szFrom, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szHeading, REHEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szBody, RESPONSE ) == 0 ? NO_ERROR : TEST_FAILED );
+   
+
+#undef TO        
+#undef FROM      
+#undef HEADING   
+#undef BODY      
+#undef REHEADING
+#undef RESPONSE
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestArrayWithSubTableAndSibling( const char *pszFileName )
+{
+   typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
+      char szHeading[16+1];
+      char szBody[64+1];
+   } BASIC_FILE;
+   const XML_ITEM asItem[] =
+   {
+      XML_STR( "to", BASIC_FILE, szTo ),
+      XML_STR( "from", BASIC_FILE, szFrom ),
+      XML_STR( "heading", BASIC_FILE, szHeading ),
+      XML_STR( "body", BASIC_FILE, szBody )
+   };
+   typedef struct TEST_STRUCT
+   {
+      char szOne[4+1];
+      char szTwo[4+1];
+   } TEST_STRUCT;
+   
+   const XML_ITEM asTests[] = 
+   {
+      XML_STR( "one", TEST_STRUCT, szOne ),
+      XML_STR( "two", TEST_STRUCT, szTwo )
+   };
+
+   typedef struct
+   {
+      char szDetails[16+1];
+      TEST_STRUCT sTest;
+      BASIC_FILE asFile[10];
+   } WRAPPER_FILE;
+   WRAPPER_FILE sBasicFile = { 0, };
+
+   const XML_ITEM asItems[] = 
+   {
+      XML_STR( "details", WRAPPER_FILE, szDetails ),
+      XML_SUB_TABLE( "test", WRAPPER_FILE, sTest, asTests, ARRAY_COUNT( asTests ) ),
+      XML_ARRAY( "note", WRAPPER_FILE, asFile, asItem, ARRAY_COUNT( asItem ), ARRAY_COUNT( sBasicFile.asFile ) )
+   };
+
+#define DETAILS   "Details of notes"
+#define ONE       "one"
+#define TWO       "two"
+#define TO        "Tove"
+#define FROM      "Jani"
+#define HEADING   "Reminder"
+#define REHEADING "Re: Reminder"
+#define BODY      "Don't forget me this weekend!"
+#define RESPONSE  "I will not!"
+   const char *pszFileData = 
+      "<root>"
+         "<details>" DETAILS "</details>"
+         "<test>"
+            "<one>" ONE "</one>"
+            "<two>" TWO "</two>"
+         "</test>"
+         "<note>"
+            "<to>" TO "</to>"
+            "<from>" FROM "</from>"
+            "<heading>" HEADING "</heading>"
+            "<body>" BODY "</body>"
+         "</note>"
+         "<note>"
+            "<to>" FROM "</to>"
+            "<from>" TO "</from>"
+            "<heading>" REHEADING "</heading>"
+            "<body>" RESPONSE "</body>"
+         "</note>"
+      "</root>";
+   FILE *pFile = _null_;
+   uint32_t ulBytesWritten = 0;
+
+   PRINTF_TEST( "Array test with subtable & child" );
+
+   pFile = fopen( pszFileName, "w" );
+   if( pFile == _null_ )
+   {
+      DBG_PRINTF( "Couldn't write to file" );
+   }
+   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fclose( pFile );
+   if( ulBytesWritten != strlen( pszFileData ) )
+   {
+      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+   }
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sBasicFile ) );
+#if XML_DEBUG
+   DBG_PRINTF( "Items   = " );
+   DBG_PRINTF( "Details = [%s]", sBasicFile.szDetails );
+   DBG_PRINTF( "One     = [%s]", sBasicFile.sTest.szOne );
+   DBG_PRINTF( "Two     = [%s]", sBasicFile.sTest.szTwo );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[0].szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[0].szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[0].szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[0].szBody );
+   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[1].szTo );
+   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[1].szFrom );
+   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[1].szHeading );
+   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[1].szBody );
+#endif
+
+   RETURN_ON_FAIL( strcmp( sBasicFile.szDetails, DETAILS ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sTest.szOne, ONE ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.sTest.szTwo, TWO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szTo, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szFrom, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szHeading, REHEADING ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szBody, RESPONSE ) == 0 ? NO_ERROR : TEST_FAILED );
+   
+#undef TO        
+#undef FROM      
+#undef HEADING   
+#undef BODY      
+#undef REHEADING
+#undef RESPONSE
+#undef ONE
+#undef TWO
+#undef DETAILS
+
+   return NO_ERROR;
+}
+
+static ERROR_CODE xmlTestArrayMissingField( const char *pszFileName )
+{
+   typedef struct
+   {
+      char szTo[8+1];
+      char szFrom[8+1];
+   } BASIC_FILE;
+   const XML_ITEM asItem[] =
    {
       XML_STR( "to", BASIC_FILE, szTo ),
-      XML_STR( "from", BASIC_FILE, szFrom ),
-      XML_STR( "heading", BASIC_FILE, szHeading ),
-      XML_STR( "body", BASIC_FILE, szBody )
+      XML_STR( "from", BASIC_FILE, szFrom )
+   };
+   typedef struct
+   {
+      BASIC_FILE asFile[2];
+   } WRAPPER_FILE;
+   WRAPPER_FILE sBasicFile = { 0, };
+   const XML_ITEM asItems[] = 
+   {
+      XML_ARRAY( "note", WRAPPER_FILE, asFile, asItem, ARRAY_COUNT( asItem ), ARRAY_COUNT( sBasicFile.asFile ) )
    };
 #define TO        "Tove"
 #define FROM      "Jani"
-#define HEADING   "Reminder"
-#define BODY      "Don't forget me this weekend!"
    const char *pszFileData = 
-      "<note>"
-      "<to>" TO "</to>"
-      "<from>" FROM "</from>"
-      "<heading>" HEADING "</heading>"
-      "<body>" BODY "</body>"
-      "</note>";
+      "<root>"
+         "<note>"
+            "<to>" TO "</to>"
+         "</note>"
+         "<note>"
+            "<to>" FROM "</to>"
+            "<from>" TO "</from>"
+         "</note>"
+         "<note>"
+            "<to>Extra</to>"
+            "<from>Extra</from>"
+         "</note>"
+      "</root>";
    FILE *pFile = _null_;
-   uint32_t ulBytesWritten = 0;
 
-   PRINTF_TEST( "Basic single layer file" );
+   PRINTF_TEST( "Array with a missing sub item" );
    pFile = fopen( pszFileName, "w" );
    if( pFile == _null_ )
    {
       DBG_PRINTF( "Couldn't write to file" );
+      return FILE_ERROR;
    }
-   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
    fclose( pFile );
-   if( ulBytesWritten != strlen( pszFileData ) )
-   {
-      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
-   }
 
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
-#if XML_DEBUG
-   DBG_PRINTF( "Items   = " );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.szBody );
-#endif
-   RETURN_ON_FAIL( strcmp( sBasicFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+   Strcpy_safe( sBasicFile.asFile[0].szFrom, "Stale", sizeof( sBasicFile.asFile[0].szFrom ) );
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sBasicFile ) );
 
-#undef TO       
-#undef FROM     
-#undef HEADING  
-#undef BODY     
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strlen( sBasicFile.asFile[0].szFrom ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szTo, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szFrom, TO ) == 0 ? NO_ERROR : TEST_FAILED );
+
+#undef TO
+#undef FROM
 
    return NO_ERROR;
 }
 
-static ERROR_CODE xmlTestOutOfOrderSingleLayer( const char *pszFileName )
+static ERROR_CODE xmlTestNestedAndEmptyElements( const char *pszFileName )
 {
-   
    typedef struct
    {
       char szTo[8+1];
@@ -456,20 +1770,19 @@ static ERROR_CODE xmlTestOutOfOrderSingleLayer( const char *pszFileName )
       XML_STR( "body", BASIC_FILE, szBody )
    };
 #define TO        "Tove"
-#define FROM      "Jani"
 #define HEADING   "Reminder"
 #define BODY      "Don't forget me this weekend!"
    const char *pszFileData = 
       "<note>"
-      "<from>" FROM "</from>"
-      "<to>" TO "</to>"
-      "<body>" BODY "</body>"
-      "<heading>" HEADING "</heading>"
+         "<to>" TO "</to>"
+         "<from/>"
+         "<heading><![CDATA[" HEADING "]]></heading>"
+         "<body>Don't forget me <b>not this</b>this weekend!</body>"
       "</note>";
    FILE *pFile = _null_;
    uint32_t ulBytesWritten = 0;
 
-   PRINTF_TEST( "Same sample file but out of order" );
+   PRINTF_TEST( "Nested, CDATA & empty elements" );
    pFile = fopen( pszFileName, "w" );
    if( pFile == _null_ )
    {
@@ -482,7 +1795,8 @@ static ERROR_CODE xmlTestOutOfOrderSingleLayer( const char *pszFileName )
       DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
    }
 
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
+   Strcpy_safe( sBasicFile.szFrom, "Stale", sizeof( sBasicFile.szFrom ) );
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sBasicFile ) );
 #if XML_DEBUG
    DBG_PRINTF( "Items   = " );
    DBG_PRINTF( "To      = [%s]", sBasicFile.szTo );
@@ -491,402 +1805,489 @@ static ERROR_CODE xmlTestOutOfOrderSingleLayer( const char *pszFileName )
    DBG_PRINTF( "Body    = [%s]", sBasicFile.szBody );
 #endif
    RETURN_ON_FAIL( strcmp( sBasicFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strlen( sBasicFile.szFrom ) == 0 ? NO_ERROR : TEST_FAILED );
    RETURN_ON_FAIL( strcmp( sBasicFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
    RETURN_ON_FAIL( strcmp( sBasicFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
 
-#undef TO        
-#undef FROM      
-#undef HEADING   
-#undef BODY      
+#undef TO       
+#undef HEADING  
+#undef BODY     
 
    return NO_ERROR;
 }
 
-static ERROR_CODE xmlTestSimpleSubTable( const char *pszFileName )
+static ERROR_CODE xmlTestCompiledSchemaReuse( const char *pszFileName )
 {
    typedef struct
    {
-      char szTo[8+1];
-      char szFrom[8+1];
-      char szHeading[16+1];
-      char szBody[64+1];
-   } BASIC_FILE;
-   typedef struct 
+      char szValue[16+1];
+   } LONG_NAMES;
+   typedef struct
    {
-      BASIC_FILE sFile;
+      char szDetails[16+1];
+      LONG_NAMES sTable;
    } WRAPPER_FILE;
-   WRAPPER_FILE sBasicFile = { 0, };
-   const XML_ITEM asNote[] =
+   WRAPPER_FILE sFile = { 0, };
+   XML_SCHEMA *psSchema = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+   const XML_ITEM asTable[] =
    {
-      XML_STR( "to", BASIC_FILE, szTo ),
-      XML_STR( "from", BASIC_FILE, szFrom ),
-      XML_STR( "heading", BASIC_FILE, szHeading ),
-      XML_STR( "body", BASIC_FILE, szBody )
+      XML_STR( "an_element_name_longer_than_thirty_two_characters", LONG_NAMES, szValue )
    };
-   const XML_ITEM asItems[] = 
+   const XML_ITEM asItems[] =
    {
-      XML_SUB_TABLE( "note", WRAPPER_FILE, sFile, asNote, ARRAY_COUNT( asNote ) )
+      XML_STR( "details", WRAPPER_FILE, szDetails ),
+      XML_SUB_TABLE( "a_table_name_which_is_also_rather_long", WRAPPER_FILE, sTable, asTable, ARRAY_COUNT( asTable ) )
    };
-#define TO        "Tove"
-#define FROM      "Jani"
-#define HEADING   "Reminder"
-#define BODY      "Don't forget me this weekend!"
-   const char *pszFileData = 
+   const char *apszFileData[] = 
+   {
       "<root>"
-         "<note>"
-            "<to>" TO "</to>"
-            "<from>" FROM "</from>"
-            "<heading>" HEADING "</heading>"
-            "<body>" BODY "</body>"
-         "</note>"
-      "</root>";
-   FILE *pFile = _null_;
-   uint32_t ulBytesWritten = 0;
+         "<details>First</details>"
+         "<a_table_name_which_is_also_rather_long>"
+            "<an_element_name_longer_than_thirty_two_characters>One</an_element_name_longer_than_thirty_two_characters>"
+         "</a_table_name_which_is_also_rather_long>"
+      "</root>",
+      "<root>"
+         "<details>Second</details>"
+      "</root>"
+   };
+   const char *apszDetails[] = { "First", "Second" };
+   const char *apszValues[] = { "One", "" };
 
-   PRINTF_TEST( "Embedded subtable" );
-   pFile = fopen( pszFileName, "w" );
-   if( pFile == _null_ )
-   {
-      DBG_PRINTF( "Couldn't write to file" );
-   }
-   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
-   fclose( pFile );
-   if( ulBytesWritten != strlen( pszFileData ) )
+   PRINTF_TEST( "Compiled schema reused across files" );
+   RETURN_ON_FAIL( xmlWrapperCompileSchema( asItems, ARRAY_COUNT( asItems ), &psSchema ) );
+
+   for( uint32_t x = 0; x < ARRAY_COUNT( apszFileData ) && !ISERROR( eRet ); x++ )
    {
-      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+      FILE *pFile = fopen( pszFileName, "w" );
+
+      if( pFile == _null_ )
+      {
+         DBG_PRINTF( "Couldn't write to file" );
+         eRet = FILE_ERROR;
+         break;
+      }
+      fwrite( apszFileData[x], 1, strlen( apszFileData[x] ), pFile );
+      fclose( pFile );
+
+      eRet = xmlWrapperParseFileWithSchema( pszFileName, psSchema, &sFile );
+      if( !ISERROR( eRet ) )
+      {
+         eRet = ( strcmp( sFile.szDetails, apszDetails[x] ) == 0 && strcmp( sFile.sTable.szValue, apszValues[x] ) == 0 ) ? NO_ERROR : TEST_FAILED;
+      }
    }
 
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
-#if XML_DEBUG
-   DBG_PRINTF( "Items   = " );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.sFile.szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.sFile.szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.sFile.szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.sFile.szBody );
-#endif
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
+   xmlWrapperFreeSchema( psSchema );
 
-#undef TO        
-#undef FROM      
-#undef HEADING   
-#undef BODY      
+   return eRet;
+}
+
+static ERROR_CODE xmlTestParseMemory( void )
+{
+   typedef struct
+   {
+      char szTitle[16+1];
+      char szLink[32+1];
+   } POST;
+   typedef struct
+   {
+      char szTitle[16+1];
+      POST asPosts[4];
+   } FEED;
+   FEED sFeed = { 0, };
+   const XML_ITEM asPost[] =
+   {
+      XML_STR( "title", POST, szTitle ),
+      XML_STR( "link", POST, szLink )
+   };
+   const XML_ITEM asItems[] =
+   {
+      XML_ARRAY( "item", FEED, asPosts, asPost, ARRAY_COUNT( asPost ), ARRAY_COUNT( sFeed.asPosts ) )
+   };
+   const char *pszFeed = 
+      "<rss><channel>"
+         "<title>Blog</title>"
+         "<item><title>Second</title><link>https://blog/2</link></item>"
+         "<item><title>First</title><link>https://blog/1</link></item>"
+      "</channel></rss>";
+
+   PRINTF_TEST( "Parsing from memory" );
+   RETURN_ON_FAIL( xmlWrapperParseMemory( _null_, 0, asItems, ARRAY_COUNT( asItems ), &sFeed ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( xmlWrapperParseMemory( pszFeed, strlen( pszFeed ) - 1, asItems, ARRAY_COUNT( asItems ), &sFeed ) == FILE_ERROR ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( xmlWrapperParseMemory( pszFeed, strlen( pszFeed ), asItems, ARRAY_COUNT( asItems ), &sFeed ) );
+
+   RETURN_ON_FAIL( strcmp( sFeed.asPosts[0].szTitle, "Second" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sFeed.asPosts[0].szLink, "https://blog/2" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sFeed.asPosts[1].szTitle, "First" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strcmp( sFeed.asPosts[1].szLink, "https://blog/1" ) == 0 ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strlen( sFeed.szTitle ) == 0 ? NO_ERROR : TEST_FAILED );
 
    return NO_ERROR;
 }
 
-static ERROR_CODE xmlTestSubTableWithSiblingChild( const char *pszFileName )
+typedef struct
+{
+   uint32_t ulRecords;
+   uint32_t ulStopAfter;
+} XML_TEST_RECORDS;
+
+static ERROR_CODE xmlTestOnRecord( void *pvRecord, uint32_t ulIndex, void *pvUserData )
+{
+   XML_TEST_RECORDS *psRecords = ( XML_TEST_RECORDS * )pvUserData;
+
+   // Records are reported in order & complete, the title is the first member of the record
+   RETURN_ON_FAIL( ulIndex == psRecords->ulRecords ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( strlen( ( const char * )pvRecord ) > 0 ? NO_ERROR : TEST_FAILED );
+   psRecords->ulRecords++;
+
+   return ( psRecords->ulRecords == psRecords->ulStopAfter ) ? NOT_FOUND : NO_ERROR;
+}
+
+static ERROR_CODE xmlTestExternalEntity( const char *pszFileName )
 {
    typedef struct
    {
-      char szTo[8+1];
-      char szFrom[8+1];
-      char szHeading[16+1];
-      char szBody[64+1];
-   } BASIC_FILE;
-   typedef struct 
+      char szTitle[32+1];
+   } POST;
+   typedef struct
    {
-      char szDetails[16+1];
-      BASIC_FILE sFile;
-   } WRAPPER_FILE;
-   WRAPPER_FILE sBasicFile = { 0, };
-   const XML_ITEM asNote[] =
+      POST asPosts[2];
+   } FEED;
+   FEED sFeed = { 0, };
+   const XML_ITEM asPost[] =
    {
-      XML_STR( "to", BASIC_FILE, szTo ),
-      XML_STR( "from", BASIC_FILE, szFrom ),
-      XML_STR( "heading", BASIC_FILE, szHeading ),
-      XML_STR( "body", BASIC_FILE, szBody )
+      XML_STR( "title", POST, szTitle )
    };
-   const XML_ITEM asItems[] = 
+   const XML_ITEM asItems[] =
    {
-      XML_STR( "details", WRAPPER_FILE, szDetails ),
-      XML_SUB_TABLE( "note", WRAPPER_FILE, sFile, asNote, ARRAY_COUNT( asNote ) )
+      XML_ARRAY( "item", FEED, asPosts, asPost, ARRAY_COUNT( asPost ), ARRAY_COUNT( sFeed.asPosts ) )
    };
-#define DETAILS   "Details"
-#define TO        "Tove"
-#define FROM      "Jani"
-#define HEADING   "Reminder"
-#define BODY      "Don't forget me this weekend!"
-   const char *pszFileData = 
-      "<root>"
-         "<details>" DETAILS "</details>"
-         "<note>"
-            "<to>" TO "</to>"
-            "<from>" FROM "</from>"
-            "<heading>" HEADING "</heading>"
-            "<body>" BODY "</body>"
-         "</note>"
-      "</root>";
+#define SECRET_FILE  "xmlTestSecret.txt"
+#define SECRET       "secret"
+   const char *pszFeed = 
+      "<?xml version=\"1.0\"?>"
+      "<!DOCTYPE rss [<!ENTITY xxe SYSTEM \"" SECRET_FILE "\">]>"
+      "<rss><channel>"
+         "<item><title>Leak &xxe;&xxe;</title></item>"
+      "</channel></rss>";
    FILE *pFile = _null_;
-   uint32_t ulBytesWritten = 0;
-
-   PRINTF_TEST( "Subtable & extra child" );
+   XML_SCHEMA *psSchema = _null_;
+   XML_PUSH_PARSER *psParser = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "External entity isn't expanded" );
+   pFile = fopen( SECRET_FILE, "w" );
+   RETURN_ON_FAIL( pFile != _null_ ? NO_ERROR : FILE_ERROR );
+   fputs( SECRET, pFile );
+   fclose( pFile );
    pFile = fopen( pszFileName, "w" );
    if( pFile == _null_ )
    {
-      DBG_PRINTF( "Couldn't write to file" );
+      unlink( SECRET_FILE );
+      return FILE_ERROR;
    }
-   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
+   fputs( pszFeed, pFile );
    fclose( pFile );
-   if( ulBytesWritten != strlen( pszFileData ) )
-   {
-      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
-   }
-
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
-#if XML_DEBUG
-   DBG_PRINTF( "Items   = " );
-   DBG_PRINTF( "Details = [%s]", sBasicFile.szDetails );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.sFile.szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.sFile.szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.sFile.szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.sFile.szBody );
-#endif
-   RETURN_ON_FAIL( strcmp( sBasicFile.szDetails, DETAILS ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sFile.szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
-
-#undef DETAILS
-#undef TO        
-#undef FROM      
-#undef HEADING   
-#undef BODY      
-
-   return NO_ERROR;
-}
 
-static ERROR_CODE xmlTestSimpleArray( const char *pszFileName )
-{
-    typedef struct
+   // Whether the parse succeeds or not, the file's content must never reach the output
+   ( void )xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sFeed );
+   eRet = ( strstr( sFeed.asPosts[0].szTitle, SECRET ) == _null_ ) ? NO_ERROR : TEST_FAILED;
+   if( !ISERROR( eRet ) )
    {
-      char szTo[8+1];
-      char szFrom[8+1];
-      char szHeading[16+1];
-      char szBody[64+1];
-   } BASIC_FILE;
-   const XML_ITEM asItem[] =
+      memset( &sFeed, 0, sizeof( sFeed ) );
+      ( void )xmlWrapperParseMemory( pszFeed, strlen( pszFeed ), asItems, ARRAY_COUNT( asItems ), &sFeed );
+      eRet = ( strstr( sFeed.asPosts[0].szTitle, SECRET ) == _null_ ) ? NO_ERROR : TEST_FAILED;
+   }
+   if( !ISERROR( eRet ) )
    {
-      XML_STR( "to", BASIC_FILE, szTo ),
-      XML_STR( "from", BASIC_FILE, szFrom ),
-      XML_STR( "heading", BASIC_FILE, szHeading ),
-      XML_STR( "body", BASIC_FILE, szBody )
-   };
+      memset( &sFeed, 0, sizeof( sFeed ) );
+      eRet = xmlWrapperCompileSchema( asItems, ARRAY_COUNT( asItems ), &psSchema );
+      eRet = ISERROR( eRet ) ? eRet : xmlWrapperPushStart( psSchema, &sFeed, _null_, _null_, &psParser );
+      if( !ISERROR( eRet ) )
+      {
+         ( void )xmlWrapperPushChunk( psParser, pszFeed, strlen( pszFeed ) );
+         ( void )xmlWrapperPushFinish( psParser );
+         eRet = ( strstr( sFeed.asPosts[0].szTitle, SECRET ) == _null_ ) ? NO_ERROR : TEST_FAILED;
+      }
+      xmlWrapperFreeSchema( psSchema );
+   }
+   unlink( SECRET_FILE );
+
+#undef SECRET_FILE
+#undef SECRET
 
+   return eRet;
+}
+
+static ERROR_CODE xmlTestPushParser( void )
+{
    typedef struct
    {
-      BASIC_FILE asFile[10];
-   } WRAPPER_FILE;
-   WRAPPER_FILE sBasicFile = { 0, };
-
-   const XML_ITEM asItems[] = 
+      char szTitle[16+1];
+      char szLink[32+1];
+   } POST;
+   typedef struct
    {
-      XML_ARRAY( "note", WRAPPER_FILE, asFile, asItem, ARRAY_COUNT( asItem ), ARRAY_COUNT( sBasicFile.asFile ) )
+      POST asPosts[4];
+   } FEED;
+   FEED sFeed = { 0, };
+   const XML_ITEM asPost[] =
+   {
+      XML_STR( "title", POST, szTitle ),
+      XML_STR( "link", POST, szLink )
    };
+   const XML_ITEM asItems[] =
+   {
+      XML_ARRAY( "item", FEED, asPosts, asPost, ARRAY_COUNT( asPost ), ARRAY_COUNT( sFeed.asPosts ) )
+   };
+   const char *pszFeed = 
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+      "<rss><channel>"
+         "<item><title>Third &amp; last</title><link>https://blog/3</link></item>"
+         "<item><title><![CDATA[Second]]></title><link>https://blog/2</link></item>"
+         "<item><title>First</title><link>https://blog/1</link></item>"
+      "</channel></rss>";
+   XML_SCHEMA *psSchema = _null_;
+   XML_PUSH_PARSER *psParser = _null_;
+   XML_TEST_RECORDS sRecords = { 0, };
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "Push parser" );
+   RETURN_ON_FAIL( xmlWrapperCompileSchema( asItems, ARRAY_COUNT( asItems ), &psSchema ) );
+   RETURN_ON_FAIL( xmlWrapperPushStart( _null_, &sFeed, _null_, _null_, &psParser ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+
+   // One byte at a time, every element & entity is split across chunks
+   eRet = xmlWrapperPushStart( psSchema, &sFeed, xmlTestOnRecord, &sRecords, &psParser );
+   for( size_t ulCount = 0; ulCount < strlen( pszFeed ) && !ISERROR( eRet ); ulCount++ )
+   {
+      eRet = xmlWrapperPushChunk( psParser, &pszFeed[ulCount], 1 );
+   }
+   eRet = ISERROR( eRet ) ? eRet : xmlWrapperPushFinish( psParser );
+   if( ISERROR( eRet ) )
+   {
+      xmlWrapperFreeSchema( psSchema );
+      return eRet;
+   }
 
-#define TO        "Tove"
-#define FROM      "Jani"
-#define HEADING   "Reminder"
-#define REHEADING "Re: Reminder"
-#define BODY      "Don't forget me this weekend!"
-#define RESPONSE  "I will not!"
-   const char *pszFileData = 
-      "<root>"
-         "<note>"
-            "<to>" TO "</to>"
-            "<from>" FROM "</from>"
-            "<heading>" HEADING "</heading>"
-            "<body>" BODY "</body>"
-         "</note>"
-         "<note>"
-            "<to>" FROM "</to>"
-            "<from>" TO "</from>"
-            "<heading>" REHEADING "</heading>"
-            "<body>" RESPONSE "</body>"
-         "</note>"
-      "</root>";
-   FILE *pFile = _null_;
-   uint32_t ulBytesWritten = 0;
-
-   PRINTF_TEST( "Simple Array test" );
+   eRet = ( sRecords.ulRecords == 3 &&
+            strcmp( sFeed.asPosts[0].szTitle, "Third & last" ) == 0 &&
+            strcmp( sFeed.asPosts[1].szTitle, "Second" ) == 0 &&
+            strcmp( sFeed.asPosts[2].szLink, "https://blog/1" ) == 0 ) ? NO_ERROR : TEST_FAILED;
 
-   pFile = fopen( pszFileName, "w" );
-   if( pFile == _null_ )
+   // The callback can stop the parse
+   if( !ISERROR( eRet ) )
    {
-      DBG_PRINTF( "Couldn't write to file" );
+      memset( &sFeed, 0, sizeof( sFeed ) );
+      memset( &sRecords, 0, sizeof( sRecords ) );
+      sRecords.ulStopAfter = 1;
+      eRet = xmlWrapperPushStart( psSchema, &sFeed, xmlTestOnRecord, &sRecords, &psParser );
+      if( !ISERROR( eRet ) )
+      {
+         eRet = ( xmlWrapperPushChunk( psParser, pszFeed, strlen( pszFeed ) ) == NOT_FOUND &&
+                  xmlWrapperPushFinish( psParser ) == NOT_FOUND &&
+                  sRecords.ulRecords == 1 && strlen( sFeed.asPosts[1].szTitle ) == 0 ) ? NO_ERROR : TEST_FAILED;
+      }
    }
-   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
-   fclose( pFile );
-   if( ulBytesWritten != strlen( pszFileData ) )
+
+   // A truncated document is only detected once it is finished
+   if( !ISERROR( eRet ) )
    {
-      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+      eRet = xmlWrapperPushStart( psSchema, &sFeed, _null_, _null_, &psParser );
+      if( !ISERROR( eRet ) )
+      {
+         eRet = ( xmlWrapperPushChunk( psParser, pszFeed, strlen( pszFeed ) - 1 ) == NO_ERROR &&
+                  xmlWrapperPushFinish( psParser ) == FILE_ERROR ) ? NO_ERROR : TEST_FAILED;
+      }
    }
 
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ( sizeof( asItems ) / sizeof( asItems[0] ) ), &sBasicFile ) );
-#if XML_DEBUG
-   DBG_PRINTF( "Items   = " );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[0].szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[0].szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[0].szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[0].szBody );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[1].szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[1].szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[1].szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[1].szBody );
-#endif
-
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szTo, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szFrom, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szHeading, REHEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szBody, RESPONSE ) == 0 ? NO_ERROR : TEST_FAILED );
-   
+   // Entities declared in an inline DTD are expanded
+   if( !ISERROR( eRet ) )
+   {
+      const char *pszDtdFeed = 
+         "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+         "<!DOCTYPE rss [<!ENTITY hellip \"&#8230;\"><!ENTITY site \"blog\">]>"
+         "<rss><channel>"
+            "<item><title>Wait&hellip;</title><link>https://&site;/&site;</link></item>"
+         "</channel></rss>";
+
+      memset( &sFeed, 0, sizeof( sFeed ) );
+      eRet = xmlWrapperPushStart( psSchema, &sFeed, _null_, _null_, &psParser );
+      if( !ISERROR( eRet ) )
+      {
+         eRet = ( xmlWrapperPushChunk( psParser, pszDtdFeed, strlen( pszDtdFeed ) ) == NO_ERROR &&
+                  xmlWrapperPushFinish( psParser ) == NO_ERROR &&
+                  strcmp( sFeed.asPosts[0].szTitle, "Wait\xE2\x80\xA6" ) == 0 &&
+                  strcmp( sFeed.asPosts[0].szLink, "https://blog/blog" ) == 0 ) ? NO_ERROR : TEST_FAILED;
+      }
+   }
 
-#undef TO        
-#undef FROM      
-#undef HEADING   
-#undef BODY      
-#undef REHEADING
-#undef RESPONSE
+   xmlWrapperFreeSchema( psSchema );
 
-   return NO_ERROR;
+   return eRet;
 }
 
-static ERROR_CODE xmlTestArrayWithSubTableAndSibling( const char *pszFileName )
+static ERROR_CODE xmlTestDynamicArray( const char *pszFileName )
 {
    typedef struct
    {
-      char szTo[8+1];
-      char szFrom[8+1];
-      char szHeading[16+1];
-      char szBody[64+1];
-   } BASIC_FILE;
-   const XML_ITEM asItem[] =
+      char szTitle[16+1];
+      char szLink[32+1];
+   } POST;
+   typedef struct
    {
-      XML_STR( "to", BASIC_FILE, szTo ),
-      XML_STR( "from", BASIC_FILE, szFrom ),
-      XML_STR( "heading", BASIC_FILE, szHeading ),
-      XML_STR( "body", BASIC_FILE, szBody )
-   };
-   typedef struct TEST_STRUCT
+      char szCount[10+1];
+      RECORD_ARRAY sPosts;
+   } FEED;
+   FEED sFeed = { 0, };
+   const XML_ITEM asPost[] =
    {
-      char szOne[4+1];
-      char szTwo[4+1];
-   } TEST_STRUCT;
-   
-   const XML_ITEM asTests[] = 
+      XML_STR( "title", POST, szTitle ),
+      XML_STR( "link", POST, szLink )
+   };
+   const XML_ITEM asItems[] =
    {
-      XML_STR( "one", TEST_STRUCT, szOne ),
-      XML_STR( "two", TEST_STRUCT, szTwo )
+      XML_STR( "count", FEED, szCount ),
+      XML_DYNAMIC_ARRAY( "item", FEED, sPosts, POST, asPost, ARRAY_COUNT( asPost ) )
    };
+   const uint32_t ulPosts = 1000;
+   const POST *psPost = _null_;
+   char *pszFeed = _null_;
+   size_t ulSize = 0, ulLength = 0;
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "Dynamic array" );
+
+   // Far more elements than any fixed array would hold
+   ulSize = 64 + ( size_t )ulPosts * 96;
+   pszFeed = malloc( ulSize );
+   RETURN_ON_NULL( pszFeed );
+   ulLength = snprintf( pszFeed, ulSize, "<rss><count>%u</count>", ulPosts );
+   for( uint32_t ulCount = 0; ulCount < ulPosts; ulCount++ )
+   {
+      ulLength += snprintf( pszFeed + ulLength, ulSize - ulLength, "<item><title>Post %u</title><link>https://blog/%u</link></item>", ulCount, ulCount );
+   }
+   ulLength += snprintf( pszFeed + ulLength, ulSize - ulLength, "</rss>" );
 
-   typedef struct
+   eRet = xmlWrapperParseMemory( pszFeed, ulLength, asItems, ARRAY_COUNT( asItems ), &sFeed );
+   free( pszFeed );
+   if( !ISERROR( eRet ) )
    {
-      char szDetails[16+1];
-      TEST_STRUCT sTest;
-      BASIC_FILE asFile[10];
-   } WRAPPER_FILE;
-   WRAPPER_FILE sBasicFile = { 0, };
+      psPost = RecordArray_Get( &sFeed.sPosts, ulPosts - 1 );
+      eRet = ( sFeed.sPosts.ulCount == ulPosts && psPost &&
+               strcmp( psPost->szTitle, "Post 999" ) == 0 &&
+               strcmp( psPost->szLink, "https://blog/999" ) == 0 &&
+               RecordArray_Get( &sFeed.sPosts, ulPosts ) == _null_ ) ? NO_ERROR : TEST_FAILED;
+   }
 
-   const XML_ITEM asItems[] = 
+   // Only the records held are written & a new parse starts from an empty array
+   if( !ISERROR( eRet ) )
    {
-      XML_STR( "details", WRAPPER_FILE, szDetails ),
-      XML_SUB_TABLE( "test", WRAPPER_FILE, sTest, asTests, ARRAY_COUNT( asTests ) ),
-      XML_ARRAY( "note", WRAPPER_FILE, asFile, asItem, ARRAY_COUNT( asItem ), ARRAY_COUNT( sBasicFile.asFile ) )
-   };
+      sFeed.sPosts.ulCount = 2;
+      eRet = xmlWrapperWriteFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sFeed );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      eRet = xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sFeed );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      psPost = RecordArray_Get( &sFeed.sPosts, 1 );
+      eRet = ( sFeed.sPosts.ulCount == 2 && psPost &&
+               strcmp( psPost->szTitle, "Post 1" ) == 0 &&
+               strcmp( sFeed.szCount, "1000" ) == 0 ) ? NO_ERROR : TEST_FAILED;
+   }
 
-#define DETAILS   "Details of notes"
-#define ONE       "one"
-#define TWO       "two"
-#define TO        "Tove"
-#define FROM      "Jani"
-#define HEADING   "Reminder"
-#define REHEADING "Re: Reminder"
-#define BODY      "Don't forget me this weekend!"
-#define RESPONSE  "I will not!"
-   const char *pszFileData = 
-      "<root>"
-         "<details>" DETAILS "</details>"
-         "<test>"
-            "<one>" ONE "</one>"
-            "<two>" TWO "</two>"
-         "</test>"
-         "<note>"
-            "<to>" TO "</to>"
-            "<from>" FROM "</from>"
-            "<heading>" HEADING "</heading>"
-            "<body>" BODY "</body>"
-         "</note>"
-         "<note>"
-            "<to>" FROM "</to>"
-            "<from>" TO "</from>"
-            "<heading>" REHEADING "</heading>"
-            "<body>" RESPONSE "</body>"
-         "</note>"
-      "</root>";
-   FILE *pFile = _null_;
-   uint32_t ulBytesWritten = 0;
+   RecordArray_Free( &sFeed.sPosts );
 
-   PRINTF_TEST( "Array test with subtable & child" );
+   return eRet;
+}
 
-   pFile = fopen( pszFileName, "w" );
-   if( pFile == _null_ )
+static ERROR_CODE xmlTestTypedFields( const char *pszFileName )
+{
+   typedef struct
    {
-      DBG_PRINTF( "Couldn't write to file" );
+      char szTitle[16+1];
+      uint32_t ulShared;
+      time_t tPubDate;
+   } POST;
+   typedef struct
+   {
+      uint32_t ulCount;
+      RECORD_ARRAY sPosts;
+   } FEED;
+   typedef struct
+   {
+      char szCount[10+1];
+   } WRONG_TYPE;
+   FEED sFeed = { 0, };
+   const XML_ITEM asPost[] =
+   {
+      XML_STR( "title", POST, szTitle ),
+      XML_U32( "shared", POST, ulShared ),
+      XML_TIME( "pubDate", POST, tPubDate )
+   };
+   const XML_ITEM asItems[] =
+   {
+      XML_U32( "count", FEED, ulCount ),
+      XML_DYNAMIC_ARRAY( "item", FEED, sPosts, POST, asPost, ARRAY_COUNT( asPost ) )
+   };
+   const XML_ITEM asWrongType[] =
+   {
+      XML_U32( "count", WRONG_TYPE, szCount )
+   };
+   const char *pszFeed = 
+      "<rss><count> 3 </count>"
+         "<item><title>First</title><shared>7</shared><pubDate>Tue, 10 Mar 2020 18:30:00 +0530</pubDate></item>"
+         "<item><title>Second</title><shared>-1</shared><pubDate>yesterday</pubDate></item>"
+         "<item><title>Third</title><shared>4294967296</shared></item>"
+      "</rss>";
+   const POST *psPost = _null_;
+   XML_SCHEMA *psSchema = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "Numeric & date fields" );
+   RETURN_ON_FAIL( xmlWrapperCompileSchema( asWrongType, ARRAY_COUNT( asWrongType ), &psSchema ) == INVALID_ARG ? NO_ERROR : TEST_FAILED );
+
+   // Invalid numbers & dates are stored as 0
+   eRet = xmlWrapperParseMemory( pszFeed, strlen( pszFeed ), asItems, ARRAY_COUNT( asItems ), &sFeed );
+   if( !ISERROR( eRet ) )
+   {
+      psPost = RecordArray_Get( &sFeed.sPosts, 0 );
+      eRet = ( sFeed.ulCount == 3 && sFeed.sPosts.ulCount == 3 && psPost &&
+               psPost->ulShared == 7 && psPost->tPubDate == 1583845200 ) ? NO_ERROR : TEST_FAILED;
    }
-   ulBytesWritten = fwrite( pszFileData, 1, strlen( pszFileData ), pFile );
-   fclose( pFile );
-   if( ulBytesWritten != strlen( pszFileData ) )
+   if( !ISERROR( eRet ) )
    {
-      DBG_PRINTF( "Couldn't write [%d] number of bytes, only wrote [%u] bytes", strlen( pszFileData ), ulBytesWritten );
+      psPost = RecordArray_Get( &sFeed.sPosts, 1 );
+      eRet = ( psPost && psPost->ulShared == 0 && psPost->tPubDate == 0 ) ? NO_ERROR : TEST_FAILED;
+   }
+   if( !ISERROR( eRet ) )
+   {
+      psPost = RecordArray_Get( &sFeed.sPosts, 2 );
+      eRet = ( psPost && psPost->ulShared == 0 && psPost->tPubDate == 0 ) ? NO_ERROR : TEST_FAILED;
    }
 
-   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sBasicFile ) );
-#if XML_DEBUG
-   DBG_PRINTF( "Items   = " );
-   DBG_PRINTF( "Details = [%s]", sBasicFile.szDetails );
-   DBG_PRINTF( "One     = [%s]", sBasicFile.sTest.szOne );
-   DBG_PRINTF( "Two     = [%s]", sBasicFile.sTest.szTwo );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[0].szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[0].szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[0].szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[0].szBody );
-   DBG_PRINTF( "To      = [%s]", sBasicFile.asFile[1].szTo );
-   DBG_PRINTF( "From    = [%s]", sBasicFile.asFile[1].szFrom );
-   DBG_PRINTF( "Heading = [%s]", sBasicFile.asFile[1].szHeading );
-   DBG_PRINTF( "Body    = [%s]", sBasicFile.asFile[1].szBody );
-#endif
+   // Values are written back as text & read the same
+   if( !ISERROR( eRet ) )
+   {
+      eRet = xmlWrapperWriteFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sFeed );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      sFeed.ulCount = 0;
+      eRet = xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sFeed );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      psPost = RecordArray_Get( &sFeed.sPosts, 0 );
+      eRet = ( sFeed.ulCount == 3 && sFeed.sPosts.ulCount == 3 && psPost &&
+               strcmp( psPost->szTitle, "First" ) == 0 &&
+               psPost->ulShared == 7 && psPost->tPubDate == 1583845200 ) ? NO_ERROR : TEST_FAILED;
+   }
 
-   RETURN_ON_FAIL( strcmp( sBasicFile.szDetails, DETAILS ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sTest.szOne, ONE ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.sTest.szTwo, TWO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szTo, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szFrom, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szHeading, HEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[0].szBody, BODY ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szTo, FROM ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szFrom, TO ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szHeading, REHEADING ) == 0 ? NO_ERROR : TEST_FAILED );
-   RETURN_ON_FAIL( strcmp( sBasicFile.asFile[1].szBody, RESPONSE ) == 0 ? NO_ERROR : TEST_FAILED );
-   
-#undef TO        
-#undef FROM      
-#undef HEADING   
-#undef BODY      
-#undef REHEADING
-#undef RESPONSE
-#undef ONE
-#undef TWO
-#undef DETAILS
+   RecordArray_Free( &sFeed.sPosts );
 
-   return NO_ERROR;
+   return eRet;
 }
 
 static ERROR_CODE xmlTestWriteSimpleLayer( const char *pszFileName )
@@ -1038,7 +2439,13 @@ static ERROR_CODE xmlTestWriteArray( const char *pszFileName )
       SIMPLE_LAYER asLayers[5];
    } ARRAY_LAYER;
    
+   typedef struct 
+   {
+      RECORD_ARRAY sLayers;
+   } DYNAMIC_LAYER;
+   
    ARRAY_LAYER sWriteLayer = {0,}, sReadLayer = {0,};
+   DYNAMIC_LAYER sWritten = {0,};
    const XML_ITEM asArrayItems[] =
    {
       XML_STR( "to", SIMPLE_LAYER, szTo ),
@@ -1050,6 +2457,11 @@ static ERROR_CODE xmlTestWriteArray( const char *pszFileName )
    {
       XML_ARRAY( "note", ARRAY_LAYER, asLayers, asArrayItems, ARRAY_COUNT( asArrayItems ), ARRAY_COUNT( sWriteLayer.asLayers ) )
    };
+   const XML_ITEM asWrittenItems[] = 
+   {
+      XML_DYNAMIC_ARRAY( "note", DYNAMIC_LAYER, sLayers, SIMPLE_LAYER, asArrayItems, ARRAY_COUNT( asArrayItems ) )
+   };
+   ERROR_CODE eRet = NO_ERROR;
 
 #define TO        "Tove"
 #define FROM      "Jani"
@@ -1106,6 +2518,15 @@ static ERROR_CODE xmlTestWriteArray( const char *pszFileName )
    RETURN_ON_FAIL( strcmp( sReadLayer.asLayers[1].szSubject, REPLY ) == 0 ? NO_ERROR : TEST_FAILED );
    RETURN_ON_FAIL( strcmp( sReadLayer.asLayers[1].szBody, RESPONSE ) == 0 ? NO_ERROR : TEST_FAILED );
 
+   // The empty records at the end of the array aren't in the file
+   eRet = xmlWrapperParseFile( pszFileName, asWrittenItems, ARRAY_COUNT( asWrittenItems ), &sWritten );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = ( sWritten.sLayers.ulCount == 2 ) ? NO_ERROR : TEST_FAILED;
+   }
+   RecordArray_Free( &sWritten.sLayers );
+   RETURN_ON_FAIL( eRet );
+
    // Success
 #undef TO
 #undef FROM
@@ -1117,6 +2538,39 @@ static ERROR_CODE xmlTestWriteArray( const char *pszFileName )
    return NO_ERROR;
 }
 
+static ERROR_CODE xmlTestAtomicWrite( const char *pszFileName )
+{
+   typedef struct 
+   {
+      char szBody[16+1];
+   } SIMPLE_LAYER;
+   SIMPLE_LAYER sWriteLayer = { "Kept" }, sReadLayer = {0,};
+   const XML_ITEM asItems[] =
+   {
+      XML_STR( "body", SIMPLE_LAYER, szBody )
+   };
+   const char *pszDirectory = "xmlTestDir";
+   ERROR_CODE eRet = NO_ERROR;
+
+   PRINTF_TEST( "Atomic write" );
+   SetFileSyncPolicy( FILE_SYNC_FULL );
+   eRet = xmlWrapperWriteFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sWriteLayer );
+   SetFileSyncPolicy( FILE_SYNC_FILE );
+   RETURN_ON_FAIL( eRet );
+
+   // A write which can't replace its target fails & doesn't leave its temp file behind
+   mkdir( pszDirectory, 0755 );
+   eRet = xmlWrapperWriteFile( pszDirectory, asItems, ARRAY_COUNT( asItems ), &sWriteLayer );
+   rmdir( pszDirectory );
+   RETURN_ON_FAIL( eRet == FILE_ERROR ? NO_ERROR : TEST_FAILED );
+   RETURN_ON_FAIL( access( "xmlTestDir.tmp", F_OK ) != 0 ? NO_ERROR : TEST_FAILED );
+
+   RETURN_ON_FAIL( xmlWrapperParseFile( pszFileName, asItems, ARRAY_COUNT( asItems ), &sReadLayer ) );
+   RETURN_ON_FAIL( strcmp( sReadLayer.szBody, "Kept" ) == 0 ? NO_ERROR : TEST_FAILED );
+
+   return NO_ERROR;
+}
+
 static ERROR_CODE xmlTestWrite( const char *pszFileName )
 {
 typedef struct 
@@ -1242,9 +2696,18 @@ ERROR_CODE XmlTest(void)
    RETURN_ON_FAIL( xmlTestSubTableWithSiblingChild( pszFileName ) );
    RETURN_ON_FAIL( xmlTestSimpleArray( pszFileName ) );
    RETURN_ON_FAIL( xmlTestArrayWithSubTableAndSibling( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestArrayMissingField( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestNestedAndEmptyElements( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestCompiledSchemaReuse( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestParseMemory() );
+   RETURN_ON_FAIL( xmlTestExternalEntity( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestPushParser() );
+   RETURN_ON_FAIL( xmlTestDynamicArray( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestTypedFields( pszFileName ) );
    RETURN_ON_FAIL( xmlTestWriteSimpleLayer( pszFileName ) );
    RETURN_ON_FAIL( xmlTestWriteSubTable( pszFileName ) );
    RETURN_ON_FAIL( xmlTestWriteArray( pszFileName ) );
+   RETURN_ON_FAIL( xmlTestAtomicWrite( pszFileName ) );
    RETURN_ON_FAIL( xmlTestWrite( pszFileName ) );
 
 #undef PRINTF_TEST
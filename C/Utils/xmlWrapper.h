@@ -8,10 +8,11 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "Utils.h"
+#include "RecordArray.h"
 
 /* 
     Type of xml items for classification purposes
-    Currently each item & subitems will only return strings
+    Child items are converted once, when the document is parsed or written
  */
 typedef enum
 {
@@ -21,6 +22,19 @@ typedef enum
         <tag>STRING</tag>
      */
     XML_CHILD_STRING,
+    /* 
+        Same as XML_CHILD_STRING, stored as a uint32_t. Text which isn't a number is stored as 0
+        Eg:
+        <tag>42</tag>
+     */
+    XML_CHILD_U32,
+    /* 
+        Same as XML_CHILD_STRING, an RFC-822 date stored as a UTC time_t. A missing or invalid date is stored as 0
+        & 0 is written as an empty element
+        Eg:
+        <tag>Tue, 10 Mar 2020 18:30:00 +0530</tag>
+     */
+    XML_CHILD_TIME,
     /* 
         Nesting multiple XML Child Strings
         Eg:
@@ -32,6 +46,8 @@ typedef enum
     XML_TABLE,
     /* 
         Expansion of XML_TABLE such that multiple TABLES/Child Strings can be present
+        Sub items are looked up within their own <index>, a missing sub item is left empty
+        Empty records at the end of the array, i.e. every sub item is empty or 0, aren't written
         Eg:
         <index>
             ...
@@ -41,12 +57,17 @@ typedef enum
         </index>
         ...
      */
-    XML_SUB_ARRAY
+    XML_SUB_ARRAY,
+    /* 
+        Same as XML_SUB_ARRAY without a fixed size, the output variable is a RECORD_ARRAY
+        which grows with the number of <index> elements. It is emptied when a parse starts
+     */
+    XML_SUB_DYNAMIC_ARRAY
 } XML_TYPES;
 
 /* 
     Structure for each XML item
-    Currently will only fill in Strings so make sure you are only expecting strings
+    The output variable has to match the type, i.e. a char array, a uint32_t or a time_t
  */
 typedef struct
 {
@@ -56,9 +77,9 @@ typedef struct
     XML_TYPES eType;
     // Offset in the output structure
     uint32_t ulMemberOffset;
-    // Sizeof the output variable
+    // Sizeof the output variable, sizeof a single record for XML_SUB_DYNAMIC_ARRAY
     uint32_t ulBufferSize;
-    // Only applicable for XML_TABLE, XML_SUB_TABLE, pointer to the table containing XML_STRs
+    // Only applicable for XML_TABLE, XML_SUB_TABLE, pointer to the table containing child items
     const void *pavSubItem;
     // Only applicable for XML_TABLE number of XML_ITEMS in pvSubItem;
     uint32_t ulArrayElements;
@@ -70,6 +91,14 @@ typedef struct
     {                                                                                                    \
         element, XML_CHILD_STRING, offsetof(structure, var), sizeof(((structure *)0)->var), _null_, 0, 0 \
     }
+#define XML_U32(element, structure, var)                                                              \
+    {                                                                                                 \
+        element, XML_CHILD_U32, offsetof(structure, var), sizeof(((structure *)0)->var), _null_, 0, 0 \
+    }
+#define XML_TIME(element, structure, var)                                                              \
+    {                                                                                                  \
+        element, XML_CHILD_TIME, offsetof(structure, var), sizeof(((structure *)0)->var), _null_, 0, 0 \
+    }
 #define XML_SUB_TABLE(element, structure, var, subItem, numOfElements)                                         \
     {                                                                                                          \
         element, XML_TABLE, offsetof(structure, var), sizeof(((structure *)0)->var), subItem, numOfElements, 0 \
@@ -80,25 +109,156 @@ typedef struct
         element, XML_SUB_ARRAY, offsetof(structure, var), sizeof(((structure *)0)->var), subItem, numOfElements, arraySize \
     }
 
+// var has to be a RECORD_ARRAY, record is the type of its elements
+#define XML_DYNAMIC_ARRAY(element, structure, var, record, subItem, numOfElements)                             \
+    {                                                                                                          \
+        element, XML_SUB_DYNAMIC_ARRAY, offsetof(structure, var), sizeof(record), subItem, numOfElements, 0 \
+    }
+
+/* 
+    Compiled form of an XML_ITEM array
+    Element lookups are resolved once when the schema is compiled, build it once & reuse it for every parse
+ */
+typedef struct XML_SCHEMA XML_SCHEMA;
+
+/* 
+    Compiles an array of XML_ITEMs into a reusable schema
+    Element names have no length limit
+    @param(INPUT):      pasItems        -> Array of XML Items expected by the app, has to outlive the schema
+    @param(INPUT):      ulArraySize     -> Number of items in pasItems
+    @param(OUTPUT):     ppsSchema       -> Compiled schema, free with xmlWrapperFreeSchema
+    @return:            NO_ERROR        -> Success
+    @return:            INVALID_ARG     -> One or more parameters is null or an output variable doesn't match its type
+    @return:            NO_MEMORY       -> Schema couldn't be allocated
+ */
+ERROR_CODE xmlWrapperCompileSchema(const XML_ITEM *pasItems, uint32_t ulArraySize, XML_SCHEMA **ppsSchema);
+
+/* 
+    Frees a schema created by xmlWrapperCompileSchema
+    @param(INPUT):      psSchema        -> Schema to be freed, can be NULL
+ */
+void xmlWrapperFreeSchema(XML_SCHEMA *psSchema);
+
 /* 
     Parse an XML file & populate XML_Items
+    The file is streamed in a single forward pass, the whole document is never held in memory
     @param(INPUT):      pszFileName     -> Filename of the XML file to be parsed
     @param(INPUT):      pasItems        -> Array of XML Items expected by the app
     @param(INPUT):      ulArraySize     -> Number of items in pasItems
     @param(OUTPUT):     pvOutputStruct  -> The structure into which XML_ITEMS are gonna be populated
     @return:            NO_ERROR        -> Successful parsing
     @return:            INVALID_ARG     -> One or more parameters is null
+    @return:            FILE_ERROR      -> File couldn't be opened or isn't valid XML
+    @return:            NO_MEMORY       -> An XML_SUB_DYNAMIC_ARRAY couldn't be grown
  */
 ERROR_CODE xmlWrapperParseFile(const char *pszFileName, const XML_ITEM *pasItems, uint32_t ulArraySize, void *pvOutputStruct);
 
+/* 
+    Same as xmlWrapperParseFile, using a schema compiled beforehand
+    @param(INPUT):      pszFileName     -> Filename of the XML file to be parsed
+    @param(INPUT):      psSchema        -> Schema compiled by xmlWrapperCompileSchema
+    @param(OUTPUT):     pvOutputStruct  -> The structure into which XML_ITEMS are gonna be populated
+    @return:            NO_ERROR        -> Successful parsing
+    @return:            INVALID_ARG     -> One or more parameters is null
+    @return:            FILE_ERROR      -> File couldn't be opened or isn't valid XML
+    @return:            NO_MEMORY       -> An XML_SUB_DYNAMIC_ARRAY couldn't be grown
+ */
+ERROR_CODE xmlWrapperParseFileWithSchema(const char *pszFileName, const XML_SCHEMA *psSchema, void *pvOutputStruct);
+
+/* 
+    Parse an XML document held in memory & populate XML_Items
+    @param(INPUT):      pcBuffer        -> XML document, doesn't need to be NULL terminated
+    @param(INPUT):      ulSize          -> Size of the document in bytes
+    @param(INPUT):      pasItems        -> Array of XML Items expected by the app
+    @param(INPUT):      ulArraySize     -> Number of items in pasItems
+    @param(OUTPUT):     pvOutputStruct  -> The structure into which XML_ITEMS are gonna be populated
+    @return:            NO_ERROR        -> Successful parsing
+    @return:            INVALID_ARG     -> One or more parameters is null or the buffer is empty
+    @return:            FILE_ERROR      -> Buffer isn't valid XML
+    @return:            NO_MEMORY       -> An XML_SUB_DYNAMIC_ARRAY couldn't be grown
+ */
+ERROR_CODE xmlWrapperParseMemory(const char *pcBuffer, size_t ulSize, const XML_ITEM *pasItems, uint32_t ulArraySize, void *pvOutputStruct);
+
+/* 
+    Same as xmlWrapperParseMemory, using a schema compiled beforehand
+    @param(INPUT):      pcBuffer        -> XML document, doesn't need to be NULL terminated
+    @param(INPUT):      ulSize          -> Size of the document in bytes
+    @param(INPUT):      psSchema        -> Schema compiled by xmlWrapperCompileSchema
+    @param(OUTPUT):     pvOutputStruct  -> The structure into which XML_ITEMS are gonna be populated
+    @return:            NO_ERROR        -> Successful parsing
+    @return:            INVALID_ARG     -> One or more parameters is null or the buffer is empty
+    @return:            FILE_ERROR      -> Buffer isn't valid XML
+    @return:            NO_MEMORY       -> An XML_SUB_DYNAMIC_ARRAY couldn't be grown
+ */
+ERROR_CODE xmlWrapperParseMemoryWithSchema(const char *pcBuffer, size_t ulSize, const XML_SCHEMA *psSchema, void *pvOutputStruct);
+
+/* 
+    Called every time an XML_SUB_ARRAY or XML_SUB_DYNAMIC_ARRAY element has been parsed completely
+    @param(INPUT):      pvRecord        -> Array element which has just been filled
+    @param(INPUT):      ulIndex         -> Index of pvRecord in its array
+    @param(INPUT):      pvUserData      -> As passed to xmlWrapperPushStart
+    @return:            NO_ERROR        -> Keep on parsing, any other value stops the parse & is returned to the caller
+ */
+typedef ERROR_CODE ( *XML_RECORD_CALLBACK )( void *pvRecord, uint32_t ulIndex, void *pvUserData );
+
+/* 
+    Incremental parse of a document which arrives in chunks, e.g. while it is being downloaded
+    Records are filled & reported while the rest of the document is still on its way
+ */
+typedef struct XML_PUSH_PARSER XML_PUSH_PARSER;
+
+/* 
+    Starts an incremental parse
+    @param(INPUT):      psSchema        -> Schema compiled by xmlWrapperCompileSchema, has to outlive the parser
+    @param(OUTPUT):     pvOutputStruct  -> The structure into which XML_ITEMS are gonna be populated
+    @param(INPUT):      pfnOnRecord     -> Optional, called for every completed array element
+    @param(INPUT):      pvUserData      -> Passed on to pfnOnRecord
+    @param(OUTPUT):     ppsParser       -> Parser, finish it with xmlWrapperPushFinish or drop it with xmlWrapperPushFree
+    @return:            NO_ERROR        -> Success
+    @return:            INVALID_ARG     -> One or more parameters is null
+    @return:            NO_MEMORY       -> Parser couldn't be allocated
+ */
+ERROR_CODE xmlWrapperPushStart( const XML_SCHEMA *psSchema, void *pvOutputStruct, XML_RECORD_CALLBACK pfnOnRecord, void *pvUserData, XML_PUSH_PARSER **ppsParser );
+
+/* 
+    Parses the next chunk of the document
+    @param(INPUT):      psParser        -> Parser started by xmlWrapperPushStart
+    @param(INPUT):      pcChunk         -> Next bytes of the document, chunks can split elements anywhere
+    @param(INPUT):      ulSize          -> Size of the chunk in bytes
+    @return:            NO_ERROR        -> Success
+    @return:            INVALID_ARG     -> One or more parameters is null
+    @return:            FILE_ERROR      -> Document isn't valid XML
+    @return:            NO_MEMORY       -> An XML_SUB_DYNAMIC_ARRAY couldn't be grown
+    @return:            Other           -> Error returned by pfnOnRecord, the parse is stopped
+ */
+ERROR_CODE xmlWrapperPushChunk( XML_PUSH_PARSER *psParser, const char *pcChunk, size_t ulSize );
+
+/* 
+    Ends an incremental parse & frees the parser
+    @param(INPUT):      psParser        -> Parser started by xmlWrapperPushStart
+    @return:            NO_ERROR        -> The whole document has been parsed
+    @return:            FILE_ERROR      -> Document is incomplete or isn't valid XML
+    @return:            Other           -> Error returned earlier by pfnOnRecord
+ */
+ERROR_CODE xmlWrapperPushFinish( XML_PUSH_PARSER *psParser );
+
+/* 
+    Frees a parser without finishing the parse, e.g. when the download failed
+    @param(INPUT):      psParser        -> Parser to be freed, can be NULL
+ */
+void xmlWrapperPushFree( XML_PUSH_PARSER *psParser );
+
 /* 
     Write/Overwrite an XML file by using the  XML_Items
+    Arrays are written up to their last record holding data, the size of the file follows the data
+    The file is replaced atomically, see FILE_SYNC_POLICY
     @param(INPUT):      pszFileName     -> Filename of the XML file to be written
     @param(INPUT):      pasItems        -> Array of XML Items supplied by the app
     @param(INPUT):      ulArraySize     -> Number of items in pasItems
     @param(INPUT):      pvInputStruct   -> The structure from which XML_ITEMS are gonna be extracted
     @return:            NO_ERROR        -> Successful parsing
     @return:            INVALID_ARG     -> One or more parameters is null
+    @return:            FILE_ERROR      -> File couldn't be written, the old file is left untouched
  */
 ERROR_CODE xmlWrapperWriteFile(const char *pszFileName, const XML_ITEM *pasItems, uint32_t ulArraySize, const void *pvInputStruct);
 
@@ -17,13 +17,24 @@ static BOT_CONFIG s_sBotConfig = { 0, };
 static const XML_ITEM s_apsConfigKeys[] = 
 {
    XML_STR( "currentFilename",  BOT_CONFIG, szRssFilename      ),
-   XML_STR( "daysToFileUpdate", BOT_CONFIG, szDaysUntilUpdate  ),
+   XML_U32( "daysToFileUpdate", BOT_CONFIG, ulDaysUntilUpdate  ),
+   XML_U32( "maxFeedItems",     BOT_CONFIG, ulMaxFeedItems     ),
+   XML_STR( "feedETag",         BOT_CONFIG, szFeedETag         ),
+   XML_TIME( "feedLastModified", BOT_CONFIG, tFeedLastModified ),
+   XML_U32( "feedTtl",          BOT_CONFIG, ulFeedTtl          ),
+   XML_U32( "feedUpdateInterval", BOT_CONFIG, ulFeedUpdateInterval ),
 };
+static XML_SCHEMA *s_psConfigSchema = _null_;
+// Changes are kept in memory until Config_Flush while set
+static bool s_bDeferWrites = false;
+// Set when s_sBotConfig has changes which aren't in the config file yet
+static bool s_bDirty = false;
 
 static void DebugConfig( void );
 static ERROR_CODE Config_Reset( void );
 static ERROR_CODE WriteConfig( const BOT_CONFIG *psBotConfig );
 static ERROR_CODE Config_Read( void );
+static ERROR_CODE Config_Changed( void );
 
 ERROR_CODE Config_Init( void )
 {
@@ -45,14 +56,19 @@ static ERROR_CODE Config_Read(void)
 {
    ERROR_CODE eRet = NO_ERROR;
 
-   eRet = xmlWrapperParseFile( CONFIG_FILENAME, s_apsConfigKeys, ARRAY_COUNT( s_apsConfigKeys ), &s_sBotConfig );
+   if( s_psConfigSchema == _null_ )
+   {
+      RETURN_ON_FAIL( xmlWrapperCompileSchema( s_apsConfigKeys, ARRAY_COUNT( s_apsConfigKeys ), &s_psConfigSchema ) );
+   }
+
+   eRet = xmlWrapperParseFileWithSchema( CONFIG_FILENAME, s_psConfigSchema, &s_sBotConfig );
 
    return eRet;
 }
 
 bool IsNewFileRequired()
 {
-   return ( atoi( s_sBotConfig.szDaysUntilUpdate ) == 0 );
+   return ( s_sBotConfig.ulDaysUntilUpdate == 0 );
 }
 
 ERROR_CODE Config_GetRssFilename( char *pszFilename, uint32_t ulBufferSize )
@@ -63,12 +79,44 @@ ERROR_CODE Config_GetRssFilename( char *pszFilename, uint32_t ulBufferSize )
    return Strcpy_safe( pszFilename, s_sBotConfig.szRssFilename, ulBufferSize );
 }
 
-ERROR_CODE Config_GetDaysUntilUpdate( char *pszDaysUntilUpdate, uint32_t ulBufferSize )
+ERROR_CODE Config_GetDaysUntilUpdate( uint32_t *pulDaysUntilUpdate )
+{
+   RETURN_ON_NULL( pulDaysUntilUpdate );
+
+   *pulDaysUntilUpdate = s_sBotConfig.ulDaysUntilUpdate;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE Config_GetMaxFeedItems( uint32_t *pulMaxFeedItems )
+{
+   RETURN_ON_NULL( pulMaxFeedItems );
+
+   *pulMaxFeedItems = s_sBotConfig.ulMaxFeedItems;
+
+   return NO_ERROR;
+}
+
+ERROR_CODE Config_GetFeedValidators( char *pszETag, uint32_t ulBufferSize, time_t *ptLastModified )
 {
-   RETURN_ON_NULL( pszDaysUntilUpdate );
+   RETURN_ON_NULL( pszETag );
+   RETURN_ON_NULL( ptLastModified );
    UTIL_ASSERT( ulBufferSize != 0, INVALID_ARG );
 
-   return Strcpy_safe( pszDaysUntilUpdate, s_sBotConfig.szDaysUntilUpdate, ulBufferSize );
+   *ptLastModified = s_sBotConfig.tFeedLastModified;
+
+   return Strcpy_safe( pszETag, s_sBotConfig.szFeedETag, ulBufferSize );
+}
+
+ERROR_CODE Config_GetFeedHints( uint32_t *pulTtl, uint32_t *pulUpdateInterval )
+{
+   RETURN_ON_NULL( pulTtl );
+   RETURN_ON_NULL( pulUpdateInterval );
+
+   *pulTtl = s_sBotConfig.ulFeedTtl;
+   *pulUpdateInterval = s_sBotConfig.ulFeedUpdateInterval;
+
+   return NO_ERROR;
 }
 
 ERROR_CODE Config_SetRssFilename( const char *pszFilename )
@@ -77,14 +125,64 @@ ERROR_CODE Config_SetRssFilename( const char *pszFilename )
 
    RETURN_ON_FAIL( Strcpy_safe( s_sBotConfig.szRssFilename, pszFilename, sizeof( s_sBotConfig.szRssFilename ) ) );
 
-   return WriteConfig( &s_sBotConfig );
+   return Config_Changed();
+}
+
+ERROR_CODE Config_SetDaysUntilUpdate( uint32_t ulDaysUntilUpdate )
+{
+   s_sBotConfig.ulDaysUntilUpdate = ulDaysUntilUpdate;
+
+   return Config_Changed();
+}
+
+ERROR_CODE Config_SetFeedValidators( const char *pszETag, time_t tLastModified )
+{
+   RETURN_ON_NULL( pszETag );
+
+   RETURN_ON_FAIL( Strcpy_safe( s_sBotConfig.szFeedETag, pszETag, sizeof( s_sBotConfig.szFeedETag ) ) );
+   s_sBotConfig.tFeedLastModified = tLastModified;
+
+   return Config_Changed();
+}
+
+ERROR_CODE Config_SetFeedHints( uint32_t ulTtl, uint32_t ulUpdateInterval )
+{
+   // Most refreshes find the same hints, the config isn't written for nothing
+   if( ulTtl == s_sBotConfig.ulFeedTtl && ulUpdateInterval == s_sBotConfig.ulFeedUpdateInterval )
+      return NO_ERROR;
+
+   s_sBotConfig.ulFeedTtl = ulTtl;
+   s_sBotConfig.ulFeedUpdateInterval = ulUpdateInterval;
+
+   return Config_Changed();
+}
+
+void Config_DeferWrites( bool bDefer )
+{
+   s_bDeferWrites = bDefer;
 }
 
-ERROR_CODE Config_SetDaysUntilUpdate( const char *pszDaysUntilUpdate )
+ERROR_CODE Config_Flush( void )
 {
-   RETURN_ON_NULL( pszDaysUntilUpdate );
+   if( s_bDirty )
+   {
+      RETURN_ON_FAIL( WriteConfig( &s_sBotConfig ) );
+      s_bDirty = false;
+   }
 
-   RETURN_ON_FAIL( Strcpy_safe( s_sBotConfig.szDaysUntilUpdate, pszDaysUntilUpdate, sizeof( s_sBotConfig.szDaysUntilUpdate ) ) );
+   return NO_ERROR;
+}
+
+/* 
+   Writes a change to the config file, or only marks the config as changed while writes are deferred
+ */
+static ERROR_CODE Config_Changed( void )
+{
+   if( s_bDeferWrites )
+   {
+      s_bDirty = true;
+      return NO_ERROR;
+   }
 
    return WriteConfig( &s_sBotConfig );
 }
@@ -95,7 +193,10 @@ static void DebugConfig(void)
    DBG_PRINTF( "------------------------------" );
    DBG_PRINTF( "Debugging config.xml" );
    DBG_PRINTF( "Current filename = %s", s_sBotConfig.szRssFilename );
-   DBG_PRINTF( "Days Until Next Update = %s", s_sBotConfig.szDaysUntilUpdate );
+   DBG_PRINTF( "Days Until Next Update = %u", s_sBotConfig.ulDaysUntilUpdate );
+   DBG_PRINTF( "Max Feed Items = %u", s_sBotConfig.ulMaxFeedItems );
+   DBG_PRINTF( "Feed ETag = %s", s_sBotConfig.szFeedETag );
+   DBG_PRINTF( "Feed TTL = %u, Update Interval = %u", s_sBotConfig.ulFeedTtl, s_sBotConfig.ulFeedUpdateInterval );
    DBG_PRINTF( "------------------------------" );
 #endif
 }
@@ -105,7 +206,7 @@ static ERROR_CODE Config_Reset(void)
    BOT_CONFIG sBotConfig = { 0, };
    
    GenerateFileName( sBotConfig.szRssFilename, sizeof( sBotConfig.szRssFilename ) );
-   Strcpy_safe( sBotConfig.szDaysUntilUpdate, "0", sizeof( sBotConfig.szDaysUntilUpdate ) );
+   sBotConfig.ulDaysUntilUpdate = 0;
 
    RETURN_ON_FAIL( WriteConfig( &sBotConfig ) );
 
@@ -12,14 +12,22 @@
 
 /* 
     Stores the config for the bot
-    Each config item should only be a string
+    Numbers are converted when the config file is read
  */
 typedef struct
 {
     // RSS file which is downloaded from the blogsite
     char szRssFilename[MAX_FILENAME_LEN + 1];
     // Decrementing counter until Bot downloads a new RSS file
-    char szDaysUntilUpdate[2 + 1];
+    uint32_t ulDaysUntilUpdate;
+    // Optional, number of feed posts looked at on a refresh. Empty or 0 looks at every post
+    uint32_t ulMaxFeedItems;
+    // Validators of the last feed downloaded, the feed isn't downloaded again until it changes
+    char szFeedETag[128 + 1];
+    time_t tFeedLastModified;
+    // Hints of the last feed downloaded in seconds, kept for the refreshes where the feed hasn't changed
+    uint32_t ulFeedTtl;
+    uint32_t ulFeedUpdateInterval;
 } BOT_CONFIG;
 
 /* 
@@ -33,10 +41,10 @@ typedef struct
 ERROR_CODE Config_Init(void);
 
 /* 
-    Checks config parameter szDaysUntilUpdate
+    Checks config parameter ulDaysUntilUpdate
     @param:         NONE
-    @return:        true    -> szDaysUntilUpdate is 0 or empty
-    @return:        false   -> szDaysUntilupdate is not 0 or empty
+    @return:        true    -> ulDaysUntilUpdate is 0 or empty
+    @return:        false   -> ulDaysUntilUpdate is not 0
  */
 bool IsNewFileRequired(void);
 
@@ -51,12 +59,38 @@ ERROR_CODE Config_GetRssFilename(char *pszFilename, uint32_t ulBufferSize);
 
 /* 
     Gets days until update for the downloaded RSS file
-    @param(INPUT):      pszDaysUntilUpdate      -> String to hold the number of days
-    @param(INPUT):      ulBufferSize            -> Buffer size
+    @param(OUTPUT):     pulDaysUntilUpdate      -> Number of days
     @return:            NO_ERROR                -> Success
-    @return:            INVALID_ARG             -> One or both parameters are invalid
+    @return:            INVALID_ARG             -> pulDaysUntilUpdate is NULL
  */
-ERROR_CODE Config_GetDaysUntilUpdate(char *pszDaysUntilUpdate, uint32_t ulBufferSize);
+ERROR_CODE Config_GetDaysUntilUpdate(uint32_t *pulDaysUntilUpdate);
+
+/* 
+    Gets the number of feed posts looked at on a refresh
+    @param(OUTPUT):     pulMaxFeedItems         -> Number of posts, 0 if there is no limit
+    @return:            NO_ERROR                -> Success
+    @return:            INVALID_ARG             -> pulMaxFeedItems is NULL
+ */
+ERROR_CODE Config_GetMaxFeedItems(uint32_t *pulMaxFeedItems);
+
+/* 
+    Gets the validators of the last feed downloaded, empty or 0 if the server didn't send them
+    @param(OUTPUT):     pszETag                 -> ETag of the feed
+    @param(INPUT):      ulBufferSize            -> Buffer size of pszETag
+    @param(OUTPUT):     ptLastModified          -> Last modification of the feed
+    @return:            NO_ERROR                -> Success
+    @return:            INVALID_ARG             -> One or more parameters are invalid
+ */
+ERROR_CODE Config_GetFeedValidators(char *pszETag, uint32_t ulBufferSize, time_t *ptLastModified);
+
+/* 
+    Gets the hints of the last feed downloaded on how often to fetch it, 0 if the feed didn't have them
+    @param(OUTPUT):     pulTtl                  -> Seconds the feed shouldn't be fetched again for
+    @param(OUTPUT):     pulUpdateInterval       -> Seconds between updates of the feed
+    @return:            NO_ERROR                -> Success
+    @return:            INVALID_ARG             -> One or more parameters are NULL
+ */
+ERROR_CODE Config_GetFeedHints(uint32_t *pulTtl, uint32_t *pulUpdateInterval);
 
 /* 
     Sets filename of the downloaded RSS file
@@ -68,10 +102,44 @@ ERROR_CODE Config_SetRssFilename(const char *pszFilename);
 
 /* 
     Sets daysUntilUpdate for the downloaded RSS file
-    @param(INPUT):      pszDaysUntilUpdate  -> Filename of the RSS file
+    @param(INPUT):      ulDaysUntilUpdate   -> Number of days
+    @return:            NO_ERROR            -> Success
+    @return:            FILE_ERROR          -> Config file couldn't be written
+ */
+ERROR_CODE Config_SetDaysUntilUpdate(uint32_t ulDaysUntilUpdate);
+
+/* 
+    Sets the validators of the feed which has just been downloaded
+    @param(INPUT):      pszETag             -> ETag of the feed, empty if there is none
+    @param(INPUT):      tLastModified       -> Last modification of the feed, 0 if unknown
+    @return:            NO_ERROR            -> Success
+    @return:            INVALID_ARG         -> pszETag is NULL
+    @return:            FILE_ERROR          -> Config file couldn't be written
+ */
+ERROR_CODE Config_SetFeedValidators(const char *pszETag, time_t tLastModified);
+
+/* 
+    Sets the hints of the feed which has just been downloaded
+    @param(INPUT):      ulTtl               -> Seconds the feed shouldn't be fetched again for, 0 if unknown
+    @param(INPUT):      ulUpdateInterval    -> Seconds between updates of the feed, 0 if unknown
     @return:            NO_ERROR            -> Success
-    @return:            INVALID_ARG         -> Input parameters are invalid
+    @return:            FILE_ERROR          -> Config file couldn't be written
+ */
+ERROR_CODE Config_SetFeedHints(uint32_t ulTtl, uint32_t ulUpdateInterval);
+
+/* 
+    Keeps changes to the config in memory instead of writing the config file on every change
+    Pending changes are only written by Config_Flush, turning deferral off doesn't write them
+    @param(INPUT):      bDefer              -> true to defer writes, false to write every change
+ */
+void Config_DeferWrites(bool bDefer);
+
+/* 
+    Writes the config file if the config has changed since it was last written
+    @param:             NONE
+    @return:            NO_ERROR            -> Success, or nothing to write
+    @return:            FILE_ERROR          -> Config file couldn't be written, the changes are kept
  */
-ERROR_CODE Config_SetDaysUntilUpdate(const char *pszDaysUntilUpdate);
+ERROR_CODE Config_Flush(void);
 
 #endif
\ No newline at end of file
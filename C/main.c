@@ -3,14 +3,62 @@
 * Date: 30th Novemeber 2019
 */
 
+#include <signal.h>
+#include <unistd.h>
 #include "Utils.h"
 #include "config.h"
 #include "CurlWrapper.h"
+#include "TimerWheel.h"
 #include "Database.h"
+#include "Transaction.h"
+#include "FeedPipeline.h"
 
 #define BLOG_FEED_URL            ( "https://itsmayurremember.wordpress.com/feed" )
-#define DAYS_UNTIL_NEXT_UPDATE   ( "14" )
+// Countdown when neither the feed nor its posts tell how often the blog is updated
+#define DAYS_UNTIL_NEXT_UPDATE   ( 14 )
+// Bounds of the countdown worked out from the feed, the feed is fetched at most once per post
+#define REFRESH_MIN_DAYS         ( 1 )
+#define REFRESH_MAX_DAYS         ( 28 )
 #define PERFORM_TESTS            ( 0 )
+// Keep a copy of every downloaded feed on the disk, used to rebuild a missing database
+#define ARCHIVE_FEED_FILE        ( 1 )
+// Parse the feed while it is being downloaded instead of after the download
+#define PIPELINE_FEED_PARSING    ( 1 )
+// "--daemon" posts once per interval, a countdown day being one interval
+#define DAEMON_POST_INTERVAL     ( 24 * 60 * 60 )
+// The feed is refreshed this long before the post which needs it
+#define DAEMON_REFRESH_LEAD      ( 60 * 60 )
+#define DAEMON_TICK_SECONDS      ( 60 )
+// Longest sleep, so that a change to the clock is noticed
+#define DAEMON_MAX_SLEEP         ( 60 * 60 )
+
+/* 
+    State kept by "--daemon" between its timers
+ */
+typedef struct
+{
+    TIMER_WHEEL sWheel;
+    TIMER sPostTimer;
+    TIMER sRefreshTimer;
+    // Time the post timer is due at, posts don't drift by the time they take
+    time_t tNextPost;
+    CURL_SESSION sSession;
+    DATABASE_HANDLE hDatabase;
+} BOT_DAEMON;
+
+/* 
+    Feed being downloaded & parsed into the database at the same time
+ */
+typedef struct
+{
+    DATABASE_HANDLE hDatabase;
+    // Whole feed, for the archive
+    FEED_BUFFER sFeed;
+} FEED_REFRESH;
+
+// Set by SIGINT & SIGTERM
+static volatile sig_atomic_t s_bStopDaemon = 0;
+
 // Static Functions
 
 // Application flow:
@@ -25,20 +73,166 @@
 // It will give us a post
 
 
-static ERROR_CODE readyPostForPublishing()
+#if PIPELINE_FEED_PARSING
+static ERROR_CODE onFeedChunk( const char *pcChunk, size_t ulSize, void *pvRefresh )
+{
+   FEED_REFRESH *psRefresh = ( FEED_REFRESH * )pvRefresh;
+#if ARCHIVE_FEED_FILE
+   ERROR_CODE eRet = NO_ERROR;
+
+   // The archive still needs the whole feed, only the parsing stops early
+   RETURN_ON_FAIL( FeedBuffer_Append( &psRefresh->sFeed, pcChunk, ulSize ) );
+   eRet = Database_PushRefreshData( psRefresh->hDatabase, pcChunk, ulSize );
+
+   return ( eRet == STOPPED ) ? NO_ERROR : eRet;
+#else
+   // STOPPED aborts the rest of the download
+   return Database_PushRefreshData( psRefresh->hDatabase, pcChunk, ulSize );
+#endif
+}
+#endif
+
+/* 
+    Sets the countdown to the next refresh from how often the blog publishes
+    @param bFeedParsed: false if the feed hadn't changed, the hints of the last feed parsed are used
+ */
+static ERROR_CODE scheduleNextRefresh( DATABASE_HANDLE hDatabase, bool bFeedParsed )
+{
+   FEED_HINTS sHints = { 0, };
+   uint32_t ulSeconds = 0;
+   uint32_t ulDays = DAYS_UNTIL_NEXT_UPDATE;
+   ERROR_CODE eRet = NO_ERROR;
+
+   if( bFeedParsed )
+   {
+      RETURN_ON_FAIL( Database_GetFeedHints( hDatabase, &sHints ) );
+      RETURN_ON_FAIL( Config_SetFeedHints( sHints.ulTtl, sHints.ulUpdateInterval ) );
+   }
+   else
+   {
+      RETURN_ON_FAIL( Config_GetFeedHints( &sHints.ulTtl, &sHints.ulUpdateInterval ) );
+   }
+
+   eRet = Database_GetRefreshInterval( hDatabase, &sHints, time( _null_ ), &ulSeconds );
+   if( eRet == NO_ERROR )
+   {
+      // A countdown day is one post
+      ulDays = ulSeconds / DAEMON_POST_INTERVAL + ( ( ulSeconds % DAEMON_POST_INTERVAL ) != 0 );
+      ulDays = ( ulDays < REFRESH_MIN_DAYS ) ? REFRESH_MIN_DAYS : ulDays;
+      ulDays = ( ulDays > REFRESH_MAX_DAYS ) ? REFRESH_MAX_DAYS : ulDays;
+   }
+   else
+   {
+      RETURN_ON_FAIL( ( eRet == NOT_FOUND ) ? NO_ERROR : eRet );
+   }
+   DBG_PRINTF( "Next refresh in [%u] days", ulDays );
+
+   return Config_SetDaysUntilUpdate( ulDays );
+}
+
+static ERROR_CODE refreshFeed( DATABASE_HANDLE hDatabase, CURL_SESSION * psSession )
+{
+#if PIPELINE_FEED_PARSING
+   FEED_REFRESH sRefresh = { hDatabase, { 0, } };
+   FEED_BUFFER *psFeed = &sRefresh.sFeed;
+#else
+   FEED_BUFFER sFeed = { 0, };
+   FEED_BUFFER *psFeed = &sFeed;
+#endif
+   FEED_VALIDATORS sValidators = { { 0, }, 0 };
+   ERROR_CODE eRet = NO_ERROR;
+#if ARCHIVE_FEED_FILE
+   char szFilename[MAX_FILENAME_LEN + 1] = { 0, };
+   FEED_ARCHIVE sArchive = { 0, };
+#endif
+#if PIPELINE_FEED_PARSING
+   uint32_t ulMaxFeedItems = 0;
+#endif
+
+   DBG_PRINTF( "Downloading new feed file" );
+   // The feed is only downloaded again if it has changed since the last refresh
+   RETURN_ON_FAIL( Config_GetFeedValidators( sValidators.szETag, sizeof( sValidators.szETag ), &sValidators.tLastModified ) );
+#if PIPELINE_FEED_PARSING
+   RETURN_ON_FAIL( Config_GetMaxFeedItems( &ulMaxFeedItems ) );
+   RETURN_ON_FAIL( Database_BeginRefresh( hDatabase, ulMaxFeedItems ) );
+   eRet = DownloadFeedStream( psSession, BLOG_FEED_URL, &sValidators, onFeedChunk, &sRefresh );
+   if( ISERROR( eRet ) && eRet != STOPPED )
+   {
+      // Database_BeginRefresh has loaded the database, there is nothing to parse
+      Database_CancelRefresh( hDatabase );
+      FeedBuffer_Free( psFeed );
+      RETURN_ON_FAIL( ( eRet == NOT_MODIFIED ) ? NO_ERROR : eRet );
+      return scheduleNextRefresh( hDatabase, false );
+   }
+   eRet = NO_ERROR;
+#else
+   eRet = DownloadFeedToBuffer( psSession, BLOG_FEED_URL, &sValidators, psFeed );
+   if( eRet == NOT_MODIFIED )
+   {
+      RETURN_ON_FAIL( Database_Init( hDatabase ) );
+      return scheduleNextRefresh( hDatabase, false );
+   }
+   RETURN_ON_FAIL( eRet );
+#endif
+
+#if ARCHIVE_FEED_FILE
+   // The feed is written onto the disk while the database is being refreshed
+   eRet = GenerateFileName( szFilename, sizeof( szFilename ) );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = FeedArchive_Start( &sArchive, psFeed, szFilename );
+   }
+#endif
+
+#if PIPELINE_FEED_PARSING
+   if( ISERROR( eRet ) )
+   {
+      Database_CancelRefresh( hDatabase );
+   }
+   else
+   {
+      eRet = Database_EndRefresh( hDatabase );
+   }
+#else
+   if( !ISERROR( eRet ) )
+   {
+      eRet = Database_RefreshDatabaseFromMemory( hDatabase, psFeed->pcData, psFeed->ulSize );
+   }
+#endif
+
+#if ARCHIVE_FEED_FILE
+   if( ISERROR( FeedArchive_Wait( &sArchive ) ) )
+   {
+      DBG_PRINTF( "Feed couldn't be archived to [%s]", szFilename );
+   }
+   else
+   {
+      RETURN_ON_FAIL( Config_SetRssFilename( szFilename ) );
+   }
+#endif
+   FeedBuffer_Free( psFeed );
+   RETURN_ON_FAIL( eRet );
+
+   // Only kept once the feed is in the database, otherwise the next refresh would skip it
+   RETURN_ON_FAIL( Config_SetFeedValidators( sValidators.szETag, sValidators.tLastModified ) );
+
+   return scheduleNextRefresh( hDatabase, true );
+}
+
+static ERROR_CODE readyPostForPublishing( DATABASE_HANDLE hDatabase )
 {
    BLOG_POST sPost = {0, };
-   char szDaysUntilUpdate[2 + 1] = {0, };
    uint32_t ulDays = 0;
 
-   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( &sPost ) );
-   RETURN_ON_FAIL( Config_GetDaysUntilUpdate( szDaysUntilUpdate, sizeof( szDaysUntilUpdate ) ) );
+   RETURN_ON_FAIL( Database_GetOldestLeastSharedPost( hDatabase, &sPost ) );
+   RETURN_ON_FAIL( Config_GetDaysUntilUpdate( &ulDays ) );
 
-   ulDays = atol( szDaysUntilUpdate );
-   ulDays--;
-   snprintf( szDaysUntilUpdate, sizeof( szDaysUntilUpdate ), "%u", ulDays );
-   RETURN_ON_FAIL( Config_SetDaysUntilUpdate( szDaysUntilUpdate ) );
-   RETURN_ON_FAIL( Database_UpdateTimesShared( &sPost ) );
+   if( ulDays > 0 )
+   {
+      ulDays--;
+   }
+   RETURN_ON_FAIL( Config_SetDaysUntilUpdate( ulDays ) );
+   RETURN_ON_FAIL( Database_UpdateTimesShared( hDatabase, &sPost ) );
 
    DBG_PRINTF( "Oldest Post is: " );
    DBG_PRINTF( "Title = [%s]", sPost.szTitle );
@@ -51,35 +245,259 @@ static ERROR_CODE readyPostForPublishing()
    return NO_ERROR;
 }
 
-int main()
+/* 
+    Refreshes the feed if it is time to & posts, as a single run of the bot does
+ */
+static ERROR_CODE runOnce( DATABASE_HANDLE hDatabase )
 {
-   DBG_INIT();
+   if( IsNewFileRequired() )
+   {
+      CURL_SESSION sSession = { 0, };
+      ERROR_CODE eRet = CurlSession_Init( &sSession );
 
-#if PERFORM_TESTS
-   RETURN_ON_FAIL( XmlTest() );
-   RETURN_ON_FAIL( Database_Tests() );
-#else
+      if( !ISERROR( eRet ) )
+      {
+         eRet = refreshFeed( hDatabase, &sSession );
+      }
+      CurlSession_Free( &sSession );
+      RETURN_ON_FAIL( eRet );
+   } 
+   else
+   {
+      RETURN_ON_FAIL( Database_Init( hDatabase ) );
+   }
 
-   RETURN_ON_FAIL( Config_Init() );
+   return readyPostForPublishing( hDatabase );
+}
+
+/* 
+    Commits the transaction of a run whatever the run returned, the changes made before an error are kept
+ */
+static ERROR_CODE commitRun( DATABASE_HANDLE hDatabase, ERROR_CODE eRunResult )
+{
+   ERROR_CODE eRet = Transaction_Commit( hDatabase );
 
+   return ISERROR( eRunResult ) ? eRunResult : eRet;
+}
+
+static void daemonOnRefresh( TIMER_WHEEL *psWheel, TIMER *psTimer, void *pvDaemon )
+{
+   BOT_DAEMON *psDaemon = ( BOT_DAEMON * )pvDaemon;
+   ERROR_CODE eRet = NO_ERROR;
+
+   ( void )psWheel;
+   ( void )psTimer;
+   // A failed refresh is tried again by the post which needs it
+   eRet = Transaction_Begin( psDaemon->hDatabase );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = commitRun( psDaemon->hDatabase, refreshFeed( psDaemon->hDatabase, &psDaemon->sSession ) );
+   }
+   if( ISERROR( eRet ) )
+   {
+      DBG_PRINTF( "Refresh failed = [%d]", eRet );
+   }
+}
+
+static void daemonOnPost( TIMER_WHEEL *psWheel, TIMER *psTimer, void *pvDaemon )
+{
+   BOT_DAEMON *psDaemon = ( BOT_DAEMON * )pvDaemon;
+   ERROR_CODE eRet = NO_ERROR;
+
+   eRet = Transaction_Begin( psDaemon->hDatabase );
+   if( !ISERROR( eRet ) )
+   {
+      if( IsNewFileRequired() )
+      {
+         eRet = refreshFeed( psDaemon->hDatabase, &psDaemon->sSession );
+      }
+      if( !ISERROR( eRet ) )
+      {
+         eRet = readyPostForPublishing( psDaemon->hDatabase );
+         fflush( stdout );
+      }
+      eRet = commitRun( psDaemon->hDatabase, eRet );
+   }
+   if( ISERROR( eRet ) )
+   {
+      DBG_PRINTF( "Post failed = [%d]", eRet );
+   }
+
+   psDaemon->tNextPost += DAEMON_POST_INTERVAL;
+   // Posts missed while the machine was asleep aren't caught up on
+   if( psDaemon->tNextPost < time( _null_ ) )
+   {
+      psDaemon->tNextPost = time( _null_ ) + DAEMON_POST_INTERVAL;
+   }
+   TimerWheel_Schedule( psWheel, psTimer, psDaemon->tNextPost, daemonOnPost, psDaemon );
    if( IsNewFileRequired() )
    {
-      char szFilename[MAX_FILENAME_LEN + 1] = { 0, };
+      TimerWheel_Schedule( psWheel, &psDaemon->sRefreshTimer, psDaemon->tNextPost - DAEMON_REFRESH_LEAD, daemonOnRefresh, psDaemon );
+   }
+}
 
-      DBG_PRINTF( "Downloading new feed file" );
-      RETURN_ON_FAIL( GenerateFileName( szFilename, sizeof( szFilename ) ) );
-      RETURN_ON_FAIL( DownloadFeedFile( BLOG_FEED_URL, szFilename ) );
-      RETURN_ON_FAIL( Config_SetDaysUntilUpdate( DAYS_UNTIL_NEXT_UPDATE ) );
-      RETURN_ON_FAIL( Config_SetRssFilename( szFilename ) );
-      RETURN_ON_FAIL( Database_RefreshDatabase() );
-   } 
-   else
+/* 
+    Merges the posts of several feeds into the database at once, e.g. of the other blogs shared by the bot
+    Their validators & hints aren't kept, only the blog's own feed has them in the config
+ */
+static ERROR_CODE refreshFeeds( DATABASE_HANDLE hDatabase, char *apszURLs[], uint32_t ulCount )
+{
+   FEED_PIPELINE_OPTIONS sOptions = { { 0, }, 0, 0, 0 };
+   CURL_SESSION sSession = { 0, };
+   FEED_REQUEST *pasRequests = calloc( ulCount, sizeof( FEED_REQUEST ) );
+   ERROR_CODE eRet = NO_ERROR;
+
+   UTIL_ASSERT( pasRequests, NO_MEMORY );
+   for( uint32_t x = 0; x < ulCount; x++ )
    {
-      RETURN_ON_FAIL( Database_Init( ) );
+      pasRequests[x].pszURL = apszURLs[x];
    }
-   
 
-   RETURN_ON_FAIL( readyPostForPublishing() );
+   eRet = Config_GetMaxFeedItems( &sOptions.ulMaxPosts );
+   if( !ISERROR( eRet ) )
+   {
+      eRet = Database_Init( hDatabase );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      eRet = CurlSession_Init( &sSession );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      eRet = Transaction_Begin( hDatabase );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      eRet = commitRun( hDatabase, FeedPipeline_Run( hDatabase, &sSession, pasRequests, ulCount, &sOptions ) );
+   }
+   CurlSession_Free( &sSession );
+   free( pasRequests );
+
+   return eRet;
+}
+
+static void daemonOnSignal( int iSignal )
+{
+   ( void )iSignal;
+   s_bStopDaemon = 1;
+}
+
+/* 
+    Keeps the config, the database & the curl session in memory & posts once per interval until stopped
+    Every refresh & post is a transaction of its own
+ */
+static ERROR_CODE runDaemon( DATABASE_HANDLE hDatabase )
+{
+   BOT_DAEMON sDaemon = { 0, };
+   struct sigaction sAction = { 0, };
+   time_t tNow = time( _null_ );
+   ERROR_CODE eRet = NO_ERROR;
+
+   sAction.sa_handler = daemonOnSignal;
+   sigaction( SIGINT, &sAction, _null_ );
+   sigaction( SIGTERM, &sAction, _null_ );
+
+   RETURN_ON_FAIL( TimerWheel_Init( &sDaemon.sWheel, tNow, DAEMON_TICK_SECONDS ) );
+   // From here on every failure goes through the shutdown below
+   eRet = CurlSession_Init( &sDaemon.sSession );
+   sDaemon.hDatabase = hDatabase;
+
+   // The first post goes out straight away, as it would on a single run
+   sDaemon.tNextPost = tNow;
+   if( !ISERROR( eRet ) && IsNewFileRequired() )
+   {
+      eRet = TimerWheel_Schedule( &sDaemon.sWheel, &sDaemon.sRefreshTimer, tNow, daemonOnRefresh, &sDaemon );
+   }
+   else if( !ISERROR( eRet ) )
+   {
+      eRet = Database_Init( hDatabase );
+   }
+   if( !ISERROR( eRet ) )
+   {
+      eRet = TimerWheel_Schedule( &sDaemon.sWheel, &sDaemon.sPostTimer, sDaemon.tNextPost, daemonOnPost, &sDaemon );
+   }
+
+   while( !ISERROR( eRet ) && !s_bStopDaemon )
+   {
+      time_t tNext = 0;
+
+      eRet = TimerWheel_NextExpiry( &sDaemon.sWheel, &tNext );
+      if( ISERROR( eRet ) )
+         break;
+      tNow = time( _null_ );
+      if( tNext > tNow )
+      {
+         // Cut short by a signal
+         sleep( ( unsigned int )( ( tNext - tNow < DAEMON_MAX_SLEEP ) ? tNext - tNow : DAEMON_MAX_SLEEP ) );
+         continue;
+      }
+      TimerWheel_Advance( &sDaemon.sWheel, tNow );
+   }
+
+   DBG_PRINTF( "Daemon stopping" );
+   CurlSession_Free( &sDaemon.sSession );
+
+   // Every timer has committed its changes
+   return eRet;
+}
+
+/* 
+    Runs whatever the command line asks for on the bot's database
+ */
+static ERROR_CODE runCommand( DATABASE_HANDLE hDatabase, int argc, char *argv[] )
+{
+   ERROR_CODE eRet = NO_ERROR;
+
+   // The database file is binary, "--export-xml <file>" & "--import-xml <file>" convert it
+   if( argc == 3 && strcmp( argv[1], "--export-xml" ) == 0 )
+   {
+      RETURN_ON_FAIL( Database_Init( hDatabase ) );
+      return Database_ExportXml( hDatabase, argv[2] );
+   }
+   if( argc == 3 && strcmp( argv[1], "--import-xml" ) == 0 )
+   {
+      return Database_ImportXml( hDatabase, argv[2] );
+   }
+   if( argc == 2 && strcmp( argv[1], "--daemon" ) == 0 )
+   {
+      return runDaemon( hDatabase );
+   }
+   // "--refresh-feeds <url> [<url>...]"
+   if( argc >= 3 && strcmp( argv[1], "--refresh-feeds" ) == 0 )
+   {
+      return refreshFeeds( hDatabase, &argv[2], ( uint32_t )( argc - 2 ) );
+   }
+
+   // Every change of the run is written once, at the end
+   eRet = Transaction_Begin( hDatabase );
+   RETURN_ON_FAIL( eRet );
+
+   return commitRun( hDatabase, runOnce( hDatabase ) );
+}
+
+int main( int argc, char *argv[] )
+{
+#if !PERFORM_TESTS
+   DATABASE_HANDLE hDatabase = _null_;
+   ERROR_CODE eRet = NO_ERROR;
+   ERROR_CODE eClose = NO_ERROR;
+#endif
+
+   DBG_INIT();
+
+#if PERFORM_TESTS
+   RETURN_ON_FAIL( XmlTest() );
+   RETURN_ON_FAIL( Database_Tests() );
+#else
+
+   RETURN_ON_FAIL( Config_Init() );
+   RETURN_ON_FAIL( Database_Open( DATABASE_DEFAULT_NAME, &hDatabase ) );
+
+   eRet = runCommand( hDatabase, argc, argv );
+   // The database file may still be being compacted
+   eClose = Database_Close( hDatabase );
+   RETURN_ON_FAIL( eRet );
+   RETURN_ON_FAIL( eClose );
    
 #endif
    return( 0 );